@@ -7,93 +7,486 @@
 //! recommended)
 //#define PROVISION_CAN_ACEINNA_MODULE
 
+namespace {
+/**
+ * @brief Decodes the three 16-bit fields of an ARI or ACCS frame. Both use an
+ * offset of -32000 bits (-250 deg/s at 1/128 deg/s, and -320 m/s^2 at 0.01
+ * m/s^2).
+ *
+ * @param data the frame payload
+ * @param values overwritten with the fields, offset removed
+ * @return true if all three fields hold valid data
+ * @return false if any field is flagged as an error or not available
+ */
+bool decodeAxes(const byte *data, long *values)
+{
+    for (byte i = 0; i < 3; i++) {
+        unsigned int raw = (unsigned int)data[2 * i] |
+                           ((unsigned int)data[2 * i + 1] << 8);
+        // 0xFB00 and up are J1939 error and not available indicators
+        if (raw >= 0xFB00) {
+            return false;
+        }
+        values[i] = (long)raw - 32000L;
+    }
+    return true;
+}
+
+//! How bad each two bit quality code is, worst highest. Not available ranks
+//! above a good reading but below a degraded one (or compensation off), and
+//! error is worst of all.
+const byte k_meritRanks[4] = {0, 2, 3, 1};
+const byte k_compensationRanks[4] = {2, 0, 3, 1};
+
+/**
+ * @brief Picks the worse of two quality codes
+ *
+ * @param a the first code
+ * @param b the second code
+ * @param ranks k_meritRanks or k_compensationRanks
+ * @return byte whichever of the two ranks higher
+ */
+byte worseCode(byte a, byte b, const byte *ranks)
+{
+    return (ranks[a] >= ranks[b]) ? a : b;
+}
+} // namespace
+
+const Inclinometer::ACEINNAInclinometer::Profile
+    Inclinometer::ACEINNAInclinometer::k_profiles[k_profileCount] = {
+        {"10 HZ, 2 HZ FILTER", 10, 2},
+        {"50 HZ, 5 HZ FILTER", 2, 5},
+        {"100 HZ, 10 HZ FILTER", 1, 10}};
+
 bool Inclinometer::ACEINNAInclinometer::begin()
 {
+    // Have the CAN module drop all traffic we don't use, so it doesn't take
+    // up UART bandwidth and parse time. Everything is matched on the PDU
+    // format byte and the sensor's address, with any PDU specific byte. The
+    // configuration readbacks (0xFF51 to 0xFF57) are broadcast PGNs, so the
+    // second bank lets them in.
+    const unsigned long dataPGNs[] = {PGN_SSI2DATA,
+                                      PGN_ENABLED_PERIODIC_DATA_TYPES};
+    // SSI2, ARI and ACCS (0xF029 to 0xF02D) share the first filter. The
+    // enabled data types readback is a peer-to-peer PGN, which the MTLT
+    // answers as 0xEFB6 but J1939 addresses to us (0xEF11), and the
+    // requester takes either.
+    canInterface.acceptPGNs(CAN::mask_0, dataPGNs,
+                            sizeof(dataPGNs) / sizeof(dataPGNs[0]),
+                            k_aceinnaAddress, true);
+    const unsigned long protocolPGNs[] = {
+        CAN::J1939Transport::PGN_TP_CM, CAN::J1939Transport::PGN_TP_DT,
+        CAN::J1939Requester::PGN_ACKNOWLEDGEMENT, PGN_ODR};
+    canInterface.acceptPGNs(CAN::mask_1, protocolPGNs,
+                            sizeof(protocolPGNs) / sizeof(protocolPGNs[0]),
+                            k_aceinnaAddress, true);
+
     canInterface.begin(CAN::SerialBaudrate::baud_115200,
                        CAN::CANBusBaudrate::kbps_250);
 
 #ifdef PROVISION_CAN_ACEINNA_MODULE
+    // Runs once the CAN module is in data mode
     ProvisionACEINNAInclinometer();
 #endif
 
-    canInterface.flushBuffer();
-    delay(300);
-    if (hasData())
-        return true;
-
-    return false;
+    // The CAN module is brought up in the background by hasData(), which
+    // reports a failure to start
+    beginMillis = millis();
+    reportedStartup = false;
+    requestedDataTypes = false;
+    requestedOutputDataRate = false;
+    return true;
 }
 bool Inclinometer::ACEINNAInclinometer::hasData()
 {
-    // TODO: pre-read and check if there is SSI2 data, then cache it!
-    if (canInterface.hasPacket()) {
-        CAN::J1939Message m = canInterface.read();
-        canInterface
-            .flushBuffer(); // This will ensure that we aren't reading
-                            // offset packets by clearing the buffer after every
-                            // read. This could delete messages, but all we
-                            // expect is telemetry, so this is ok
-        if (m.CanID.getPGN() == PGN_SSI2DATA) {
-            byte *data = m.data;
-
-            unsigned long pitch = ((unsigned long)data[2]) << 16 |
-                                  ((unsigned long)data[1]) << 8 |
-                                  ((unsigned long)data[0]);
-            unsigned long roll = ((unsigned long)data[5]) << 16 |
-                                 ((unsigned long)data[4]) << 8 |
-                                 ((unsigned long)data[3]);
-
-            double pitch_adjusted = -(pitch * (1.0 / 32768) - 250.0);
-            double roll_adjusted = (roll * (1.0 / 32768) - 250.0);
-
-            if (pitch_adjusted > k_anglePlausibilityRange ||
-                pitch_adjusted < -k_anglePlausibilityRange ||
-                roll_adjusted > k_anglePlausibilityRange ||
-                roll_adjusted < -k_anglePlausibilityRange) {
-                Fault::Handler::instance()->setFaultCode(
-                    Fault::INCL_IMPLAUS_READ);
-            }
-            else {
-                Fault::Handler::instance()->unlatchFaultCode(
-                    Fault::INCL_IMPLAUS_READ);
-            }
-
-            cachedAngles = Eigen::Vector2d(pitch_adjusted * PI / 180.0,
-                                           roll_adjusted * PI / 180.0);
-            hasDataCached = true;
-            return true;
+    if (!canInterface.step()) {
+        if (canInterface.hasFailed()) {
+            Fault::Handler::instance()->setFaultCode(Fault::INCLINOMETER_INIT);
         }
+        return false;
+    }
+
+    // Read back the sensor configuration once the bus is up. The answer
+    // arrives through onEnabledDataTypes() on a later call.
+    if (!requestedDataTypes) {
+        requestedDataTypes =
+            requester.request(PGN_ENABLED_PERIODIC_DATA_TYPES, k_aceinnaAddress,
+                              onEnabledDataTypes, this);
     }
-    return false;
+    if (!requestedOutputDataRate) {
+        requestedOutputDataRate = requester.request(
+            PGN_ODR, k_aceinnaAddress, onOutputDataRate, this);
+    }
+
+    // Drains every pending frame and hands each one to its PGN's handler
+    canInterface.poll();
+    transport.step();
+    requester.step();
+    stepProvisioning();
+    return pendingCount > 0;
 }
-Eigen::Vector2d Inclinometer::ACEINNAInclinometer::getData()
+
+byte Inclinometer::ACEINNAInclinometer::readAll(Sample *samples,
+                                                byte capacity)
 {
-    hasDataCached = false;
-    roll.addPoint(cachedAngles[0]);
-    pitch.addPoint(cachedAngles[1]);
-    return Eigen::Vector2d(roll.getAverage(), pitch.getAverage());
+    hasData();
+
+    // Skip the oldest samples if they don't all fit
+    while (pendingCount > capacity) {
+        pendingHead = (pendingHead + 1) % k_pendingSamples;
+        pendingCount--;
+    }
+
+    byte count = pendingCount;
+    for (byte i = 0; i < count; i++) {
+        samples[i] = pending[(pendingHead + i) % k_pendingSamples];
+    }
+    if (count > 0) {
+        latest = samples[count - 1];
+    }
+    pendingHead = (pendingHead + count) % k_pendingSamples;
+    pendingCount = 0;
+    return count;
 }
 
-void Inclinometer::ACEINNAInclinometer::ProvisionACEINNAInclinometer()
+void Inclinometer::ACEINNAInclinometer::onEnabledDataTypes(
+    CAN::J1939RequestStatus status, const byte *data, unsigned int length,
+    void *context)
 {
-    // Set Output data rate to 10Hz (10=10Hz; 20=5Hz)
-    canInterface.write(
-        CAN::J1939Message(k_sourceAddress, k_aceinnaAddress, PGN_ODR, 10),
-        k_aceinnaAddress);
+    ACEINNAInclinometer *self = (ACEINNAInclinometer *)context;
+    if (status == CAN::REQUEST_OK && length >= 2) {
+        // Same layout as the command: address, then the data type bitmask
+        self->enabledDataTypes = data[1];
+        Serial.print("ACEINNA periodic data types: 0x");
+        Serial.println(data[1], HEX);
+    }
+    else {
+        Serial.print("ACEINNA data type readback failed: ");
+        Serial.println((int)status);
+    }
+}
 
-    // Only use SSI2 (Inclination) data
-    canInterface.write(CAN::J1939Message(k_sourceAddress, k_aceinnaAddress,
-                                         PGN_PERIODIC_DATA_TYPES, 1),
-                       k_aceinnaAddress);
+void Inclinometer::ACEINNAInclinometer::onOutputDataRate(
+    CAN::J1939RequestStatus status, const byte *data, unsigned int length,
+    void *context)
+{
+    ACEINNAInclinometer *self = (ACEINNAInclinometer *)context;
+    // Same layout as the command: address, then the divider. 0 means the
+    // periodic data is off, which leaves the assumed rate in place.
+    if (status == CAN::REQUEST_OK && length >= 2 && data[1] != 0) {
+        self->odrDivider = data[1];
+        Serial.print("ACEINNA output data rate: ");
+        Serial.print(100 / data[1]);
+        Serial.println(" Hz");
+    }
+    else {
+        Serial.print("ACEINNA output data rate readback failed: ");
+        Serial.println((int)status);
+    }
+}
+
+void Inclinometer::ACEINNAInclinometer::onSSI2Data(
+    const CAN::J1939Message &m, void *context)
+{
+    ((ACEINNAInclinometer *)context)->decodeSSI2(m);
+}
+
+void Inclinometer::ACEINNAInclinometer::decodeSSI2(const CAN::J1939Message &m)
+{
+    const byte *data = m.data;
+
+    unsigned long rawPitch = ((unsigned long)data[2]) << 16 |
+                             ((unsigned long)data[1]) << 8 |
+                             ((unsigned long)data[0]);
+    unsigned long rawRoll = ((unsigned long)data[5]) << 16 |
+                            ((unsigned long)data[4]) << 8 |
+                            ((unsigned long)data[3]);
 
-    // 2Hz digital low pass filter
-    canInterface.write(CAN::J1939Message(k_sourceAddress, k_aceinnaAddress,
-                                         PGN_LOW_PASS, 2, 2),
-                       k_aceinnaAddress);
+    // Decoded and checked in integer micro-degrees, so the result is the
+    // same on every run and platform
+    Angle::MicroDegrees pitchAngle = -Angle::fromSSI2(rawPitch);
+    Angle::MicroDegrees rollAngle = Angle::fromSSI2(rawRoll);
+
+    // Byte 7 holds two bits each of pitch compensation, pitch figure of
+    // merit, roll compensation and roll figure of merit. Byte 8 is the
+    // latency at 0.5 ms per bit, 251 and up mean it isn't known.
+    byte pitchCompensation = data[6] & 0x03;
+    byte pitchMerit = (data[6] >> 2) & 0x03;
+    byte rollCompensation = (data[6] >> 4) & 0x03;
+    byte rollMerit = (data[6] >> 6) & 0x03;
+
+    // Samples the sensor flags as errors on either axis never reach the
+    // filters. If they keep coming, the missing data raises
+    // INCLINOMETER_UNREADY.
+    if (pitchMerit == MERIT_ERROR || rollMerit == MERIT_ERROR ||
+        pitchCompensation == COMPENSATION_ERROR ||
+        rollCompensation == COMPENSATION_ERROR) {
+        rejectedSamples++;
+        return;
+    }
+
+    SampleQuality quality;
+    quality.compensation =
+        worseCode(pitchCompensation, rollCompensation, k_compensationRanks);
+    quality.figureOfMerit = worseCode(pitchMerit, rollMerit, k_meritRanks);
+    quality.latency = (data[7] <= 250) ? data[7] * 500U : 0;
+
+    if (!Angle::withinRange(pitchAngle, k_anglePlausibilityRange) ||
+        !Angle::withinRange(rollAngle, k_anglePlausibilityRange)) {
+        Fault::Handler::instance()->setFaultCode(Fault::INCL_IMPLAUS_READ);
+    }
+    else {
+        Fault::Handler::instance()->unlatchFaultCode(Fault::INCL_IMPLAUS_READ);
+    }
 
-    // Save config to EEPROM
-    canInterface.write(CAN::J1939Message(k_sourceAddress, k_aceinnaAddress,
-                                         PGN_SAVE_EEPROM, 0, k_aceinnaAddress,
-                                         1),
-                       k_aceinnaAddress);
+    // Filter every sample as it arrives, so the filters see all of them even
+    // if several arrive between reads. Degraded ones count for less.
+    float weight =
+        (quality.figureOfMerit == MERIT_DEGRADED) ? k_degradedSampleWeight : 1;
+    roll.addWeighted(Angle::toRadians(pitchAngle), weight);
+    pitch.addWeighted(Angle::toRadians(rollAngle), weight);
+
+    if (pendingCount == k_pendingSamples) {
+        pendingHead = (pendingHead + 1) % k_pendingSamples;
+        pendingCount--;
+        droppedSamples++;
+    }
+    Sample &sample = pending[(pendingHead + pendingCount) % k_pendingSamples];
+    sample.angles = Rotation::Vec2(roll.get(), pitch.get());
+    sample.timestamp = m.timestamp;
+    sample.quality = quality;
+    pendingCount++;
+
+    if (!reportedStartup) {
+        reportedStartup = true;
+        Serial.print("CAN module ready after ");
+        Serial.print(canInterface.getBringupMillis());
+        Serial.print(" ms (found at baud setting ");
+        Serial.print((int)canInterface.getDetectedBaud());
+        Serial.print("), first SSI2 frame after ");
+        Serial.print(millis() - beginMillis);
+        Serial.println(" ms");
+    }
+}
+
+void Inclinometer::ACEINNAInclinometer::onAngularRate(
+    const CAN::J1939Message &m, void *context)
+{
+    ((ACEINNAInclinometer *)context)->decodeAngularRate(m);
+}
+
+void Inclinometer::ACEINNAInclinometer::decodeAngularRate(
+    const CAN::J1939Message &m)
+{
+    // Pitch rate, roll rate, yaw rate, at 1/128 deg/s per bit
+    long rates[3];
+    if (!decodeAxes(m.data, rates)) {
+        return;
+    }
+
+    // Same axes and signs as the angles from SSI2 (pitch is flipped)
+    constexpr double scale = PI / 180.0 / 128.0;
+    latestRates.rates =
+        Rotation::Vec3(-rates[0] * scale, rates[1] * scale, rates[2] * scale);
+    latestRates.timestamp = m.timestamp;
+    hasRates = true;
+}
+
+void Inclinometer::ACEINNAInclinometer::onAcceleration(
+    const CAN::J1939Message &m, void *context)
+{
+    ((ACEINNAInclinometer *)context)->decodeAcceleration(m);
+}
+
+void Inclinometer::ACEINNAInclinometer::decodeAcceleration(
+    const CAN::J1939Message &m)
+{
+    // Lateral, longitudinal and vertical, at 0.01 m/s^2 per bit
+    long accelerations[3];
+    if (!decodeAxes(m.data, accelerations)) {
+        return;
+    }
+    latestAcceleration =
+        Rotation::Vec3(accelerations[0] * 0.01, accelerations[1] * 0.01,
+                        accelerations[2] * 0.01);
+    accelerationTimestamp = m.timestamp;
+    hasAcceleration = true;
+}
+
+bool Inclinometer::ACEINNAInclinometer::getRates(RateSample &rates)
+{
+    if (hasRates) {
+        rates = latestRates;
+    }
+    return hasRates;
+}
+
+bool Inclinometer::ACEINNAInclinometer::getAcceleration(
+    Rotation::Vec3 &acceleration, unsigned long &timestamp)
+{
+    if (hasAcceleration) {
+        acceleration = latestAcceleration;
+        timestamp = accelerationTimestamp;
+    }
+    return hasAcceleration;
+}
+
+Rotation::Vec2 Inclinometer::ACEINNAInclinometer::getData()
+{
+    // Only the newest sample is wanted, the rest have been filtered already
+    if (pendingCount > 0) {
+        latest = pending[(pendingHead + pendingCount - 1) % k_pendingSamples];
+        pendingHead = (pendingHead + pendingCount) % k_pendingSamples;
+        pendingCount = 0;
+    }
+    return latest.angles;
+}
+
+bool Inclinometer::ACEINNAInclinometer::ProvisionACEINNAInclinometer(
+    byte profile, byte dataTypes)
+{
+    if (profile >= k_profileCount || provisioningStatus == PROVISION_BUSY) {
+        return false;
+    }
+    provisioningProfile = profile;
+    provisioningDataTypes = dataTypes;
+    provisioningStep = STEP_ODR;
+    provisioningAttempts = 0;
+    provisioningWaiting = false;
+    provisioningStatus = PROVISION_BUSY;
+    Serial.print("Provisioning ACEINNA: ");
+    Serial.println(k_profiles[profile].name);
+    return true;
+}
+
+void Inclinometer::ACEINNAInclinometer::stepProvisioning()
+{
+    if (provisioningStatus != PROVISION_BUSY) {
+        return;
+    }
+
+    // The save has no readback of its own, its response is awaited here
+    if (provisioningWaiting && provisioningStep == STEP_SAVE &&
+        millis() - provisioningStepMillis >
+            CAN::J1939Requester::k_defaultTimeoutMillis) {
+        provisioningWaiting = false;
+    }
+    if (provisioningWaiting) {
+        return;
+    }
+
+    if (provisioningAttempts >= k_provisioningAttempts) {
+        provisioningStatus = PROVISION_FAILED;
+        Serial.print("ACEINNA provisioning failed at step ");
+        Serial.println((int)provisioningStep);
+        return;
+    }
+
+    // Tried again on the next call if the queues are full
+    if (sendProvisioningStep()) {
+        provisioningWaiting = true;
+        provisioningAttempts++;
+        provisioningStepMillis = millis();
+    }
+}
+
+bool Inclinometer::ACEINNAInclinometer::sendProvisioningStep()
+{
+    const Profile &profile = k_profiles[provisioningProfile];
+    switch (provisioningStep) {
+    case STEP_ODR:
+        return canInterface.write(CAN::J1939Message(k_sourceAddress,
+                                                    k_aceinnaAddress, PGN_ODR,
+                                                    profile.odrDivider),
+                                  k_aceinnaAddress) &&
+               requester.request(PGN_ODR, k_aceinnaAddress,
+                                 onProvisioningReadback, this);
+    case STEP_DATA_TYPES:
+        return canInterface.write(
+                   CAN::J1939Message(k_sourceAddress, k_aceinnaAddress,
+                                     PGN_PERIODIC_DATA_TYPES,
+                                     provisioningDataTypes),
+                   k_aceinnaAddress) &&
+               requester.request(PGN_ENABLED_PERIODIC_DATA_TYPES,
+                                 k_aceinnaAddress, onProvisioningReadback,
+                                 this);
+    case STEP_LOW_PASS:
+        // Same cutoff for the rate and acceleration sensors
+        return canInterface.write(
+                   CAN::J1939Message(k_sourceAddress, k_aceinnaAddress,
+                                     PGN_LOW_PASS, profile.lowPassHz,
+                                     profile.lowPassHz),
+                   k_aceinnaAddress) &&
+               requester.request(PGN_LOW_PASS, k_aceinnaAddress,
+                                 onProvisioningReadback, this);
+    case STEP_SAVE:
+        // Answered with the same PGN, see onSaveResponse()
+        return canInterface.write(
+            CAN::J1939Message(k_sourceAddress, k_aceinnaAddress,
+                              PGN_SAVE_EEPROM, 0, k_aceinnaAddress, 1),
+            k_aceinnaAddress);
+    default:
+        return false;
+    }
+}
+
+void Inclinometer::ACEINNAInclinometer::onProvisioningReadback(
+    CAN::J1939RequestStatus status, const byte *data, unsigned int length,
+    void *context)
+{
+    ACEINNAInclinometer *self = (ACEINNAInclinometer *)context;
+    const Profile &profile = k_profiles[self->provisioningProfile];
+    self->provisioningWaiting = false;
+
+    // Every readback has the command's layout: address, then the settings
+    bool confirmed = false;
+    if (status == CAN::REQUEST_OK && length >= 3) {
+        switch (self->provisioningStep) {
+        case STEP_ODR:
+            confirmed = data[1] == profile.odrDivider;
+            break;
+        case STEP_DATA_TYPES:
+            confirmed = data[1] == self->provisioningDataTypes;
+            break;
+        case STEP_LOW_PASS:
+            confirmed = data[1] == profile.lowPassHz &&
+                        data[2] == profile.lowPassHz;
+            break;
+        }
+    }
+    if (!confirmed) {
+        Serial.print("ACEINNA provisioning step ");
+        Serial.print((int)self->provisioningStep);
+        Serial.println(" not confirmed, retrying");
+        return;
+    }
+
+    if (self->provisioningStep == STEP_ODR) {
+        self->odrDivider = profile.odrDivider;
+    }
+    else if (self->provisioningStep == STEP_DATA_TYPES) {
+        self->enabledDataTypes = self->provisioningDataTypes;
+    }
+    self->provisioningStep++;
+    self->provisioningAttempts = 0;
+}
+
+void Inclinometer::ACEINNAInclinometer::onSaveResponse(
+    const CAN::J1939Message &m, void *context)
+{
+    ACEINNAInclinometer *self = (ACEINNAInclinometer *)context;
+    if (self->provisioningStatus != PROVISION_BUSY ||
+        self->provisioningStep != STEP_SAVE || !self->provisioningWaiting) {
+        return;
+    }
+
+    // Response flag, address, then 1 if the save succeeded
+    if (m.data[0] != 1) {
+        return;
+    }
+    self->provisioningWaiting = false;
+    if (m.data[2] == 1) {
+        self->provisioningStatus = PROVISION_DONE;
+        Serial.println("ACEINNA provisioning saved");
+    }
 }
\ No newline at end of file
@@ -14,8 +14,11 @@
 #define ACEINNA_MTLT_INCINOMETER_CAN_INTERFACE_H
 
 #include "CANSAEJ1939.h"
+#include "CANSAEJ1939Request.h"
+#include "CANSAEJ1939Transport.h"
+#include "FixedPointAngle.h"
 #include "InclinometerInterface.h"
-#include "MovingAverage.h"
+#include "Filters.h"
 
 #include <Arduino.h>
 
@@ -24,7 +27,7 @@ namespace Inclinometer {
 /**
  * @brief An interface to an ACEINNA MTLT Inclinometer
  */
-class ACEINNAInclinometer : public InclinometerDataSource {
+class ACEINNAInclinometer final : public InclinometerDataSource {
   public:
     /**
      * @brief Construct a new ACEINNAInclinometer object
@@ -36,9 +39,30 @@ class ACEINNAInclinometer : public InclinometerDataSource {
      */
     ACEINNAInclinometer(HardwareSerial &canSerialInterface,
                         float ewmaAlpha = 1.0)
-        : canInterface(canSerialInterface), hasDataCached(false),
-          roll(0, ewmaAlpha), pitch(0, ewmaAlpha)
+        : canInterface(canSerialInterface),
+          transport(canInterface, k_sourceAddress),
+          requester(canInterface, k_sourceAddress), roll(ewmaAlpha),
+          pitch(ewmaAlpha), pendingHead(0), pendingCount(0), droppedSamples(0),
+          rejectedSamples(0), beginMillis(0), reportedStartup(true),
+          requestedDataTypes(true), enabledDataTypes(-1),
+          requestedOutputDataRate(true), odrDivider(k_defaultODRDivider),
+          provisioningStatus(PROVISION_IDLE), hasRates(false),
+          hasAcceleration(false)
     {
+        latest.angles = Rotation::Vec2(0, 0);
+        latest.timestamp = 0;
+        latest.quality.figureOfMerit = MERIT_NOT_AVAILABLE;
+        latest.quality.compensation = COMPENSATION_NOT_AVAILABLE;
+        latest.quality.latency = 0;
+        canInterface.registerHandler(PGN_SSI2DATA, onSSI2Data, this);
+        canInterface.registerHandler(PGN_ANGULAR_RATE, onAngularRate, this);
+        canInterface.registerHandler(PGN_ACCELERATION, onAcceleration, this);
+        canInterface.registerHandler(PGN_SAVE_EEPROM, onSaveResponse, this);
+        transport.begin();
+        requester.begin();
+        // Responses too long for one frame arrive over the transport protocol
+        transport.setReceiveHandler(CAN::J1939Requester::onTransportMessage,
+                                    &requester);
     }
 
     //! ACEINNA CAN Bus Address
@@ -48,8 +72,50 @@ class ACEINNAInclinometer : public InclinometerDataSource {
     static constexpr byte k_sourceAddress = 0x11;
 
     //! Allowed angle range before considering the inclinometer data to be
-    //! invalid (degrees)
-    static constexpr double k_anglePlausibilityRange = 30;
+    //! invalid
+    static constexpr Angle::MicroDegrees k_anglePlausibilityRange =
+        Angle::fromDegrees(30);
+
+    //! Number of filtered samples held until they are read
+    static constexpr byte k_pendingSamples = 8;
+
+    //! How much a sample with a degraded figure of merit counts in the
+    //! moving average, compared to a fully functional one
+    static constexpr float k_degradedSampleWeight = 0.25;
+
+    //! Output data rate divider assumed until the sensor reports its own
+    //! (100 Hz / 10 = 10 Hz)
+    static constexpr byte k_defaultODRDivider = 10;
+
+    //! Times each provisioning step is tried before giving up
+    static constexpr byte k_provisioningAttempts = 3;
+
+    /**
+     * @brief A set of sensor settings that is provisioned together
+     */
+    typedef struct {
+        //! Shown on the display (at most 20 characters)
+        const char *name;
+        //! Output data rate divider (100 Hz / divider)
+        byte odrDivider;
+        //! Low pass filter cutoff for the rate and acceleration sensors (Hz)
+        byte lowPassHz;
+    } Profile;
+
+    //! Provisioning profiles, selected by index
+    static const Profile k_profiles[];
+    static constexpr byte k_profileCount = 3;
+    static constexpr byte k_defaultProfile = 0;
+
+    /**
+     * @brief Progress of ProvisionACEINNAInclinometer()
+     */
+    enum ProvisioningStatus {
+        PROVISION_IDLE,
+        PROVISION_BUSY,
+        PROVISION_DONE,
+        PROVISION_FAILED
+    };
 
     /**
      * @brief PGNs used by this module
@@ -58,6 +124,8 @@ class ACEINNAInclinometer : public InclinometerDataSource {
         // Data Messages / Get Messages
         PGN_ENABLED_PERIODIC_DATA_TYPES = 61366,
         PGN_SSI2DATA = 61481,
+        PGN_ANGULAR_RATE = 61482,
+        PGN_ACCELERATION = 61485,
 
         // Command Messages
         PGN_SAVE_EEPROM = 65361,
@@ -67,22 +135,160 @@ class ACEINNAInclinometer : public InclinometerDataSource {
         PGN_ORIENTATION
     };
 
+    /**
+     * @brief Periodic data type bits, for ProvisionACEINNAInclinometer()
+     */
+    enum DataType {
+        DATA_SSI2 = 0x01,
+        DATA_ANGULAR_RATE = 0x02,
+        DATA_ACCELERATION = 0x04
+    };
+
     //! See the InclinometerDataSource interface
 
     bool begin() override;
     bool hasData() override;
-    Eigen::Vector2d getData() override;
+    Rotation::Vec2 getData() override;
+    unsigned long getTimestamp() override { return latest.timestamp; };
+    byte readAll(Sample *samples, byte capacity) override;
+    bool getRates(RateSample &rates) override;
+    unsigned long getSamplePeriod() override { return odrDivider * 10000UL; };
 
-    void ProvisionACEINNAInclinometer();
+    /**
+     * @brief Starts writing a profile to the sensor and saving it to its
+     * EEPROM
+     *
+     * Runs in the background as hasData() is called. Each setting is read
+     * back over J1939 and written again if it doesn't match, up to
+     * k_provisioningAttempts times. The configuration is only saved once
+     * every setting is confirmed. Check getProvisioningStatus() for the
+     * result.
+     *
+     * @param profile index into k_profiles
+     * @param dataTypes periodic data types to send (DataType bits). Angular
+     * rates and accelerations are decoded whenever the sensor sends them.
+     * @return true if provisioning was started
+     * @return false if the profile doesn't exist or provisioning is already
+     * running
+     */
+    bool ProvisionACEINNAInclinometer(byte profile = k_defaultProfile,
+                                      byte dataTypes = DATA_SSI2);
+
+    /**
+     * @brief Get the progress of the last ProvisionACEINNAInclinometer()
+     *
+     * @return ProvisioningStatus PROVISION_DONE once the sensor confirmed
+     * every setting and saved them
+     */
+    ProvisioningStatus getProvisioningStatus() { return provisioningStatus; };
+
+    /**
+     * @brief Get the newest acceleration measured by the sensor
+     *
+     * @param acceleration overwritten with the acceleration along the
+     * sensor's X, Y and Z axes (m/s^2)
+     * @param timestamp overwritten with the micros() at which it was received
+     * @return true if the sensor has sent accelerations
+     * @return false if no acceleration was received (yet)
+     */
+    bool getAcceleration(Rotation::Vec3 &acceleration,
+                         unsigned long &timestamp);
+
+    /**
+     * @brief Get the periodic data types the sensor reported at boot
+     *
+     * @return int the data type bitmask, or -1 if it has not been read back
+     * (yet)
+     */
+    int getEnabledDataTypes() { return enabledDataTypes; };
+
+    /**
+     * @brief Get the number of samples that were overwritten before they were
+     * read
+     *
+     * @return unsigned long dropped sample count
+     */
+    unsigned long getDroppedSampleCount() { return droppedSamples; };
+
+    /**
+     * @brief Get the number of samples that were thrown away because the
+     * sensor flagged them as errors
+     *
+     * @return unsigned long rejected sample count
+     */
+    unsigned long getRejectedSampleCount() { return rejectedSamples; };
 
   private:
     CAN::J1939Interface canInterface;
+    CAN::J1939Transport transport;
+    CAN::J1939Requester requester;
+
+    //! Provisioning steps, in order
+    enum ProvisioningStep {
+        STEP_ODR,
+        STEP_DATA_TYPES,
+        STEP_LOW_PASS,
+        STEP_SAVE,
+        STEP_END
+    };
+
+    static void onEnabledDataTypes(CAN::J1939RequestStatus status,
+                                   const byte *data, unsigned int length,
+                                   void *context);
+    static void onOutputDataRate(CAN::J1939RequestStatus status,
+                                 const byte *data, unsigned int length,
+                                 void *context);
+
+    void stepProvisioning();
+    bool sendProvisioningStep();
+    static void onProvisioningReadback(CAN::J1939RequestStatus status,
+                                       const byte *data, unsigned int length,
+                                       void *context);
+    static void onSaveResponse(const CAN::J1939Message &m, void *context);
+
+    static void onSSI2Data(const CAN::J1939Message &m, void *context);
+    void decodeSSI2(const CAN::J1939Message &m);
+    static void onAngularRate(const CAN::J1939Message &m, void *context);
+    void decodeAngularRate(const CAN::J1939Message &m);
+    static void onAcceleration(const CAN::J1939Message &m, void *context);
+    void decodeAcceleration(const CAN::J1939Message &m);
+
+    Filter::Ewma<double> roll;
+    Filter::Ewma<double> pitch;
+
+    //! Filtered samples waiting to be read, oldest at pendingHead
+    Sample pending[k_pendingSamples];
+    byte pendingHead;
+    byte pendingCount;
+    unsigned long droppedSamples;
+    unsigned long rejectedSamples;
+
+    //! The newest sample that was read
+    Sample latest;
+
+    unsigned long beginMillis;
+    bool reportedStartup;
+
+    bool requestedDataTypes;
+    int enabledDataTypes;
+    bool requestedOutputDataRate;
+    byte odrDivider;
+
+    ProvisioningStatus provisioningStatus;
+    byte provisioningProfile;
+    byte provisioningDataTypes;
+    byte provisioningStep;
+    byte provisioningAttempts;
+    //! True while a step's command is out and its readback is awaited
+    bool provisioningWaiting;
+    unsigned long provisioningStepMillis;
 
-    MovingAverage roll;
-    MovingAverage pitch;
+    RateSample latestRates;
+    bool hasRates;
 
-    Eigen::Vector2d cachedAngles;
-    bool hasDataCached;
+    Rotation::Vec3 latestAcceleration;
+    unsigned long accelerationTimestamp;
+    bool hasAcceleration;
 };
 }; // namespace Inclinometer
 
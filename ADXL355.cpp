@@ -43,6 +43,7 @@ void ADXL355::spi_multibyte_read(byte *buf, int buffersize, byte startaddress)
 boolean ADXL355::begin(byte range, byte filter = ADXL355_FILTER_OFF)
 {
     this->range = range;
+    updateCorrection();
     pinMode(chipselect, OUTPUT);
     if (chipselect2 >= 0) {
         pinMode(chipselect2, OUTPUT);
@@ -59,39 +60,131 @@ boolean ADXL355::begin(byte range, byte filter = ADXL355_FILTER_OFF)
     return adbyte == 0xAD;
 }
 
-void ADXL355::takeSample()
+void ADXL355::takeSample() { readRaw(axes); }
+
+void ADXL355::readRaw(long *raw)
 {
     byte bytebuf[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
     spi_multibyte_read(bytebuf, 9, ADXL355__REG_ACCELEROMETER_DATA_BEGIN);
 
-    unsigned long buf[9];
-    for (int i = 0; i < 9; i++)
-        buf[i] = (int)bytebuf[i];
+    for (int i = 0; i < 3; i++) {
+        raw[i] =
+            decodeAxis(bytebuf[3 * i], bytebuf[3 * i + 1], bytebuf[3 * i + 2]);
+    }
+}
 
-    axes[0] = (buf[2] | buf[1] << 8 | buf[0] << 16) & 0xFFFFFF;
-    axes[1] = (buf[5] | buf[4] << 8 | buf[3] << 16) & 0xFFFFFF;
-    axes[2] = (buf[8] | buf[7] << 8 | buf[6] << 16) & 0xFFFFFF;
-    long mask = 1;
-    mask = mask << 23;
+ADXL355Measurement ADXL355::getSample() { return toMeasurement(axes); }
 
-    for (int i = 0; i < 3; i++) {
-        if (axes[i] > mask) {
-            axes[i] = -((mask << 1) - axes[i]);
+byte ADXL355::getFifoSets()
+{
+    return (spi_readbyte(ADXL355__REG_FIFO_ENTRIES) & 0x7F) / 3;
+}
+
+byte ADXL355::readFifo(ADXL355Measurement *measurements, byte capacity,
+                       byte sets)
+{
+    // Only whole sets are read, the chip may be in the middle of adding one
+    byte entries = ((sets < capacity) ? sets : capacity) * 3;
+    if (entries == 0) {
+        return 0;
+    }
+
+    byte count = 0;
+    byte axis = 0;
+    long set[3];
+
+    SPI.beginTransaction(settings);
+    setCS(true);
+
+    SPI.transfer((byte)((ADXL355__REG_FIFO_DATA << 1) | AXL355__SPI_READBIT));
+    for (byte i = 0; i < entries; i++) {
+        byte high = SPI.transfer(0x0);
+        byte middle = SPI.transfer(0x0);
+        byte low = SPI.transfer(0x0);
+        if (low & AXL355__FIFO_EMPTY) {
+            break;
+        }
+        if (low & AXL355__FIFO_X_MARKER) {
+            axis = 0;
         }
+        else if (axis == 0) {
+            // Not lined up on an X entry yet
+            continue;
+        }
+        set[axis++] = decodeAxis(high, middle, low);
+        if (axis == 3) {
+            measurements[count++] = toMeasurement(set);
+            axis = 0;
+        }
+    }
+
+    setCS(false);
+    SPI.endTransaction();
+    return count;
+}
+
+long ADXL355::decodeAxis(byte high, byte middle, byte low)
+{
+    // 20 bits, left justified. The low nibble holds the FIFO markers.
+    long value = ((long)high << 16) | ((long)middle << 8) | (low & 0xF0);
+    if (value & 0x800000L) {
+        value -= 0x1000000L;
     }
+    return value;
 }
 
-ADXL355Measurement ADXL355::getSample()
+ADXL355Measurement ADXL355::toMeasurement(const long *raw, bool calibrated)
 {
-    long scale = ((long)2 << ((3 - range) + 5)) * 1000;
     ADXL355Measurement measure;
-    measure.x = axes[0] / (1.0 * scale);
-    measure.y = axes[1] / (1.0 * scale);
-    measure.z = axes[2] / (1.0 * scale);
+    if (!calibrated) {
+        measure.x = raw[0] * nominalScale;
+        measure.y = raw[1] * nominalScale;
+        measure.z = raw[2] * nominalScale;
+        return measure;
+    }
 
+    double axis[3];
+    for (int i = 0; i < 3; i++) {
+        axis[i] = correction[i][0] * raw[0] + correction[i][1] * raw[1] +
+                  correction[i][2] * raw[2] + calibration.offset[i];
+    }
+    measure.x = axis[0];
+    measure.y = axis[1];
+    measure.z = axis[2];
     return measure;
 }
 
+bool ADXL355::setCalibration(const ADXL355Calibration &calibration)
+{
+    if (calibration.version != ADXL355_CALIBRATION_VERSION) {
+        return false;
+    }
+    this->calibration = calibration;
+    updateCorrection();
+    return true;
+}
+
+void ADXL355::updateCorrection()
+{
+    long scale = ((long)2 << ((3 - range) + 5)) * 1000;
+    nominalScale = 1.0 / scale;
+
+    // Without a calibration, only the nominal scale is applied
+    if (calibration.version != ADXL355_CALIBRATION_VERSION) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                calibration.gain[i][j] = (i == j) ? 1 : 0;
+            }
+            calibration.offset[i] = 0;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            correction[i][j] = calibration.gain[i][j] * nominalScale;
+        }
+    }
+}
+
 byte ADXL355::getStatus() { return spi_readbyte(ADXL255__REG_STATUS); }
 
 void ADXL355::setCS(bool active)
@@ -19,6 +19,8 @@
 #define ADXL355__REG_XDATA3                   0x08
 #define ADXL355__REG_ACCELEROMETER_DATA_BEGIN ADXL355__REG_XDATA3
 #define ADXL255__REG_STATUS                   0x04
+#define ADXL355__REG_FIFO_ENTRIES             0x05
+#define ADXL355__REG_FIFO_DATA                0x11
 
 // WRITE Registers
 #define ADXL355__REG_POWER_CONTROL 0x2D
@@ -30,6 +32,8 @@
 #define AXL355__CONST_MEASURE_MODE 0x06
 #define AXL355__SPI_WRITEBIT       0x00
 #define AXL355__SPI_READBIT        0x01
+#define AXL355__FIFO_X_MARKER      0b00000001
+#define AXL355__FIFO_EMPTY         0b00000010
 
 // Public Constants
 #define ADXL355_RANGE_2G 0x01
@@ -47,6 +51,16 @@
 #define ADXL355_FILTER_LPF_16HZ_ODR 0b00001000
 #define ADXL355_FILTER_OFF          0x000000
 
+//! The FIFO holds 96 entries, one axis each, so 32 X, Y, Z sets
+#define ADXL355_FIFO_SETS 32
+
+//! getSample() units per g (the 20-bit reading is scaled as if it were
+//! 24 bits)
+#define ADXL355_MEASUREMENT_PER_G 16.0
+
+//! Layout version of ADXL355Calibration, bump it when the struct changes
+#define ADXL355_CALIBRATION_VERSION 1
+
 /**
  * @brief Represents a 3-axis measurement from the accelerometer
  */
@@ -56,6 +70,19 @@ typedef struct {
     double z;
 } ADXL355Measurement;
 
+/**
+ * @brief Per-unit correction of the nominal measurement, solved by
+ * ADXL355Calibrator: corrected = gain * nominal + offset
+ */
+typedef struct {
+    //! ADXL355_CALIBRATION_VERSION if the rest is valid
+    byte version;
+    //! Gain and cross-axis coupling, row major
+    float gain[3][3];
+    //! Offset (getSample() units)
+    float offset[3];
+} ADXL355Calibration;
+
 /**
  * @brief Interface for communicating with the ADXL355 chip over SPI
  */
@@ -73,7 +100,11 @@ class ADXL355 {
      */
     ADXL355(int cs, int speed = 5000000, int cs2 = -1)
         : chipselect(cs), chipselect2(cs2),
-          settings(SPISettings(speed, MSBFIRST, SPI_MODE0)){};
+          settings(SPISettings(speed, MSBFIRST, SPI_MODE0)), range(1)
+    {
+        calibration.version = 0;
+        updateCorrection();
+    };
 
     /**
      * @brief Start the ADXL355 accelerometer with a filter and a operating
@@ -98,6 +129,37 @@ class ADXL355 {
      */
     void takeSample();
 
+    /**
+     * @brief Read the data registers over SPI without caching them. Cheap
+     * enough to run in an interrupt (call SPI.usingInterrupt() first).
+     *
+     * @param raw overwritten with the signed X, Y and Z readings, convert
+     * them with toMeasurement()
+     */
+    void readRaw(long *raw);
+
+    /**
+     * @brief Converts raw readings to the units of getSample()
+     *
+     * @param raw X, Y and Z from readRaw()
+     * @param calibrated false to leave out the calibration, as needed to
+     * calibrate
+     * @return ADXL355Measurement the converted measurement
+     */
+    ADXL355Measurement toMeasurement(const long *raw, bool calibrated = true);
+
+    /**
+     * @brief Corrects every measurement from here on with a calibration
+     *
+     * The gain is folded into the nominal scale once here, so applying it
+     * costs nine multiply-adds per measurement and no division.
+     *
+     * @param calibration the calibration from ADXL355Calibrator
+     * @return true if the calibration is in use
+     * @return false if its version doesn't match, the nominal scale is used
+     */
+    bool setCalibration(const ADXL355Calibration &calibration);
+
     /**
      * @brief Query the status of the accelerometer
      *
@@ -123,6 +185,44 @@ class ADXL355 {
      */
     ADXL355Measurement getSample();
 
+    /**
+     * @brief Get the number of complete X, Y, Z sets queued in the FIFO
+     *
+     * @return byte number of sets (0 to ADXL355_FIFO_SETS)
+     */
+    byte getFifoSets();
+
+    /**
+     * @brief Drains the FIFO in one burst, oldest set first
+     *
+     * All the queued sets are read in a single chip select assertion, since
+     * the FIFO_DATA address doesn't auto-increment. Reading starts at the
+     * first X axis entry, so a partial set left over from an overflow is
+     * skipped.
+     *
+     * @param measurements overwritten with the measurements, in the same
+     * units as getSample()
+     * @param capacity most measurements to read (at most ADXL355_FIFO_SETS
+     * are ever queued)
+     * @return byte number of measurements read
+     */
+    byte readFifo(ADXL355Measurement *measurements, byte capacity)
+    {
+        return readFifo(measurements, capacity, getFifoSets());
+    };
+
+    /**
+     * @brief Drains the FIFO like readFifo(), when the number of sets queued
+     * is already known from getFifoSets(). Sets that arrived since then are
+     * left for the next call.
+     *
+     * @param measurements overwritten with the measurements
+     * @param capacity most measurements to read
+     * @param sets what getFifoSets() returned
+     * @return byte number of measurements read
+     */
+    byte readFifo(ADXL355Measurement *measurements, byte capacity, byte sets);
+
   private:
     int chipselect;
     int chipselect2;
@@ -130,10 +230,18 @@ class ADXL355 {
     long axes[3];
     int range;
 
+    ADXL355Calibration calibration;
+    //! Raw reading to measurement, with the calibration gain folded in
+    float correction[3][3];
+    float nominalScale;
+
+    void updateCorrection();
+
     void spi_multibyte_read(byte *buffer, int numBytes, byte startaddress);
     void spi_writebyte(byte address, byte toWrite);
     byte spi_readbyte(byte address);
     void setCS(bool active);
+    static long decodeAxis(byte high, byte middle, byte low);
 };
 
 #endif
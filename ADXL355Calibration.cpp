@@ -0,0 +1,155 @@
+#include "ADXL355Calibration.h"
+
+void ADXL355Calibrator::reset()
+{
+    memset(normal, 0, sizeof(normal));
+    memset(moment, 0, sizeof(moment));
+    count = 0;
+}
+
+ADXL355Calibrator::CaptureResult
+ADXL355Calibrator::captureStatic(ADXL355 &accel, ADXL355Measurement &average,
+                                 int samples)
+{
+    double sum[3] = {0, 0, 0};
+    double sumSquares[3] = {0, 0, 0};
+    for (int n = 0; n < samples; n++) {
+        unsigned long waitStart = millis();
+        while (!accel.dataReady()) {
+            if (millis() - waitStart > k_sampleTimeoutMillis) {
+                return CAPTURE_TIMEOUT;
+            }
+        }
+        long raw[3];
+        accel.readRaw(raw);
+        ADXL355Measurement measure = accel.toMeasurement(raw, false);
+        const double value[3] = {measure.x, measure.y, measure.z};
+        for (int i = 0; i < 3; i++) {
+            sum[i] += value[i];
+            sumSquares[i] += value[i] * value[i];
+        }
+    }
+
+    bool still = true;
+    const double limit =
+        k_maximumStaticDeviation * ADXL355_MEASUREMENT_PER_G;
+    double mean[3];
+    for (int i = 0; i < 3; i++) {
+        mean[i] = sum[i] / samples;
+        double variance = sumSquares[i] / samples - mean[i] * mean[i];
+        if (variance > limit * limit) {
+            still = false;
+        }
+    }
+    average.x = mean[0];
+    average.y = mean[1];
+    average.z = mean[2];
+    return still ? CAPTURE_STATIC : CAPTURE_MOVED;
+}
+
+ADXL355Measurement ADXL355Calibrator::getPose(byte pose)
+{
+    ADXL355Measurement reference = {0, 0, 0};
+    double g = (pose % 2 == 0) ? ADXL355_MEASUREMENT_PER_G
+                               : -ADXL355_MEASUREMENT_PER_G;
+    switch ((pose / 2) % 3) {
+    case 0:
+        reference.x = g;
+        break;
+    case 1:
+        reference.y = g;
+        break;
+    default:
+        reference.z = g;
+        break;
+    }
+    return reference;
+}
+
+void ADXL355Calibrator::addOrientation(const ADXL355Measurement &measured,
+                                       const ADXL355Measurement &reference)
+{
+    const double m[4] = {measured.x, measured.y, measured.z, 1};
+    const double r[3] = {reference.x, reference.y, reference.z};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            normal[i][j] += m[i] * m[j];
+        }
+        for (int j = 0; j < 3; j++) {
+            moment[i][j] += m[i] * r[j];
+        }
+    }
+    count++;
+}
+
+bool ADXL355Calibrator::solve(ADXL355Calibration &result)
+{
+    if (count < k_minimumOrientations) {
+        return false;
+    }
+
+    // normal * [gain | offset]^T = moment, by Gauss-Jordan elimination with
+    // partial pivoting on copies, so more orientations can still be added
+    double a[4][4];
+    double solution[4][3];
+    memcpy(a, normal, sizeof(a));
+    memcpy(solution, moment, sizeof(solution));
+    // Orientations that don't span all three axes leave a pivot at rounding
+    // level, relative to the size of the sums
+    double scale = 0;
+    for (int i = 0; i < 4; i++) {
+        scale = (a[i][i] > scale) ? a[i][i] : scale;
+    }
+    for (int col = 0; col < 4; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < 4; row++) {
+            if (fabs(a[row][col]) > fabs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (!(fabs(a[pivot][col]) > scale * 1e-9)) {
+            return false;
+        }
+        for (int j = 0; j < 4; j++) {
+            double swap = a[col][j];
+            a[col][j] = a[pivot][j];
+            a[pivot][j] = swap;
+        }
+        for (int j = 0; j < 3; j++) {
+            double swap = solution[col][j];
+            solution[col][j] = solution[pivot][j];
+            solution[pivot][j] = swap;
+        }
+
+        // The pivot row is scaled to 1 first, both sides of it, so the rows
+        // done before stay consistent as it is taken out of them
+        double inverse = 1 / a[col][col];
+        for (int j = col; j < 4; j++) {
+            a[col][j] *= inverse;
+        }
+        for (int j = 0; j < 3; j++) {
+            solution[col][j] *= inverse;
+        }
+        for (int row = 0; row < 4; row++) {
+            if (row == col) {
+                continue;
+            }
+            double factor = a[row][col];
+            for (int j = col; j < 4; j++) {
+                a[row][j] -= factor * a[col][j];
+            }
+            for (int j = 0; j < 3; j++) {
+                solution[row][j] -= factor * solution[col][j];
+            }
+        }
+    }
+
+    result.version = ADXL355_CALIBRATION_VERSION;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            result.gain[i][j] = solution[j][i];
+        }
+        result.offset[i] = solution[3][i];
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+/**
+ * @file ADXL355Calibration.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Solves an ADXL355's offset, gain and cross-axis coupling from
+ * static orientations
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef ADXL355_CALIBRATION_GUARD_H
+#define ADXL355_CALIBRATION_GUARD_H
+
+#include "ADXL355.h"
+
+/**
+ * @brief Collects static orientations and fits an ADXL355Calibration to them
+ *
+ * Each orientation pairs the averaged nominal measurement with the gravity
+ * vector it should read. The twelve parameters of corrected = gain * nominal +
+ * offset are then a linear least squares fit. Only the 4x4 normal equations
+ * are kept, so any number of orientations fits in the same memory. Six
+ * orientations, each axis pointing up and down (see getPose()), determine
+ * every parameter; more of them average out the noise.
+ */
+class ADXL355Calibrator {
+  public:
+    //! Fewest orientations solve() accepts
+    static constexpr byte k_minimumOrientations = 6;
+
+    //! Largest standard deviation, in g, of a capture that is still static
+    static constexpr double k_maximumStaticDeviation = 0.02;
+
+    //! Longest wait for a single sample, a few periods at the slowest output
+    //! data rate (ms)
+    static constexpr unsigned long k_sampleTimeoutMillis = 1000;
+
+    /**
+     * @brief Outcome of captureStatic()
+     */
+    enum CaptureResult {
+        //! The average is usable
+        CAPTURE_STATIC,
+        //! The accelerometer moved during the capture
+        CAPTURE_MOVED,
+        //! A sample didn't arrive within k_sampleTimeoutMillis
+        CAPTURE_TIMEOUT
+    };
+
+    ADXL355Calibrator() { reset(); };
+
+    /**
+     * @brief Forgets all captured orientations
+     */
+    void reset();
+
+    /**
+     * @brief Averages measurements while the accelerometer sits still
+     *
+     * Blocks until the samples are in, which takes 16 s at the 3.9 Hz output
+     * data rate, or until one of them takes too long. The calibration is
+     * left out, so this works with a calibration in use too. Don't use it
+     * while the ADXL355Inclinometer's DRDY interrupt is running.
+     *
+     * @param accel the accelerometer, after begin()
+     * @param average overwritten with the average (getSample() units)
+     * @param samples number of samples to average
+     * @return CaptureResult CAPTURE_STATIC if the average can be used
+     */
+    static CaptureResult captureStatic(ADXL355 &accel,
+                                       ADXL355Measurement &average,
+                                       int samples = 64);
+
+    /**
+     * @brief Gravity in one of the six standard poses: +X, -X, +Y, -Y, +Z
+     * and -Z pointing up
+     *
+     * @param pose 0 to 5
+     * @return ADXL355Measurement what a perfect sensor reads in that pose
+     */
+    static ADXL355Measurement getPose(byte pose);
+
+    /**
+     * @brief Adds one static orientation
+     *
+     * @param measured the average from captureStatic()
+     * @param reference the gravity vector the sensor should read
+     */
+    void addOrientation(const ADXL355Measurement &measured,
+                        const ADXL355Measurement &reference);
+
+    /**
+     * @brief Get the number of orientations added since reset()
+     *
+     * @return byte orientation count
+     */
+    byte getOrientationCount() { return count; };
+
+    /**
+     * @brief Fits the calibration to the orientations
+     *
+     * @param result overwritten with the calibration, if it could be solved
+     * @return true if it was solved
+     * @return false if there are too few orientations or they don't span
+     * all three axes
+     */
+    bool solve(ADXL355Calibration &result);
+
+  private:
+    //! Sum of [m 1]^T [m 1] over the measurements m
+    double normal[4][4];
+    //! Sum of [m 1]^T r over the measurements m and references r
+    double moment[4][3];
+    byte count;
+};
+
+#endif
\ No newline at end of file
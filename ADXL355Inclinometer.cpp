@@ -1,33 +1,220 @@
 #include "ADXL355Inclinometer.h"
 
+#include "FastMath.h"
 #include "FaultHandling.h"
 
-Eigen::Vector2d Inclinometer::ADXL355Inclinometer::getData()
+Inclinometer::ADXL355Inclinometer
+    *Inclinometer::ADXL355Inclinometer::interruptInstance = NULL;
+
+bool Inclinometer::ADXL355Inclinometer::begin()
+{
+    if (!accel.begin(ADXL355_RANGE_2G, filter)) {
+        return false;
+    }
+    if (drdyPin < 0) {
+        return true;
+    }
+
+    // The interrupt goes through a static trampoline, so only one
+    // accelerometer can use it
+    if (interruptInstance != NULL && interruptInstance != this) {
+        return false;
+    }
+    interruptInstance = this;
+
+    pinMode(drdyPin, INPUT);
+    int interrupt = digitalPinToInterrupt(drdyPin);
+    // Every other SPI transaction holds off the interrupt, so the ISR never
+    // lands in the middle of one
+    SPI.usingInterrupt(interrupt);
+    attachInterrupt(interrupt, onDataReady, RISING);
+
+    // DRDY may have gone high before the interrupt was attached, and only
+    // falls once the data is read, so read it once to get the edges going
+    long raw[3];
+    accel.readRaw(raw);
+    return true;
+}
+
+bool Inclinometer::ADXL355Inclinometer::hasData()
+{
+    if (drdyPin >= 0) {
+        return !interruptQueue.empty();
+    }
+    // FIFO_ENTRIES costs the same SPI read as STATUS, and readAll() can use
+    // the count instead of reading it again
+    if (fifoSets == 0) {
+        pollFifo();
+    }
+    return fifoSets > 0;
+}
+
+void Inclinometer::ADXL355Inclinometer::pollFifo()
 {
+    unsigned long now = micros();
+    fifoSets = accel.getFifoSets();
+    if (fifoSets == 0) {
+        emptyMicros = now;
+    }
+    else {
+        seenMicros = now;
+    }
+}
+
+unsigned long Inclinometer::ADXL355Inclinometer::fifoSampleTime()
+{
+    // The newest set came in after the last poll that found the FIFO empty,
+    // and no more than a sample period before the poll that found it, so it
+    // is put in the middle of that window
+    unsigned long window = seenMicros - emptyMicros;
+    if (window > getSamplePeriod()) {
+        window = getSamplePeriod();
+    }
+    return seenMicros - window / 2;
+}
+
+void Inclinometer::ADXL355Inclinometer::onDataReady()
+{
+    if (interruptInstance != NULL) {
+        interruptInstance->sampleFromInterrupt();
+    }
+}
+
+void Inclinometer::ADXL355Inclinometer::sampleFromInterrupt()
+{
+    // Only the SPI read happens here, the conversion waits for readAll()
+    RawSample sample;
+    sample.timestamp = micros();
+    accel.readRaw(sample.raw);
+    if (!interruptQueue.push(sample)) {
+        droppedSamples++;
+    }
+}
+
+unsigned long Inclinometer::ADXL355Inclinometer::getDroppedSampleCount()
+{
+    // Four bytes, which the ISR could change halfway through reading them
+    noInterrupts();
+    unsigned long count = droppedSamples;
+    interrupts();
+    return count;
+}
+
+Rotation::Vec2 Inclinometer::ADXL355Inclinometer::getData()
+{
+    // hasData() goes by what is queued, so that is what gets read, or it
+    // would never run dry
+    Sample sample;
+    if (readAll(&sample, 1) > 0) {
+        return sample.angles;
+    }
+
     ADXL355Measurement measure;
     accel.takeSample();
+    sampleTimestamp = micros() - filterDelayMicros;
     measure = accel.getSample();
 
-    // MAGNITUDE PLAUSIBILITY CHECK
-    const double gBand = 0.25;
-    double scale = sqrt(pow(measure.x / 16.0, 2) + pow(measure.y / 16.0, 2) +
-                        pow(measure.z / 16.0, 2));
-    if (scale > 1.0 + gBand || scale < 1.0 - gBand) {
+    magnitudePlausible = checkMagnitude(measure);
+    if (!magnitudePlausible) {
         Fault::Handler::instance()->setFaultCode(Fault::INCL_IMPLAUS_READ);
     }
 
     // Apply EWMA filtering
-    movingAverageFilter.addData(measure);
-    measure = movingAverageFilter.getAverage();
+    addToFilter(measure);
+    return toAngles(getFiltered());
+}
+
+void Inclinometer::ADXL355Inclinometer::addToFilter(
+    const ADXL355Measurement &measure)
+{
+    accelerationFilter.add(0, measure.x);
+    accelerationFilter.add(1, measure.y);
+    accelerationFilter.add(2, measure.z);
+}
+
+ADXL355Measurement Inclinometer::ADXL355Inclinometer::getFiltered()
+{
+    ADXL355Measurement filtered;
+    filtered.x = accelerationFilter.get(0);
+    filtered.y = accelerationFilter.get(1);
+    filtered.z = accelerationFilter.get(2);
+    return filtered;
+}
+
+bool Inclinometer::ADXL355Inclinometer::checkMagnitude(
+    const ADXL355Measurement &measure)
+{
+    // MAGNITUDE PLAUSIBILITY CHECK, on the square so no sqrt is needed for
+    // every sample in a batch
+    const double gBand = 0.25;
+    double squared = (measure.x * measure.x + measure.y * measure.y +
+                      measure.z * measure.z) /
+                     256.0;
+    return squared <= (1.0 + gBand) * (1.0 + gBand) &&
+           squared >= (1.0 - gBand) * (1.0 - gBand);
+}
+
+Rotation::Vec2
+Inclinometer::ADXL355Inclinometer::toAngles(ADXL355Measurement measure)
+{
+    // Same angles as atan(y / z) and atan(-x / sqrt(y^2 + z^2)), to within
+    // 0.002 degrees, without normalizing or calling libm
+    float pitch, roll;
+    FastMath::tiltFromGravity(measure.x, measure.y, measure.z, pitch, roll);
+    return Rotation::Vec2(pitch, roll);
+}
 
-    scale = sqrt(pow(measure.x / 16.0, 2) + pow(measure.y / 16.0, 2) +
-                 pow(measure.z / 16.0, 2));
+byte Inclinometer::ADXL355Inclinometer::readAll(Sample *samples, byte capacity)
+{
+    // Everything queued in the FIFO (or by the DRDY interrupt) goes through
+    // the filter as one batch, and only the result is handed on. A high ODR
+    // then oversamples, instead of multiplying the work done by the model.
+    if (capacity == 0) {
+        return 0;
+    }
+    byte count = 0;
+    if (drdyPin >= 0) {
+        RawSample sample;
+        while (count < ADXL355_FIFO_SETS && interruptQueue.pop(sample)) {
+            fifoBuffer[count++] = accel.toMeasurement(sample.raw);
+            sampleTimestamp = sample.timestamp;
+        }
+    }
+    else {
+        if (fifoSets == 0) {
+            pollFifo();
+        }
+        count = accel.readFifo(fifoBuffer, ADXL355_FIFO_SETS, fifoSets);
+        fifoSets = 0;
+        if (count > 0) {
+            sampleTimestamp = fifoSampleTime();
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+    // The angles are the EWMA's, which lag the newest sample
+    sampleTimestamp -= filterDelayMicros;
 
-    Eigen::Vector3d normalized = Eigen::Vector3d(
-        measure.x / scale, measure.y / scale, measure.z / scale);
+    magnitudePlausible = true;
+    for (byte i = 0; i < count; i++) {
+        if (!checkMagnitude(fifoBuffer[i])) {
+            magnitudePlausible = false;
+        }
+    }
+    if (!magnitudePlausible) {
+        Fault::Handler::instance()->setFaultCode(Fault::INCL_IMPLAUS_READ);
+    }
 
-    double pitch = atan(normalized[1] / normalized[2]);
-    double roll = atan((-normalized[0]) /
-                       sqrt(pow(normalized[1], 2) + pow(normalized[2], 2)));
-    return Eigen::Vector2d(pitch, roll);
+    for (byte i = 0; i < count; i++) {
+        addToFilter(fifoBuffer[i]);
+    }
+    samples[0].angles = toAngles(getFiltered());
+    samples[0].timestamp = sampleTimestamp;
+    // Off-magnitude readings mean the chip is accelerating or failing
+    samples[0].quality.figureOfMerit =
+        magnitudePlausible ? MERIT_FULL : MERIT_DEGRADED;
+    samples[0].quality.compensation = COMPENSATION_NOT_AVAILABLE;
+    samples[0].quality.latency = 0;
+    return 1;
 }
\ No newline at end of file
@@ -13,8 +13,9 @@
 #define ADLX355_INCLINOMETER_MODULE_H
 
 #include "ADXL355.h"
-#include "AccelerometerFiltering.h"
+#include "Filters.h"
 #include "InclinometerInterface.h"
+#include "SpscRing.h"
 
 namespace Inclinometer {
 
@@ -22,7 +23,7 @@ namespace Inclinometer {
  * @brief An implementation of an InclinometerDataSource using an ADXL355
  * accelerometer and some math.
  */
-class ADXL355Inclinometer : public InclinometerDataSource {
+class ADXL355Inclinometer final : public InclinometerDataSource {
   public:
     /**
      * @brief Construct a new ADXL355Inclinometer object
@@ -30,26 +31,107 @@ class ADXL355Inclinometer : public InclinometerDataSource {
      * @param cs chip select 1
      * @param cs2 chip select 2 (if used)
      * @param ewmaAlpha exponentially weighted moving average filtering
-     * coefficient
+     * coefficient, 1.0 to hand on every sample unsmoothed (e.g. to a
+     * FusedInclinometer, which estimates the noise from the samples)
      * @param filter the digital filter within the ADXL355 to use
      * @param speed the SPI speed to use (Hz)
+     * @param drdyPin the pin wired to the ADXL355's DRDY output, to take
+     * every sample in its interrupt. Must be an external interrupt pin. -1
+     * (default) drains the FIFO from readAll() instead.
      */
     ADXL355Inclinometer(int cs, int cs2 = -1, double ewmaAlpha = 0.1,
                         byte filter = ADXL355_FILTER_LPF_4HZ_ODR,
-                        int speed = 5000000 /*5000000 625000*/)
+                        int speed = 5000000 /*5000000 625000*/,
+                        int drdyPin = -1)
         : accel(cs, speed, cs2), filter(filter),
-          movingAverageFilter(0.0, ewmaAlpha){};
+          filterDelayMicros((1.0 - ewmaAlpha) / ewmaAlpha *
+                            getSamplePeriod()),
+          sampleTimestamp(0), magnitudePlausible(true), fifoSets(0),
+          emptyMicros(0), seenMicros(0), drdyPin(drdyPin),
+          droppedSamples(0), accelerationFilter(AxisFilter(ewmaAlpha)){};
+
+    //! Filter run on each axis of the acceleration. Swap in a Filter::Chain
+    //! to trade lag for noise differently.
+    typedef Filter::Ewma<double> AxisFilter;
+
+    //! Samples the DRDY interrupt can queue before they are read
+    static constexpr byte k_interruptQueueSize = 16;
 
     //! Inclinometer Data Source Interface Methods
 
-    bool begin() override { return accel.begin(ADXL355_RANGE_2G, filter); }
-    bool hasData() override { return accel.dataReady(); };
-    Eigen::Vector2d getData() override;
+    bool begin() override;
+    bool hasData() override;
+    Rotation::Vec2 getData() override;
+    unsigned long getTimestamp() override { return sampleTimestamp; };
+    byte readAll(Sample *samples, byte capacity) override;
+    bool getRates(RateSample &) override { return false; };
+    // The low bits of the filter setting halve the 4 kHz ODR for each step
+    unsigned long getSamplePeriod() override
+    {
+        return 250UL << (filter & 0x0F);
+    };
+
+    /**
+     * @brief Get the number of samples the DRDY interrupt had to drop
+     * because the queue was full
+     *
+     * @return unsigned long dropped sample count
+     */
+    unsigned long getDroppedSampleCount();
+
+    /**
+     * @brief Get the accelerometer, e.g. to capture calibration orientations
+     * with ADXL355Calibrator (before the DRDY interrupt is attached)
+     *
+     * @return ADXL355& the accelerometer
+     */
+    ADXL355 &getAccelerometer() { return accel; };
 
   private:
     ADXL355 accel;
-    AccelerometerFilterMovingAverage movingAverageFilter;
+    //! The ADXL355 filter setting, which also sets the ODR
     byte filter;
+    //! How far the EWMA lags the newest sample, (1 - alpha) / alpha sample
+    //! periods (microseconds)
+    unsigned long filterDelayMicros;
+    //! When the angles were measured, less the EWMA's lag
+    unsigned long sampleTimestamp;
+    bool magnitudePlausible;
+
+    //! Measurements drained from the FIFO or interrupt queue by readAll()
+    ADXL355Measurement fifoBuffer[ADXL355_FIFO_SETS];
+    //! Sets hasData() counted in the FIFO, which readAll() hasn't read yet
+    byte fifoSets;
+    //! micros() of the last poll that found the FIFO empty, and of the one
+    //! that counted fifoSets
+    unsigned long emptyMicros;
+    unsigned long seenMicros;
+
+    void pollFifo();
+    unsigned long fifoSampleTime();
+
+    /**
+     * @brief A reading taken in the DRDY interrupt, converted later
+     */
+    typedef struct {
+        long raw[3];
+        unsigned long timestamp;
+    } RawSample;
+
+    int drdyPin;
+    SpscRing<RawSample, k_interruptQueueSize> interruptQueue;
+    volatile unsigned long droppedSamples;
+
+    //! The accelerometer that owns the DRDY interrupt
+    static ADXL355Inclinometer *interruptInstance;
+    static void onDataReady();
+    void sampleFromInterrupt();
+
+    bool checkMagnitude(const ADXL355Measurement &measure);
+    Rotation::Vec2 toAngles(ADXL355Measurement measure);
+    Filter::Axes<AxisFilter, 3> accelerationFilter;
+    void addToFilter(const ADXL355Measurement &measure);
+    ADXL355Measurement getFiltered();
 };
 }; // namespace Inclinometer
 
@@ -1,8 +1,14 @@
 #include "CANInterface.h"
 
 CAN::RawInterface::RawInterface(HardwareSerial &serialInterface)
-    : serialInterface(serialInterface)
+    : serialInterface(serialInterface), bringupState(BRINGUP_NONE),
+      detectedBaud(baud_START), bringupMillis(0), atLineLength(0), rxHead(0),
+      rxCount(0), rxRunHead(0), rxRunCount(0), rxLocked(false),
+      rxFiltersActive(false), rxLastByteMicros(0), rxIdleMicros(0),
+      rxDiscardedBytes(0), rxResyncEvents(0), txHead(0), txCount(0),
+      txDroppedFrames(0)
 {
+    clearFilters();
 }
 
 unsigned long CAN::RawInterface::serialBaudToBaud(CAN::SerialBaudrate s)
@@ -21,60 +27,266 @@ unsigned long CAN::RawInterface::serialBaudToBaud(CAN::SerialBaudrate s)
     }
 }
 
-void CAN::RawInterface::resetBaudTo(CAN::SerialBaudrate s)
+void CAN::RawInterface::begin(
+    CAN::SerialBaudrate serial = CAN::SerialBaudrate::baud_115200,
+    CAN::CANBusBaudrate can = CAN::CANBusBaudrate::kbps_250)
+{
+    targetSerialBaud = serial;
+    targetCanBaud = can;
+    probeIndex = 0;
+    probeRounds = 0;
+    bringupStartMillis = millis();
+    startProbe();
+}
+
+bool CAN::RawInterface::step()
+{
+    unsigned long elapsed = millis() - stateStartMillis;
+
+    switch (bringupState) {
+    case BRINGUP_PROBE_GUARD:
+        if (pollAtResponse()) {
+            onProbeResponse();
+        }
+        else if (elapsed >= k_atGuardMillis) {
+            serialInterface.println("AT");
+            enterBringupState(BRINGUP_PROBE_RESPONSE);
+        }
+        break;
+    case BRINGUP_PROBE_RESPONSE:
+        if (pollAtResponse()) {
+            onProbeResponse();
+        }
+        else if (elapsed >= k_atResponseTimeoutMillis) {
+            // Nothing intelligible at this baudrate, try the next one
+            if (++probeIndex >= baud_END) {
+                probeIndex = 0;
+                if (++probeRounds >= k_maxProbeRounds) {
+                    enterBringupState(BRINGUP_FAILED);
+                    break;
+                }
+            }
+            startProbe();
+        }
+        break;
+    case BRINGUP_SET_BAUD:
+        // The module acknowledges at the old baudrate before switching, so
+        // verify that it answers at the new one
+        if (pollAtResponse() || elapsed >= k_atResponseTimeoutMillis) {
+            probeIndex = 0;
+            startProbe();
+        }
+        break;
+    case BRINGUP_CONFIGURE:
+        if (pollAtResponse()) {
+            configStep++;
+            configRetries = 0;
+            sendConfigCommand();
+        }
+        else if (elapsed >= k_atResponseTimeoutMillis) {
+            // Going on would leave the module at the wrong bus baudrate or
+            // with the wrong filters, so send the command again
+            if (++configRetries > k_maxConfigRetries) {
+                enterBringupState(BRINGUP_FAILED);
+                break;
+            }
+            sendConfigCommand();
+        }
+        break;
+    default:
+        break;
+    }
+
+    return isReady();
+}
+
+void CAN::RawInterface::enterBringupState(BringupState state)
+{
+    bringupState = state;
+    stateStartMillis = millis();
+    atLineLength = 0;
+}
+
+CAN::SerialBaudrate CAN::RawInterface::probeBaud()
 {
-    for (int baud = baud_START; baud < baud_END; ++baud) {
-        serialInterface.begin(serialBaudToBaud(baud));
-        serialInterface.print("+++");
-        delay(10);
+    // Probe the requested baudrate first, then all of the others in order
+    if (probeIndex == 0) {
+        return targetSerialBaud;
+    }
+    int baud = probeIndex - 1;
+    if (baud >= targetSerialBaud) {
+        baud++;
+    }
+    return (SerialBaudrate)baud;
+}
+
+void CAN::RawInterface::startProbe()
+{
+    serialInterface.begin(serialBaudToBaud(probeBaud()));
+    while (serialInterface.available())
+        serialInterface.read();
+    serialInterface.print("+++");
+    enterBringupState(BRINGUP_PROBE_GUARD);
+}
+
+void CAN::RawInterface::onProbeResponse()
+{
+    detectedBaud = probeBaud();
+    if (detectedBaud == targetSerialBaud) {
+        configStep = 0;
+        configRetries = 0;
+        sendConfigCommand();
+    }
+    else {
         char atCommand[7];
-        sprintf(atCommand, "AT+S=%d", (unsigned int)s);
-        atCommand[6] = '\0';
+        sprintf(atCommand, "AT+S=%d", (unsigned int)targetSerialBaud);
+        serialInterface.println(atCommand);
+        // The command has to be fully sent before the UART changes speed.
+        // This is a few bytes, so it only waits for a moment.
+        serialInterface.flush();
+        serialInterface.begin(serialBaudToBaud(targetSerialBaud));
+        enterBringupState(BRINGUP_SET_BAUD);
+    }
+}
+
+void CAN::RawInterface::sendConfigCommand()
+{
+    // Steps: CAN baudrate, masks, filters, then data mode
+    constexpr byte maskStep = 1;
+    constexpr byte filterStep = maskStep + mask_END;
+    constexpr byte quitStep = filterStep + filter_END;
+
+    // Without filtering, only the default mask is needed
+    if (!filteringEnabled && configStep > maskStep && configStep < quitStep) {
+        configStep = quitStep;
+    }
+
+    char atCommand[24];
+    if (configStep == 0) {
+        // Set the baudrate of the can bus
+        sprintf(atCommand, "AT+C=%d", (unsigned int)targetCanBaud);
         serialInterface.println(atCommand);
-        delay(50);
+    }
+    else if (configStep < filterStep) {
+        // Set a read mask
+        byte slot = configStep - maskStep;
+        sprintf(atCommand, "AT+M=[%d][%d][%08lX]", slot,
+                masks[slot].extended ? 1 : 0, masks[slot].id);
+        serialInterface.println(atCommand);
+    }
+    else if (configStep < quitStep) {
+        // Set a read filter
+        byte slot = configStep - filterStep;
+        sprintf(atCommand, "AT+F=[%d][%d][%08lX]", slot,
+                filters[slot].extended ? 1 : 0, filters[slot].id);
+        serialInterface.println(atCommand);
+    }
+    else if (configStep == quitStep) {
+        // Enter data mode
+        serialInterface.println("AT+Q");
+    }
+    else {
+        // Clear the read buffer of any AT responses
         flushBuffer();
+        rxFiltersActive = filteringEnabled;
+        rxIdleMicros =
+            k_rxIdleBits * 1000000UL / serialBaudToBaud(targetSerialBaud);
+        bringupMillis = millis() - bringupStartMillis;
+        enterBringupState(BRINGUP_READY);
+        return;
     }
-    serialInterface.begin(serialBaudToBaud(s));
-    serialInterface.print("+++");
-    flushBuffer();
+    enterBringupState(BRINGUP_CONFIGURE);
 }
 
-void CAN::RawInterface::begin(
-    CAN::SerialBaudrate serial = CAN::SerialBaudrate::baud_115200,
-    CAN::CANBusBaudrate can = CAN::CANBusBaudrate::kbps_250)
+void CAN::RawInterface::setMask(CAN::AcceptanceMask slot, unsigned long mask,
+                                bool extended)
 {
-    // Set the baudrate of the serial bus
-    resetBaudTo(serial);
+    masks[slot].id = mask;
+    masks[slot].extended = extended;
+    filteringEnabled = true;
+    rxFiltersActive = false;
+}
 
-    // Set the baudrate of the can bus
-    char atCommand[8];
-    sprintf(atCommand, "AT+C=%d", (unsigned int)can);
-    serialInterface.println(atCommand);
+void CAN::RawInterface::setFilter(CAN::AcceptanceFilter slot, unsigned long id,
+                                  bool extended)
+{
+    filters[slot].id = id;
+    filters[slot].extended = extended;
+    filteringEnabled = true;
+    rxFiltersActive = false;
+}
 
-    // Set a read mask
-    serialInterface.println("AT+M=[0][1][1FFFFFFF]");
-    delay(100);
+void CAN::RawInterface::clearFilters()
+{
+    filteringEnabled = false;
+    rxFiltersActive = false;
+    for (int i = mask_START; i < mask_END; i++) {
+        masks[i].id = k_defaultMask;
+        masks[i].extended = true;
+    }
+    for (int i = filter_START; i < filter_END; i++) {
+        filters[i].id = 0;
+        filters[i].extended = true;
+    }
+}
 
-    // Enter data mode
-    serialInterface.println("AT+Q");
-    delay(100);
+void CAN::RawInterface::applyFilters()
+{
+    // The filters can only be changed in AT mode, so run the bring-up again.
+    // The module is already at the right baudrate, so the first probe works.
+    if (bringupState != BRINGUP_NONE) {
+        begin(targetSerialBaud, targetCanBaud);
+    }
+}
 
-    // Clear the read buffer
-    flushBuffer();
+bool CAN::RawInterface::pollAtResponse()
+{
+    while (serialInterface.available()) {
+        char c = serialInterface.read();
+        if (c == '\n') {
+            atLine[atLineLength] = '\0';
+            atLineLength = 0;
+            if (strstr(atLine, "OK") != NULL) {
+                return true;
+            }
+        }
+        else if (c != '\r' && atLineLength < sizeof(atLine) - 1) {
+            atLine[atLineLength++] = c;
+        }
+    }
+    return false;
 }
 
 void CAN::RawInterface::flushBuffer()
 {
     while (serialInterface.available())
         serialInterface.read();
+    rxHead = 0;
+    rxCount = 0;
+    rxRunCount = 0;
+    // The module may have been in the middle of a frame
+    rxLocked = false;
 }
 
-void CAN::RawInterface::write(ExtendedCanDataPacket p, bool extBit = true,
-                              bool rtrBit = false)
+bool CAN::RawInterface::write(const ExtendedCanDataPacket &p,
+                              bool extBit = true, bool rtrBit = false)
 {
-    unsigned char dta[14] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    return queueFrame(p.id, p.data, extBit, rtrBit);
+}
+
+bool CAN::RawInterface::queueFrame(unsigned long id, const byte *data,
+                                   bool extBit, bool rtrBit)
+{
+    if (txCount == k_txQueueDepth) {
+        // Try to make room before giving up on the frame
+        flushTx();
+        if (txCount == k_txQueueDepth) {
+            txDroppedFrames++;
+            return false;
+        }
+    }
 
-    unsigned long id = p.id;
+    byte *dta = txQueue[(txHead + txCount) & (k_txQueueDepth - 1)];
     dta[0] = id >> 24;        // id3
     dta[1] = id >> 16 & 0xff; // id2
     dta[2] = id >> 8 & 0xff;  // id1
@@ -83,30 +295,44 @@ void CAN::RawInterface::write(ExtendedCanDataPacket p, bool extBit = true,
     dta[4] = (extBit == true) ? 1 : 0;
     dta[5] = (rtrBit == true) ? 1 : 0;
 
-    for (int i = 0; i < 8; i++) {
-        dta[6 + i] = p.data[i];
+    memcpy(dta + 6, data, 8);
+    txCount++;
+
+    flushTx();
+    return true;
+}
+
+void CAN::RawInterface::flushTx()
+{
+    // Frames stay queued until the module is in data mode
+    if (!isReady()) {
+        return;
     }
 
-    for (int i = 0; i < 14; i++) {
-        serialInterface.write(dta[i]);
+    // Only hand complete frames to the UART, so a frame is never split
+    // between loop iterations and write() never has to wait for room
+    while (txCount > 0 &&
+           serialInterface.availableForWrite() >= k_txFrameSize) {
+        serialInterface.write(txQueue[txHead], k_txFrameSize);
+        txHead = (txHead + 1) & (k_txQueueDepth - 1);
+        txCount--;
     }
 }
 
 bool CAN::RawInterface::read(ExtendedCanDataPacket &p)
+{
+    return readFrame(p.id, p.data, p.timestamp);
+}
+
+bool CAN::RawInterface::readFrame(unsigned long &id, byte *data,
+                                  unsigned long &timestamp)
 {
     if (hasPacket()) {
-        byte buf[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-        for (int i = 0; i < 12; i++) {
-            buf[i] = serialInterface.read();
-        }
-        unsigned long id = 0;
-        byte *data = buf + 4;
-        for (int i = 0; i < 4; i++) {
-            id <<= 8;
-            id += buf[i];
-        }
-        p.id = id;
-        memcpy(&p.data, data, 8);
+        id = peekId(0);
+        for (int i = 0; i < 8; i++) {
+            data[i] = peekRx(4 + i);
+        }
+        timestamp = dropRx(k_rxFrameSize);
         return true;
     }
     else {
@@ -116,5 +342,165 @@ bool CAN::RawInterface::read(ExtendedCanDataPacket &p)
 
 bool CAN::RawInterface::hasPacket()
 {
-    return serialInterface.available() >= 12;
-}
\ No newline at end of file
+    if (!step()) {
+        return false;
+    }
+
+    flushTx();
+
+    // A single plausible ID proves little, payloads are full of bytes that
+    // look like the start of one. Alignment is only taken from several
+    // plausible frames in a row, or from the end of the buffer once the line
+    // has gone quiet. Once locked, every frame is still checked
+    // along with the start of the one after it, so a lost byte is caught
+    // within a frame or two. Bytes thrown away make room for more from the
+    // UART, so keep going while there is no lock and more is waiting.
+    do {
+        pumpRx();
+        while (rxCount > 0 &&
+               !rxFramesValid(rxLocked ? 2 : k_rxLockFrames)) {
+            discardRx();
+        }
+    } while (!rxLocked && rxCount < k_rxLockFrames * k_rxFrameSize &&
+             serialInterface.available());
+    if (!rxLocked && rxCount >= k_rxLockFrames * k_rxFrameSize) {
+        rxLocked = true;
+    }
+    else if (!rxLocked && rxCount > 0 && !serialInterface.available() &&
+             micros() - rxLastByteMicros >= rxIdleMicros) {
+        alignToIdle();
+    }
+
+    return rxLocked && rxCount >= k_rxFrameSize;
+}
+
+void CAN::RawInterface::pumpRx()
+{
+    // Frame boundaries are only known once the parser has aligned the
+    // buffer, so the stamp goes with the bytes of this call rather than with
+    // a frame. They all get the same one anyway, so it is as fine as the
+    // loop that calls hasPacket().
+    unsigned long now = micros();
+    byte moved = 0;
+    while (rxCount < k_rxBufferSize && serialInterface.available()) {
+        rxBuffer[(rxHead + rxCount) & (k_rxBufferSize - 1)] =
+            serialInterface.read();
+        rxCount++;
+        moved++;
+    }
+    if (moved == 0) {
+        return;
+    }
+    rxLastByteMicros = now;
+
+    if (rxRunCount == k_rxRuns) {
+        // Nobody is reading, so the newest run takes these too. The bytes it
+        // already had get stamped late, by at most one loop.
+        RxRun &last = rxRuns[(rxRunHead + rxRunCount - 1) % k_rxRuns];
+        last.count += moved;
+        last.stamp = now;
+    }
+    else {
+        RxRun &run = rxRuns[(rxRunHead + rxRunCount) % k_rxRuns];
+        run.count = moved;
+        run.stamp = now;
+        rxRunCount++;
+    }
+}
+
+unsigned long CAN::RawInterface::peekId(byte offset)
+{
+    unsigned long id = 0;
+    for (byte i = 0; i < 4; i++) {
+        id <<= 8;
+        id += peekRx(offset + i);
+    }
+    return id;
+}
+
+bool CAN::RawInterface::rxFrameValid(byte offset)
+{
+    // The first byte of a frame is the MSB of the CAN ID. Both 11-bit and
+    // 29-bit IDs leave the top three bits of it clear.
+    if ((peekRx(offset) & 0xE0) != 0) {
+        return false;
+    }
+    if (!rxFiltersActive || rxCount < offset + 4) {
+        return true;
+    }
+
+    // The module only forwards IDs that pass its filters, with the same rule
+    // it uses: mask 0 goes with filters 0 and 1, mask 1 with filters 2 to 5.
+    // Standard ID rules aren't checked here, they let everything through.
+    unsigned long id = peekId(offset);
+    for (byte i = filter_START; i < filter_END; i++) {
+        const AcceptanceRule &mask = masks[(i < filter_2) ? mask_0 : mask_1];
+        if (!mask.extended || !filters[i].extended ||
+            ((id ^ filters[i].id) & mask.id) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CAN::RawInterface::rxFramesValid(byte frames)
+{
+    for (byte i = 0; i < frames; i++) {
+        byte offset = i * k_rxFrameSize;
+        if (offset >= rxCount) {
+            break;
+        }
+        if (!rxFrameValid(offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CAN::RawInterface::alignToIdle()
+{
+    // The line is quiet, so the buffer ends where a frame ends and the frames
+    // can be counted back from there. A byte lost further up misaligns every
+    // frame before it, so drop whole frames from the front until all of the
+    // rest are plausible.
+    while (rxCount % k_rxFrameSize != 0) {
+        discardRx();
+    }
+    while (rxCount > 0 && !rxFramesValid(rxCount / k_rxFrameSize)) {
+        for (byte i = 0; i < k_rxFrameSize; i++) {
+            discardRx();
+        }
+    }
+    rxLocked = rxCount > 0;
+}
+
+unsigned long CAN::RawInterface::dropRx(byte count)
+{
+    rxHead = (rxHead + count) & (k_rxBufferSize - 1);
+    rxCount -= count;
+
+    // The stamp of the run the last of these bytes came in with
+    unsigned long stamp = 0;
+    while (count > 0) {
+        RxRun &run = rxRuns[rxRunHead];
+        byte taken = (count < run.count) ? count : run.count;
+        run.count -= taken;
+        count -= taken;
+        stamp = run.stamp;
+        if (run.count == 0) {
+            rxRunHead = (rxRunHead + 1) % k_rxRuns;
+            rxRunCount--;
+        }
+    }
+    return stamp;
+}
+
+void CAN::RawInterface::discardRx()
+{
+    if (rxLocked) {
+        rxLocked = false;
+        rxResyncEvents++;
+    }
+    dropRx(1);
+    rxDiscardedBytes++;
+}
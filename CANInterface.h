@@ -58,6 +58,34 @@ enum CANBusBaudrate {
     kbps_END
 };
 
+/**
+ * @brief Acceptance masks of the CAN module. Mask 0 applies to filters 0 and
+ * 1, mask 1 applies to filters 2 through 5.
+ */
+enum AcceptanceMask { mask_START = 0, mask_0 = mask_START, mask_1, mask_END };
+
+/**
+ * @brief Acceptance filters of the CAN module
+ */
+enum AcceptanceFilter {
+    filter_START = 0,
+    filter_0 = filter_START,
+    filter_1,
+    filter_2,
+    filter_3,
+    filter_4,
+    filter_5,
+    filter_END
+};
+
+/**
+ * @brief A CAN ID (or mask) for the module's hardware acceptance filtering
+ */
+typedef struct {
+    unsigned long id;
+    bool extended;
+} AcceptanceRule;
+
 /**
  * @brief This structure represents an extended can 2.0 packet with no
  * additional formatting
@@ -65,6 +93,8 @@ enum CANBusBaudrate {
 typedef struct {
     unsigned long id;
     byte data[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    //! micros() when the last byte of the packet was taken from the UART
+    unsigned long timestamp = 0;
 } ExtendedCanDataPacket;
 
 /**
@@ -82,7 +112,15 @@ class RawInterface {
     RawInterface(HardwareSerial &serialInterface);
 
     /**
-     * @brief initializes the module
+     * @brief Starts initializing the module
+     *
+     * This does not block. The module is brought up by a state machine that
+     * is advanced by step() (which hasPacket() also calls). It first probes
+     * for the UART baudrate the module is currently using, trying the
+     * requested one first, and only sends AT+S if it differs. It then sets
+     * the CAN bus baudrate and read mask and enters data mode. A command the
+     * module doesn't acknowledge is sent again, and bring-up fails if it
+     * still isn't after k_maxConfigRetries more tries.
      *
      * @param serial Serial UART speed to run the module at (default 115200)
      * @param can CAN Bus baudrate to run at
@@ -91,22 +129,108 @@ class RawInterface {
                CANBusBaudrate can = CANBusBaudrate::kbps_250);
 
     /**
-     * @brief Writes a packet to the controller
+     * @brief Advances the module bring-up, if it is still in progress. Call
+     * this iteratively, e.g. from loop().
+     *
+     * @return true if the module is in data mode and ready
+     * @return false if the module is not ready (yet)
+     */
+    bool step();
+
+    /**
+     * @brief Checks if the module finished bring-up and is in data mode
+     *
+     * @return true if the module is ready
+     * @return false if the module is still being brought up, or failed
+     */
+    bool isReady() { return bringupState == BRINGUP_READY; };
+
+    /**
+     * @brief Checks if the module could not be found on any baudrate, or
+     * didn't acknowledge its configuration
+     *
+     * @return true if bring-up gave up
+     * @return false if bring-up succeeded or is still in progress
+     */
+    bool hasFailed() { return bringupState == BRINGUP_FAILED; };
+
+    /**
+     * @brief Get the time it took to bring the module up
+     *
+     * @return unsigned long milliseconds from begin() until the module was
+     * ready
+     */
+    unsigned long getBringupMillis() { return bringupMillis; };
+
+    /**
+     * @brief Get the UART baudrate the module was using when it was probed
+     *
+     * @return SerialBaudrate baudrate the module answered at
+     */
+    SerialBaudrate getDetectedBaud() { return detectedBaud; };
+
+    /**
+     * @brief Set one of the module's hardware acceptance masks
+     *
+     * A received ID is forwarded if, for the bits set in a mask, it matches
+     * one of the filters that mask applies to. Once any mask or filter is
+     * set, all masks and filters are sent to the module, so configure every
+     * slot. Takes effect on the next begin() or applyFilters().
+     *
+     * @param slot the mask to set
+     * @param mask bits of the ID that have to match
+     * @param extended true if filtering 29-bit IDs (default true)
+     */
+    void setMask(AcceptanceMask slot, unsigned long mask, bool extended = true);
+
+    /**
+     * @brief Set one of the module's hardware acceptance filters
+     *
+     * @see setMask()
+     *
+     * @param slot the filter to set
+     * @param id the ID to match against
+     * @param extended true if filtering 29-bit IDs (default true)
+     */
+    void setFilter(AcceptanceFilter slot, unsigned long id,
+                   bool extended = true);
+
+    /**
+     * @brief Removes all masks and filters, so the module forwards all
+     * traffic. Takes effect on the next begin() or applyFilters().
+     */
+    void clearFilters();
+
+    /**
+     * @brief Sends the masks and filters to a module that has already been
+     * started. The module briefly leaves data mode while this happens
+     * (non-blocking, see step()).
+     */
+    void applyFilters();
+
+    /**
+     * @brief Queues a packet to be written to the controller
+     *
+     * The packet is serialized into the transmit queue and sent as soon as
+     * the UART has room for the whole frame. This never blocks.
      *
      * @param p the data packet to provide to the CAN module
      * @param extBit true if using 29-bit IDs, false if using 11-bit IDs
      * (default false)
      * @param rtrBit true if the packet is a RTR packet, meaning a request for
      * data (Default false)
+     * @return true if the packet was queued
+     * @return false if the transmit queue is full and the packet was dropped
      */
-    void write(ExtendedCanDataPacket p, bool extBit = true,
+    bool write(const ExtendedCanDataPacket &p, bool extBit = true,
                bool rtrBit = false);
 
     /**
      * @brief Reads a packet from the controller, if one is available
      *
-     * NOTE: If the packet ID makes no sense, the read buffer might be offset.
-     * In this case, please call the flushBuffer() method
+     * Bytes from the UART are collected in a receive ring buffer and framed by
+     * the parser, which resynchronizes on its own if the stream is offset or
+     * corrupted (see hasPacket()).
      *
      * @param p reference to the packet object to overwrite the contents of
      * @return true if the packet was read
@@ -117,8 +241,21 @@ class RawInterface {
     /**
      * @brief Checks if a packet can be read
      *
-     * Does not check if a packet is valid, just if there are enough bytes in
-     * the buffer to read a packet
+     * Moves any bytes waiting in the UART into the receive ring buffer, then
+     * aligns the buffer to a frame boundary. An ID is plausible if it fits in
+     * 29 bits and, once filters have been applied, passes them. Alignment is
+     * taken from k_rxLockFrames plausible frames in a row, or from the end of
+     * the buffer once the line has been quiet for k_rxIdleBits bit times: the
+     * module never pauses inside a frame, so a lone frame (e.g. a reply to a
+     * request) doesn't have to wait for traffic behind it. After that, a frame
+     * is read if its ID and the ID of the frame after it (if that has arrived
+     * already) are plausible. Otherwise, bytes are discarded one at a time
+     * until the buffer lines up with frames again.
+     *
+     * Without filters, only the top three bits of an ID can be checked. If
+     * every frame has such a byte at the same place in its payload (e.g. a
+     * quality byte), that place can't be told apart from the real frame start,
+     * so set filters wherever the traffic is known.
      *
      * @return true if a packet can be read
      * @return false if a packet is not yet available
@@ -127,12 +264,209 @@ class RawInterface {
 
     /**
      * @brief Clears out the receive buffer completely
+     *
+     * This is not needed during normal operation, since the frame parser
+     * resynchronizes by itself. Use it for recovery, e.g. after reconfiguring
+     * the module.
      */
     void flushBuffer();
 
+    /**
+     * @brief Get the number of received bytes that were thrown away while
+     * resynchronizing to the frame boundaries
+     *
+     * @return unsigned long discarded byte count
+     */
+    unsigned long getDiscardedByteCount() { return rxDiscardedBytes; };
+
+    /**
+     * @brief Get the number of times the frame parser lost alignment with the
+     * byte stream and had to resynchronize
+     *
+     * @return unsigned long resync event count
+     */
+    unsigned long getResyncCount() { return rxResyncEvents; };
+
+    /**
+     * @brief Sends as many queued frames as the UART can accept without
+     * blocking. This also happens on every write() and hasPacket() call.
+     */
+    void flushTx();
+
+    /**
+     * @brief Checks if there are frames waiting in the transmit queue
+     *
+     * @return true if at least one frame has not been sent yet
+     * @return false if the transmit queue is empty
+     */
+    bool txPending() { return txCount > 0; };
+
+    /**
+     * @brief Get the number of frames that can be queued before the transmit
+     * queue is full
+     *
+     * @return byte free frame slots
+     */
+    byte getTxFree() { return k_txQueueDepth - txCount; };
+
+    /**
+     * @brief Get the number of frames dropped because the transmit queue was
+     * full
+     *
+     * @return unsigned long dropped frame count
+     */
+    unsigned long getTxDroppedCount() { return txDroppedFrames; };
+
+  protected:
+    /**
+     * @brief Reads a frame out of the receive buffer straight into the
+     * caller's storage, if one is available
+     *
+     * @param id overwritten with the CAN ID
+     * @param data overwritten with 8 bytes of payload
+     * @param timestamp overwritten with the micros() at which the last byte of
+     * the frame was taken from the UART
+     * @return true if a frame was read
+     * @return false if no frame was read
+     */
+    bool readFrame(unsigned long &id, byte *data, unsigned long &timestamp);
+
+    /**
+     * @brief Serializes a frame directly into the transmit queue
+     *
+     * @param id the CAN ID
+     * @param data 8 bytes of payload
+     * @param extBit true if using 29-bit IDs
+     * @param rtrBit true if the packet is a RTR packet
+     * @return true if the frame was queued
+     * @return false if the transmit queue is full
+     */
+    bool queueFrame(unsigned long id, const byte *data, bool extBit,
+                    bool rtrBit);
+
   private:
+    /**
+     * @brief States of the module bring-up
+     */
+    enum BringupState {
+        BRINGUP_NONE,
+        BRINGUP_PROBE_GUARD,
+        BRINGUP_PROBE_RESPONSE,
+        BRINGUP_SET_BAUD,
+        BRINGUP_CONFIGURE,
+        BRINGUP_READY,
+        BRINGUP_FAILED
+    };
+
+    //! Silence after "+++" before the module accepts AT commands (ms)
+    static constexpr unsigned long k_atGuardMillis = 10;
+
+    //! Time to wait for a reply to an AT command (ms)
+    static constexpr unsigned long k_atResponseTimeoutMillis = 40;
+
+    //! Number of passes over all baudrates before giving up
+    static constexpr byte k_maxProbeRounds = 3;
+
+    //! Number of times an unacknowledged configuration command is sent again
+    //! before giving up
+    static constexpr byte k_maxConfigRetries = 2;
+
+    //! Mask that is sent when no filtering is configured
+    static constexpr unsigned long k_defaultMask = 0x1FFFFFFF;
+
+    //! Size of a frame received from the module (4 ID bytes + 8 data bytes)
+    static constexpr byte k_rxFrameSize = 12;
+
+    //! Capacity of the receive ring buffer (must be a power of two)
+    static constexpr byte k_rxBufferSize = 64;
+
+    //! Number of receive time stamps kept, one for each frame the receive
+    //! buffer can hold
+    static constexpr byte k_rxRuns = k_rxBufferSize / k_rxFrameSize;
+
+    //! Plausible frames in a row it takes to lock onto the frame boundaries
+    //! (they have to fit in the receive buffer)
+    static constexpr byte k_rxLockFrames = 3;
+
+    //! Silence on the line, in bit times, after which the last byte received
+    //! is taken to be the end of a frame (three characters)
+    static constexpr unsigned long k_rxIdleBits = 30;
+
+    //! Size of a frame sent to the module (4 ID bytes, ext, rtr, 8 data bytes)
+    static constexpr byte k_txFrameSize = 14;
+
+    //! Number of frames the transmit queue holds (must be a power of two)
+    static constexpr byte k_txQueueDepth = 8;
+
     HardwareSerial &serialInterface;
-    void resetBaudTo(SerialBaudrate s);
+
+    BringupState bringupState;
+    SerialBaudrate targetSerialBaud;
+    CANBusBaudrate targetCanBaud;
+    SerialBaudrate detectedBaud;
+    byte probeIndex;
+    byte probeRounds;
+    byte configStep;
+    byte configRetries;
+    unsigned long stateStartMillis;
+    unsigned long bringupStartMillis;
+    unsigned long bringupMillis;
+    char atLine[16];
+    byte atLineLength;
+
+    bool filteringEnabled;
+    AcceptanceRule masks[mask_END];
+    AcceptanceRule filters[filter_END];
+
+    /**
+     * @brief Bytes that were moved from the UART in the same pumpRx() call,
+     * and so share a time stamp
+     */
+    typedef struct {
+        byte count;
+        unsigned long stamp;
+    } RxRun;
+
+    byte rxBuffer[k_rxBufferSize];
+    byte rxHead;
+    byte rxCount;
+    //! Runs covering the bytes in rxBuffer, oldest first
+    RxRun rxRuns[k_rxRuns];
+    byte rxRunHead;
+    byte rxRunCount;
+    //! Set once the parser has found the frame boundaries
+    bool rxLocked;
+    //! Set while the module runs with the masks and filters held here
+    bool rxFiltersActive;
+    //! micros() of the last call that found bytes in the UART
+    unsigned long rxLastByteMicros;
+    //! k_rxIdleBits at the serial baudrate in use (us)
+    unsigned int rxIdleMicros;
+    unsigned long rxDiscardedBytes;
+    unsigned long rxResyncEvents;
+
+    byte txQueue[k_txQueueDepth][k_txFrameSize];
+    byte txHead;
+    byte txCount;
+    unsigned long txDroppedFrames;
+
+    void pumpRx();
+    byte peekRx(byte offset)
+    {
+        return rxBuffer[(rxHead + offset) & (k_rxBufferSize - 1)];
+    };
+    unsigned long peekId(byte offset);
+    bool rxFrameValid(byte offset);
+    bool rxFramesValid(byte frames);
+    void alignToIdle();
+    unsigned long dropRx(byte count);
+    void discardRx();
+    void enterBringupState(BringupState state);
+    SerialBaudrate probeBaud();
+    void startProbe();
+    void onProbeResponse();
+    void sendConfigCommand();
+    bool pollAtResponse();
     unsigned long serialBaudToBaud(SerialBaudrate s);
 };
 } // namespace CAN
@@ -8,6 +8,47 @@ bool CAN::J1939Interface::j1939PeerToPeer(unsigned long lPGN)
     return false;
 }
 
+bool CAN::J1939Interface::acceptOnly(const unsigned long *pgns, byte count,
+                                     byte sourceAddress)
+{
+    if (count == 0 || count > filter_END) {
+        return false;
+    }
+
+    for (int i = mask_START; i < mask_END; i++) {
+        setMask((AcceptanceMask)i, k_pgnSourceMask);
+    }
+
+    // Unused filters repeat the last PGN, so they don't let anything else in
+    for (int i = filter_START; i < filter_END; i++) {
+        byte pgnIndex = (i < count) ? i : count - 1;
+        setFilter((AcceptanceFilter)i, filterID(pgns[pgnIndex], sourceAddress));
+    }
+    return true;
+}
+
+bool CAN::J1939Interface::acceptPGNs(AcceptanceMask bank,
+                                     const unsigned long *pgns, byte count,
+                                     byte sourceAddress, bool anyDestination,
+                                     byte ignoredPSBits)
+{
+    byte first = (bank == mask_0) ? filter_0 : filter_2;
+    byte end = (bank == mask_0) ? filter_2 : filter_END;
+    if (count == 0 || count > end - first) {
+        return false;
+    }
+
+    if (anyDestination) {
+        ignoredPSBits = 0xFF;
+    }
+    setMask(bank, k_pgnSourceMask & ~((unsigned long)ignoredPSBits << 8));
+    for (byte i = first; i < end; i++) {
+        byte pgnIndex = (i - first < count) ? i - first : count - 1;
+        setFilter((AcceptanceFilter)i, filterID(pgns[pgnIndex], sourceAddress));
+    }
+    return true;
+}
+
 CAN::J1939Message CAN::J1939Interface::read()
 {
     CAN::ExtendedCanDataPacket rawpacket;
@@ -15,14 +56,84 @@ CAN::J1939Message CAN::J1939Interface::read()
     return CAN::J1939Message(rawpacket);
 }
 
-void CAN::J1939Interface::write(CAN::J1939Message p, byte dest)
+bool CAN::J1939Interface::write(const CAN::J1939Message &p, byte dest)
 {
-    CAN::ExtendedCanDataPacket rawpacket;
-    rawpacket.id = p.CanID.getID();
+    unsigned long id = p.CanID.getID();
     if (j1939PeerToPeer(p.CanID.getPGN()) == true) {
-        rawpacket.id = rawpacket.id & 0xFFFF00FF;
-        rawpacket.id = rawpacket.id | ((unsigned long)dest << 8);
+        id = id & 0xFFFF00FF;
+        id = id | ((unsigned long)dest << 8);
+    }
+    return queueFrame(id, p.data, true, false);
+}
+
+bool CAN::J1939Interface::registerHandler(unsigned long PGN,
+                                          J1939Handler handler, void *context)
+{
+    byte slot = findHandlerSlot(PGN);
+    if (slot == handlerCount || handlers[slot].PGN != PGN) {
+        if (handlerCount == k_maxHandlers) {
+            return false;
+        }
+        // Shift the larger PGNs up to keep the table sorted
+        for (byte i = handlerCount; i > slot; i--) {
+            handlers[i] = handlers[i - 1];
+        }
+        handlerCount++;
+    }
+    handlers[slot].PGN = PGN;
+    handlers[slot].handler = handler;
+    handlers[slot].context = context;
+    return true;
+}
+
+void CAN::J1939Interface::unregisterHandler(unsigned long PGN)
+{
+    byte slot = findHandlerSlot(PGN);
+    if (slot < handlerCount && handlers[slot].PGN == PGN) {
+        handlerCount--;
+        for (byte i = slot; i < handlerCount; i++) {
+            handlers[i] = handlers[i + 1];
+        }
+    }
+}
+
+byte CAN::J1939Interface::poll()
+{
+    byte count = 0;
+    unsigned long id;
+    J1939Message message;
+
+    // Each frame is decoded into the same message, which handlers only
+    // borrow, so nothing is copied after it leaves the receive buffer
+    while (readFrame(id, message.data, message.timestamp)) {
+        message.CanID = J1939ID(id);
+        byte slot = findHandlerSlot(message.CanID.getPGN());
+        if (slot < handlerCount &&
+            handlers[slot].PGN == message.CanID.getPGN()) {
+            handlers[slot].handler(message, handlers[slot].context);
+        }
+        else if (defaultHandler != NULL) {
+            defaultHandler(message, defaultContext);
+        }
+        count++;
+    }
+    return count;
+}
+
+byte CAN::J1939Interface::findHandlerSlot(unsigned long PGN)
+{
+    // Binary search for the first entry that is not less than PGN. With
+    // k_maxHandlers entries this takes at most four comparisons.
+    byte low = 0;
+    byte high = handlerCount;
+    while (low < high) {
+        byte mid = (low + high) / 2;
+        if (handlers[mid].PGN < PGN) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
     }
-    memcpy(&rawpacket.data, p.data, 8);
-    CAN::RawInterface::write(rawpacket);
+    return low;
 }
\ No newline at end of file
@@ -58,28 +58,28 @@ class J1939ID {
      * @return unsigned long the 29-but CAN ID represented by this object, with
      * zero padding in front.
      */
-    unsigned long getID() { return canID; };
+    unsigned long getID() const { return canID; };
 
     /**
      * @brief Get the Priority
      *
      * @return byte priority byte (only valid to 3 bits)
      */
-    byte getPriority() { return priority; };
+    byte getPriority() const { return priority; };
 
     /**
      * @brief Get the Source Address
      *
      * @return byte the source address
      */
-    byte getSourceAddress() { return sourceAddress; };
+    byte getSourceAddress() const { return sourceAddress; };
 
     /**
      * @brief Get the PGN
      *
      * @return unsigned long the Parameter Group Number of this ID
      */
-    unsigned long getPGN() { return PGN; };
+    unsigned long getPGN() const { return PGN; };
 
   private:
     unsigned long canID;
@@ -101,6 +101,30 @@ struct J1939Message {
     //! 8 bytes of data, zero-filled initially
     byte data[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 
+    //! micros() when the message was received (0 for outgoing messages)
+    unsigned long timestamp = 0;
+
+    /**
+     * @brief Construct a new empty J1939Message object (CAN ID is 0, data is
+     * 0)
+     */
+    J1939Message(){};
+
+    /**
+     * @brief Construct a new J1939Message object from an ID and a payload of
+     * up to 8 bytes. Unused bytes are filled with 0xFF, as J1939 requires.
+     *
+     * @param id the J1939 ID of the message
+     * @param payload the bytes to send
+     * @param length number of bytes in payload (at most 8)
+     */
+    J1939Message(J1939ID id, const byte *payload, byte length) : CanID(id)
+    {
+        for (byte i = 0; i < 8; i++) {
+            data[i] = (i < length) ? payload[i] : 0xFF;
+        }
+    }
+
     /**
      * @brief Construct a new J1939Message object representing a command message
      * with one byte of data in the payload
@@ -178,10 +202,20 @@ struct J1939Message {
     {
         unsigned long id = p.id;
         memcpy(&data, &p.data, 8);
+        timestamp = p.timestamp;
         CanID = J1939ID(id);
     }
 }; // namespace CAN
 
+/**
+ * @brief Function that receives messages of a registered PGN
+ *
+ * @param message the received message. Only valid for the duration of the
+ * call.
+ * @param context the pointer that was given when the handler was registered
+ */
+typedef void (*J1939Handler)(const J1939Message &message, void *context);
+
 /**
  * @brief This interface allows writing to the Serial Can Module using the
  * SAEJ1939 CAN 2.0 Protocol stack
@@ -189,6 +223,9 @@ struct J1939Message {
  */
 class J1939Interface : public RawInterface {
   public:
+    //! Maximum number of PGN handlers that can be registered
+    static constexpr byte k_maxHandlers = 12;
+
     /**
      * @brief Construct a new J1939Interface object.
      *
@@ -196,16 +233,22 @@ class J1939Interface : public RawInterface {
      * module is connected
      */
     J1939Interface(HardwareSerial &serialInterface)
-        : RawInterface(serialInterface){};
+        : RawInterface(serialInterface), handlerCount(0), defaultHandler(NULL),
+          defaultContext(NULL){};
 
     /**
      * @brief Write a J1939 Message to the CAN Bus.
      *
+     * The message is serialized straight into the transmit queue of the
+     * underlying RawInterface.
+     *
      * @param p the J1939 Message to send
      * @param dest the address to send the packet to. The destination address is
      * used to determine if the packet is peer-to-peer.
+     * @return true if the message was queued
+     * @return false if the transmit queue is full
      */
-    void write(J1939Message p, byte dest);
+    bool write(const J1939Message &p, byte dest);
 
     /**
      * @brief Read a J1939 Message from the CAN Bus
@@ -215,17 +258,139 @@ class J1939Interface : public RawInterface {
      */
     J1939Message read();
 
+    /**
+     * @brief Registers a function to receive all messages with a PGN.
+     * Registering a PGN again replaces its handler.
+     *
+     * @param PGN the Parameter Group Number to handle (as returned by
+     * J1939ID::getPGN())
+     * @param handler the function to call for each message
+     * @param context passed to the handler with each message
+     * @return true if the handler was registered
+     * @return false if the handler table is full
+     */
+    bool registerHandler(unsigned long PGN, J1939Handler handler,
+                         void *context = NULL);
+
+    /**
+     * @brief Set a function to receive all messages whose PGN has no handler
+     * registered
+     *
+     * @param handler the function to call for each unhandled message, or NULL
+     * to drop them
+     * @param context passed to the handler with each message
+     */
+    void setDefaultHandler(J1939Handler handler, void *context = NULL)
+    {
+        defaultHandler = handler;
+        defaultContext = context;
+    };
+
+    /**
+     * @brief Removes the handler of a PGN, if there is one
+     *
+     * @param PGN the Parameter Group Number to stop handling
+     */
+    void unregisterHandler(unsigned long PGN);
+
+    /**
+     * @brief Reads every message that is waiting and passes each one to the
+     * handler registered for its PGN. Messages without a handler go to the
+     * default handler, if one is set, and are dropped otherwise.
+     *
+     * @return byte the number of messages that were read
+     */
+    byte poll();
+
     /**
      * @see CAN::RawInterface::write(ExtendedCanDataPacket p)
      */
-    void writeRaw(ExtendedCanDataPacket &p) { return RawInterface::write(p); };
+    bool writeRaw(const ExtendedCanDataPacket &p)
+    {
+        return RawInterface::write(p);
+    };
 
     /**
      * @see CAN::RawInterface::read(ExtendedCanDataPacket p)
      */
     bool readRaw(ExtendedCanDataPacket &p) { return RawInterface::read(p); };
 
+    /**
+     * @brief Sets up the module's hardware filters to only forward the given
+     * PGNs, and only from one source address. Priority is ignored.
+     *
+     * For peer-to-peer (PDU1) PGNs, include the destination address in the
+     * low byte of the PGN. Takes effect on the next begin() or
+     * applyFilters().
+     *
+     * @param pgns PGNs to forward
+     * @param count number of PGNs (1 to 6)
+     * @param sourceAddress the source address to forward the PGNs from
+     * @return true if the filters were set
+     * @return false if too many or too few PGNs were given
+     */
+    bool acceptOnly(const unsigned long *pgns, byte count, byte sourceAddress);
+
+    /**
+     * @brief Sets up one of the module's mask banks (a mask and the filters
+     * it applies to) to forward the given PGNs from one source address
+     *
+     * Bank mask_0 has two filters and bank mask_1 has four. The other bank is
+     * left untouched, so the two can be set up with different rules. Takes
+     * effect on the next begin() or applyFilters().
+     *
+     * @param bank the mask bank to set up
+     * @param pgns PGNs to forward
+     * @param count number of PGNs (at most the number of filters in the bank)
+     * @param sourceAddress the source address to forward the PGNs from
+     * @param anyDestination true to ignore the destination address of
+     * peer-to-peer (PDU1) PGNs, so e.g. broadcast and directed transport
+     * protocol frames share a filter (default false)
+     * @param ignoredPSBits bits of the PDU specific byte (low byte of the PGN)
+     * that don't have to match, so one filter covers a group of neighbouring
+     * PGNs (default 0)
+     * @return true if the bank was set up
+     * @return false if too many or too few PGNs were given
+     */
+    bool acceptPGNs(AcceptanceMask bank, const unsigned long *pgns, byte count,
+                    byte sourceAddress, bool anyDestination = false,
+                    byte ignoredPSBits = 0);
+
+    /**
+     * @brief Builds the CAN ID that a hardware filter should match for a PGN
+     * sent from a source address
+     *
+     * @param PGN the Parameter Group Number
+     * @param sourceAddress the source address
+     * @return unsigned long the ID to filter on, to be used with
+     * k_pgnSourceMask
+     */
+    static unsigned long filterID(unsigned long PGN, byte sourceAddress)
+    {
+        return ((PGN & 0x3FFFF) << 8) | sourceAddress;
+    };
+
+    //! Hardware filter mask covering the PGN and source address of an ID
+    static constexpr unsigned long k_pgnSourceMask = 0x03FFFFFF;
+
   private:
+    /**
+     * @brief An entry in the PGN handler table
+     */
+    typedef struct {
+        unsigned long PGN;
+        J1939Handler handler;
+        void *context;
+    } HandlerEntry;
+
+    //! Registered handlers, sorted by PGN
+    HandlerEntry handlers[k_maxHandlers];
+    byte handlerCount;
+
+    J1939Handler defaultHandler;
+    void *defaultContext;
+
+    byte findHandlerSlot(unsigned long PGN);
     bool j1939PeerToPeer(unsigned long lPGN);
 };
 } // namespace CAN
@@ -0,0 +1,155 @@
+#include "CANSAEJ1939Request.h"
+
+CAN::J1939Requester::J1939Requester(J1939Interface &bus, byte address)
+    : bus(bus), address(address)
+{
+    for (int i = 0; i < k_maxOutstanding; i++) {
+        requests[i].active = false;
+    }
+}
+
+bool CAN::J1939Requester::begin()
+{
+    bus.setDefaultHandler(onMessage, this);
+    return bus.registerHandler(PGN_ACKNOWLEDGEMENT | address, onAcknowledgement,
+                               this) &&
+           bus.registerHandler(PGN_ACKNOWLEDGEMENT | 0xFF, onAcknowledgement,
+                               this);
+}
+
+bool CAN::J1939Requester::request(unsigned long PGN, byte dest,
+                                  J1939ResponseHandler handler, void *context,
+                                  unsigned long timeoutMillis)
+{
+    Outstanding *slot = NULL;
+    for (int i = 0; i < k_maxOutstanding; i++) {
+        if (requests[i].active) {
+            if (requests[i].PGN == PGN && requests[i].dest == dest) {
+                return false;
+            }
+        }
+        else if (slot == NULL) {
+            slot = &requests[i];
+        }
+    }
+    if (slot == NULL) {
+        return false;
+    }
+
+    byte payload[3] = {(byte)(PGN & 0xFF), (byte)((PGN >> 8) & 0xFF),
+                       (byte)((PGN >> 16) & 0xFF)};
+    if (!bus.write(J1939Message(J1939ID(6, address, PGN_REQUEST), payload, 3),
+                   dest)) {
+        return false;
+    }
+
+    slot->active = true;
+    slot->PGN = PGN;
+    slot->dest = dest;
+    slot->sentMillis = millis();
+    slot->timeoutMillis = timeoutMillis;
+    slot->handler = handler;
+    slot->context = context;
+    return true;
+}
+
+bool CAN::J1939Requester::isPending()
+{
+    for (int i = 0; i < k_maxOutstanding; i++) {
+        if (requests[i].active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CAN::J1939Requester::step()
+{
+    for (int i = 0; i < k_maxOutstanding; i++) {
+        if (requests[i].active &&
+            millis() - requests[i].sentMillis >= requests[i].timeoutMillis) {
+            complete(requests[i], REQUEST_TIMEOUT, NULL, 0);
+        }
+    }
+}
+
+void CAN::J1939Requester::onTransportMessage(unsigned long PGN, byte source,
+                                             const byte *data,
+                                             unsigned int length,
+                                             void *context)
+{
+    ((J1939Requester *)context)->handleResponse(PGN, source, data, length);
+}
+
+void CAN::J1939Requester::onMessage(const J1939Message &m, void *context)
+{
+    ((J1939Requester *)context)
+        ->handleResponse(m.CanID.getPGN(), m.CanID.getSourceAddress(), m.data,
+                         8);
+}
+
+void CAN::J1939Requester::onAcknowledgement(const J1939Message &m,
+                                            void *context)
+{
+    ((J1939Requester *)context)->handleAcknowledgement(m);
+}
+
+void CAN::J1939Requester::handleResponse(unsigned long PGN, byte source,
+                                         const byte *data, unsigned int length)
+{
+    for (int i = 0; i < k_maxOutstanding; i++) {
+        if (requests[i].active && matches(requests[i], PGN, source)) {
+            complete(requests[i], REQUEST_OK, data, length);
+            return;
+        }
+    }
+}
+
+void CAN::J1939Requester::handleAcknowledgement(const J1939Message &m)
+{
+    // The acknowledged PGN is in bytes 5 to 7
+    unsigned long PGN = (unsigned long)m.data[5] |
+                        ((unsigned long)m.data[6] << 8) |
+                        ((unsigned long)m.data[7] << 16);
+    byte source = m.CanID.getSourceAddress();
+
+    for (int i = 0; i < k_maxOutstanding; i++) {
+        if (requests[i].active && requests[i].PGN == PGN &&
+            (requests[i].dest == source || requests[i].dest == 0xFF)) {
+            if (m.data[0] == ACK_POSITIVE) {
+                complete(requests[i], REQUEST_OK, NULL, 0);
+            }
+            else {
+                complete(requests[i], REQUEST_NACK, NULL, 0);
+            }
+            return;
+        }
+    }
+}
+
+bool CAN::J1939Requester::matches(const Outstanding &entry, unsigned long PGN,
+                                  byte source)
+{
+    if (entry.dest != 0xFF && entry.dest != source) {
+        return false;
+    }
+    if (entry.PGN == PGN) {
+        return true;
+    }
+
+    // A peer-to-peer (PDU1) PGN comes back with our address in the low byte
+    bool peerToPeer = ((entry.PGN >> 8) & 0xFF) < 0xF0;
+    return peerToPeer && (entry.PGN & 0x3FF00) == (PGN & 0x3FF00) &&
+           (PGN & 0xFF) == address;
+}
+
+void CAN::J1939Requester::complete(Outstanding &entry,
+                                   J1939RequestStatus status, const byte *data,
+                                   unsigned int length)
+{
+    // Free the slot first, so the handler can issue a new request
+    entry.active = false;
+    if (entry.handler != NULL) {
+        entry.handler(status, data, length, entry.context);
+    }
+}
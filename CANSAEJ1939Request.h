@@ -0,0 +1,155 @@
+/**
+ * @file CANSAEJ1939Request.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Asynchronous SAEJ1939 Request (PGN 0xEA00) with response matching
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef CAN_SAEJ1939_REQUEST_H
+#define CAN_SAEJ1939_REQUEST_H
+
+#include "CANSAEJ1939.h"
+
+namespace CAN {
+
+/**
+ * @brief How a request finished
+ */
+enum J1939RequestStatus {
+    //! The PGN was received (or positively acknowledged, with no data)
+    REQUEST_OK,
+    //! The node answered with a negative acknowledgement
+    REQUEST_NACK,
+    //! Nothing came back before the deadline
+    REQUEST_TIMEOUT
+};
+
+/**
+ * @brief Function that is called when a request finishes
+ *
+ * @param status how the request finished
+ * @param data the response payload (NULL unless status is REQUEST_OK). Only
+ * valid for the duration of the call.
+ * @param length number of bytes in the payload
+ * @param context the pointer that was given with the request
+ */
+typedef void (*J1939ResponseHandler)(J1939RequestStatus status,
+                                     const byte *data, unsigned int length,
+                                     void *context);
+
+/**
+ * @brief Sends J1939 Requests and matches up the responses, without blocking
+ *
+ * Each outstanding request is kept in a small table with the PGN and address
+ * it was sent to, and a deadline. A response is matched by PGN and source
+ * address, and completes the request through its callback. Responses are
+ * picked up as the J1939Interface's default handler, so they must not have a
+ * handler of their own. Multi-packet responses can be fed in from a
+ * J1939Transport with onTransportMessage(). Call step() iteratively to expire
+ * requests.
+ */
+class J1939Requester {
+  public:
+    //! Number of requests that can be outstanding at the same time
+    static constexpr byte k_maxOutstanding = 4;
+
+    //! Deadline used when none is given (ms). Long enough for a response
+    //! sent over the Transport Protocol.
+    static constexpr unsigned long k_defaultTimeoutMillis = 1250;
+
+    //! PGNs used by requests (the low byte is the destination address)
+    enum PGN { PGN_ACKNOWLEDGEMENT = 0xE800, PGN_REQUEST = 0xEA00 };
+
+    /**
+     * @brief Construct a new J1939Requester object
+     *
+     * @param bus the J1939 interface to send requests and receive responses on
+     * @param address our own source address
+     */
+    J1939Requester(J1939Interface &bus, byte address);
+
+    /**
+     * @brief Installs the response and acknowledgement handlers on the J1939
+     * interface
+     *
+     * @return true if the handlers could be registered
+     * @return false if the interface's handler table is full
+     */
+    bool begin();
+
+    /**
+     * @brief Requests a PGN from a node
+     *
+     * @param PGN the Parameter Group Number to request
+     * @param dest the address to request it from, or 0xFF to ask everyone (the
+     * first answer completes the request)
+     * @param handler called once when the request finishes
+     * @param context passed to the handler
+     * @param timeoutMillis how long to wait for a response
+     * @return true if the request was sent
+     * @return false if the same PGN is already outstanding at that address,
+     * the table is full or the transmit queue is full
+     */
+    bool request(unsigned long PGN, byte dest, J1939ResponseHandler handler,
+                 void *context = NULL,
+                 unsigned long timeoutMillis = k_defaultTimeoutMillis);
+
+    /**
+     * @brief Checks if any request is still waiting for an answer
+     *
+     * @return true if at least one request is outstanding
+     * @return false if there are no outstanding requests
+     */
+    bool isPending();
+
+    /**
+     * @brief Completes requests that ran past their deadline. Call this
+     * iteratively.
+     */
+    void step();
+
+    /**
+     * @brief Offers a reassembled multi-packet message as a response. Has the
+     * signature of a J1939TransportHandler, with the requester as context.
+     */
+    static void onTransportMessage(unsigned long PGN, byte source,
+                                   const byte *data, unsigned int length,
+                                   void *context);
+
+  private:
+    /**
+     * @brief An outstanding request
+     */
+    typedef struct {
+        bool active;
+        unsigned long PGN;
+        byte dest;
+        unsigned long sentMillis;
+        unsigned long timeoutMillis;
+        J1939ResponseHandler handler;
+        void *context;
+    } Outstanding;
+
+    //! Acknowledgement control bytes
+    enum AckControl { ACK_POSITIVE = 0 };
+
+    J1939Interface &bus;
+    byte address;
+    Outstanding requests[k_maxOutstanding];
+
+    static void onMessage(const J1939Message &m, void *context);
+    static void onAcknowledgement(const J1939Message &m, void *context);
+    void handleResponse(unsigned long PGN, byte source, const byte *data,
+                        unsigned int length);
+    void handleAcknowledgement(const J1939Message &m);
+    bool matches(const Outstanding &entry, unsigned long PGN, byte source);
+    void complete(Outstanding &entry, J1939RequestStatus status,
+                  const byte *data, unsigned int length);
+};
+} // namespace CAN
+
+#endif
@@ -0,0 +1,372 @@
+#include "CANSAEJ1939Transport.h"
+
+CAN::J1939Transport::J1939Transport(J1939Interface &bus, byte address)
+    : bus(bus), address(address), receiveHandler(NULL), receiveContext(NULL)
+{
+    for (int i = 0; i < k_maxRxSessions; i++) {
+        rxSessions[i].state = SESSION_IDLE;
+    }
+    txSession.state = SESSION_IDLE;
+}
+
+bool CAN::J1939Transport::begin()
+{
+    // Directed and broadcast (BAM) frames have different PGNs, since the
+    // destination address is part of them
+    return bus.registerHandler(PGN_TP_CM | address, onConnectionManagement,
+                               this) &&
+           bus.registerHandler(PGN_TP_CM | 0xFF, onConnectionManagement,
+                               this) &&
+           bus.registerHandler(PGN_TP_DT | address, onDataTransfer, this) &&
+           bus.registerHandler(PGN_TP_DT | 0xFF, onDataTransfer, this);
+}
+
+bool CAN::J1939Transport::send(unsigned long PGN, byte dest, const byte *data,
+                               unsigned int length)
+{
+    if (length <= 8) {
+        return bus.write(J1939Message(J1939ID(6, address, PGN), data, length),
+                         dest);
+    }
+    if (length > k_maxMessageSize || isSending()) {
+        return false;
+    }
+
+    txSession.PGN = PGN;
+    txSession.remote = dest;
+    txSession.size = length;
+    txSession.packets = (length + k_bytesPerPacket - 1) / k_bytesPerPacket;
+    txSession.nextPacket = 1;
+    memcpy(txSession.data, data, length);
+
+    byte params[4] = {(byte)(length & 0xFF), (byte)(length >> 8),
+                      txSession.packets, 0xFF};
+    if (dest == 0xFF) {
+        sendControl(dest, CM_BAM, params, PGN);
+        txSession.state = SESSION_TX_BAM;
+        startTimer(txSession, k_bamPacketIntervalMillis);
+    }
+    else {
+        // Let the receiver send as many packets per CTS as it likes
+        sendControl(dest, CM_RTS, params, PGN);
+        txSession.state = SESSION_TX_WAIT_CTS;
+        startTimer(txSession, k_timeoutT3);
+    }
+    return true;
+}
+
+void CAN::J1939Transport::step()
+{
+    for (int i = 0; i < k_maxRxSessions; i++) {
+        Session &session = rxSessions[i];
+        if (session.state != SESSION_IDLE && timerExpired(session)) {
+            if (session.state == SESSION_RX_CTS) {
+                sendAbort(session.remote, ABORT_TIMEOUT, session.PGN);
+            }
+            session.state = SESSION_IDLE;
+        }
+    }
+
+    switch (txSession.state) {
+    case SESSION_TX_BAM:
+        if (timerExpired(txSession) && sendDataPacket(txSession, 0xFF)) {
+            if (txSession.nextPacket > txSession.packets) {
+                txSession.state = SESSION_IDLE;
+            }
+            else {
+                startTimer(txSession, k_bamPacketIntervalMillis);
+            }
+        }
+        break;
+    case SESSION_TX_SENDING:
+        sendTxDataPackets();
+        break;
+    case SESSION_TX_WAIT_CTS:
+    case SESSION_TX_WAIT_ACK:
+        if (timerExpired(txSession)) {
+            sendAbort(txSession.remote, ABORT_TIMEOUT, txSession.PGN);
+            txSession.state = SESSION_IDLE;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void CAN::J1939Transport::onConnectionManagement(const J1939Message &m,
+                                                 void *context)
+{
+    ((J1939Transport *)context)->handleConnectionManagement(m);
+}
+
+void CAN::J1939Transport::onDataTransfer(const J1939Message &m, void *context)
+{
+    ((J1939Transport *)context)->handleDataTransfer(m);
+}
+
+void CAN::J1939Transport::handleConnectionManagement(const J1939Message &m)
+{
+    byte source = m.CanID.getSourceAddress();
+    bool broadcast = (m.CanID.getPGN() & 0xFF) == 0xFF;
+    unsigned long PGN = (unsigned long)m.data[5] |
+                        ((unsigned long)m.data[6] << 8) |
+                        ((unsigned long)m.data[7] << 16);
+    unsigned int size = (unsigned int)m.data[1] | ((unsigned int)m.data[2] << 8);
+
+    switch (m.data[0]) {
+    case CM_BAM:
+    case CM_RTS: {
+        bool isBAM = m.data[0] == CM_BAM;
+        if (isBAM != broadcast) {
+            return;
+        }
+
+        // A new announcement from the same node replaces the old transfer
+        Session *session = findRxSession(source, broadcast);
+        if (session == NULL) {
+            for (int i = 0; session == NULL && i < k_maxRxSessions; i++) {
+                if (rxSessions[i].state == SESSION_IDLE) {
+                    session = &rxSessions[i];
+                }
+            }
+        }
+
+        if (session == NULL || size > k_maxMessageSize || size <= 8) {
+            if (!isBAM) {
+                sendAbort(source, ABORT_NO_RESOURCES, PGN);
+            }
+            return;
+        }
+        // The packet count has to match the size, or the windows asked for
+        // would run short of the message (or past it)
+        if (m.data[3] != (size + k_bytesPerPacket - 1) / k_bytesPerPacket) {
+            if (!isBAM) {
+                sendAbort(source, ABORT_OTHER, PGN);
+            }
+            return;
+        }
+
+        session->PGN = PGN;
+        session->remote = source;
+        session->size = size;
+        session->packets = m.data[3];
+        session->nextPacket = 1;
+        if (isBAM) {
+            session->state = SESSION_RX_BAM;
+            startTimer(*session, k_timeoutT1);
+        }
+        else {
+            session->state = SESSION_RX_CTS;
+            session->windowEnd = 0;
+            session->maxPerCTS = (m.data[4] != 0 && m.data[4] < k_packetsPerCTS)
+                                     ? m.data[4]
+                                     : k_packetsPerCTS;
+            sendClearToSend(*session);
+        }
+        break;
+    }
+    case CM_ABORT:
+        if (txSession.state != SESSION_IDLE && txSession.remote == source &&
+            txSession.PGN == PGN) {
+            txSession.state = SESSION_IDLE;
+        }
+        for (int i = 0; i < k_maxRxSessions; i++) {
+            if (rxSessions[i].state == SESSION_RX_CTS &&
+                rxSessions[i].remote == source && rxSessions[i].PGN == PGN) {
+                rxSessions[i].state = SESSION_IDLE;
+            }
+        }
+        break;
+    default:
+        if (!broadcast) {
+            handleTxControl(m, source);
+        }
+        break;
+    }
+}
+
+void CAN::J1939Transport::handleTxControl(const J1939Message &m, byte source)
+{
+    if (txSession.remote != source) {
+        return;
+    }
+
+    if (m.data[0] == CM_CTS && (txSession.state == SESSION_TX_WAIT_CTS ||
+                                txSession.state == SESSION_TX_SENDING)) {
+        unsigned long PGN = (unsigned long)m.data[5] |
+                            ((unsigned long)m.data[6] << 8) |
+                            ((unsigned long)m.data[7] << 16);
+        if (PGN != txSession.PGN) {
+            // Not the message we are sending, so the two ends disagree on
+            // what this connection is
+            sendAbort(source, ABORT_OTHER, txSession.PGN);
+            txSession.state = SESSION_IDLE;
+            return;
+        }
+        if (m.data[1] == 0) {
+            // The receiver wants us to hold off
+            txSession.state = SESSION_TX_WAIT_CTS;
+            startTimer(txSession, k_timeoutT4);
+            return;
+        }
+        // Worked out wider than a byte, so a window past packet 255 can't
+        // wrap around into a valid looking one
+        unsigned int windowEnd = (unsigned int)m.data[2] + m.data[1] - 1;
+        if (m.data[2] == 0 || windowEnd > txSession.packets) {
+            sendAbort(source, ABORT_BAD_SEQUENCE, txSession.PGN);
+            txSession.state = SESSION_IDLE;
+            return;
+        }
+        txSession.nextPacket = m.data[2];
+        txSession.windowEnd = windowEnd;
+        txSession.state = SESSION_TX_SENDING;
+        sendTxDataPackets();
+    }
+    else if (m.data[0] == CM_END_OF_MSG_ACK &&
+             txSession.state == SESSION_TX_WAIT_ACK) {
+        txSession.state = SESSION_IDLE;
+    }
+}
+
+void CAN::J1939Transport::handleDataTransfer(const J1939Message &m)
+{
+    byte source = m.CanID.getSourceAddress();
+    bool broadcast = (m.CanID.getPGN() & 0xFF) == 0xFF;
+    Session *session = findRxSession(source, broadcast);
+    if (session == NULL) {
+        return;
+    }
+
+    byte sequence = m.data[0];
+    if (sequence != session->nextPacket ||
+        (!broadcast && sequence > session->windowEnd)) {
+        if (!broadcast) {
+            sendAbort(source, ABORT_BAD_SEQUENCE, session->PGN);
+        }
+        session->state = SESSION_IDLE;
+        return;
+    }
+
+    unsigned int offset = (unsigned int)(sequence - 1) * k_bytesPerPacket;
+    for (byte i = 0; i < k_bytesPerPacket && offset + i < session->size; i++) {
+        session->data[offset + i] = m.data[1 + i];
+    }
+    session->nextPacket++;
+
+    if (offset + k_bytesPerPacket >= session->size) {
+        completeRx(*session);
+    }
+    else if (!broadcast && sequence == session->windowEnd) {
+        sendClearToSend(*session);
+    }
+    else {
+        startTimer(*session, k_timeoutT1);
+    }
+}
+
+CAN::J1939Transport::Session *
+CAN::J1939Transport::findRxSession(byte source, bool broadcast)
+{
+    SessionState state = broadcast ? SESSION_RX_BAM : SESSION_RX_CTS;
+    for (int i = 0; i < k_maxRxSessions; i++) {
+        if (rxSessions[i].state == state && rxSessions[i].remote == source) {
+            return &rxSessions[i];
+        }
+    }
+    return NULL;
+}
+
+void CAN::J1939Transport::startTimer(Session &session, unsigned long timeout)
+{
+    session.timer = millis();
+    session.timeout = timeout;
+}
+
+bool CAN::J1939Transport::timerExpired(Session &session)
+{
+    return millis() - session.timer >= session.timeout;
+}
+
+void CAN::J1939Transport::sendClearToSend(Session &session)
+{
+    byte remaining = session.packets - session.nextPacket + 1;
+    byte count =
+        (remaining < session.maxPerCTS) ? remaining : session.maxPerCTS;
+    byte params[4] = {count, session.nextPacket, 0xFF, 0xFF};
+    sendControl(session.remote, CM_CTS, params, session.PGN);
+    session.windowEnd = session.nextPacket + count - 1;
+    startTimer(session, k_timeoutT2);
+}
+
+void CAN::J1939Transport::sendControl(byte dest, byte control,
+                                      const byte *params, unsigned long PGN)
+{
+    byte payload[8] = {control,
+                       params[0],
+                       params[1],
+                       params[2],
+                       params[3],
+                       (byte)(PGN & 0xFF),
+                       (byte)((PGN >> 8) & 0xFF),
+                       (byte)((PGN >> 16) & 0xFF)};
+    bus.write(J1939Message(J1939ID(k_priority, address, PGN_TP_CM), payload, 8),
+              dest);
+}
+
+void CAN::J1939Transport::sendAbort(byte dest, AbortReason reason,
+                                    unsigned long PGN)
+{
+    byte params[4] = {(byte)reason, 0xFF, 0xFF, 0xFF};
+    sendControl(dest, CM_ABORT, params, PGN);
+}
+
+void CAN::J1939Transport::sendTxDataPackets()
+{
+    // Send as much of the window as fits in the transmit queue, the rest
+    // goes out on the next step()
+    while (txSession.nextPacket <= txSession.windowEnd) {
+        if (!sendDataPacket(txSession, txSession.remote)) {
+            return;
+        }
+    }
+
+    txSession.state = (txSession.nextPacket > txSession.packets)
+                          ? SESSION_TX_WAIT_ACK
+                          : SESSION_TX_WAIT_CTS;
+    startTimer(txSession, k_timeoutT3);
+}
+
+bool CAN::J1939Transport::sendDataPacket(Session &session, byte dest)
+{
+    if (bus.getTxFree() == 0) {
+        return false;
+    }
+
+    byte payload[8];
+    unsigned int offset =
+        (unsigned int)(session.nextPacket - 1) * k_bytesPerPacket;
+    payload[0] = session.nextPacket;
+    for (byte i = 0; i < k_bytesPerPacket; i++) {
+        payload[1 + i] =
+            (offset + i < session.size) ? session.data[offset + i] : 0xFF;
+    }
+    bus.write(J1939Message(J1939ID(k_priority, address, PGN_TP_DT), payload, 8),
+              dest);
+    session.nextPacket++;
+    return true;
+}
+
+void CAN::J1939Transport::completeRx(Session &session)
+{
+    if (session.state == SESSION_RX_CTS) {
+        byte params[4] = {(byte)(session.size & 0xFF), (byte)(session.size >> 8),
+                          session.packets, 0xFF};
+        sendControl(session.remote, CM_END_OF_MSG_ACK, params, session.PGN);
+    }
+    session.state = SESSION_IDLE;
+
+    if (receiveHandler != NULL) {
+        receiveHandler(session.PGN, session.remote, session.data, session.size,
+                       receiveContext);
+    }
+}
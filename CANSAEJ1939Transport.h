@@ -0,0 +1,203 @@
+/**
+ * @file CANSAEJ1939Transport.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Implements the SAEJ1939-21 Transport Protocol (BAM and RTS/CTS) for
+ * messages longer than one CAN frame
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef CAN_SAEJ1939_TRANSPORT_H
+#define CAN_SAEJ1939_TRANSPORT_H
+
+#include "CANSAEJ1939.h"
+
+namespace CAN {
+
+/**
+ * @brief Function that receives a completely reassembled multi-packet message
+ *
+ * @param PGN the Parameter Group Number of the message
+ * @param source the address that sent the message
+ * @param data the reassembled payload. Only valid for the duration of the
+ * call.
+ * @param length number of bytes in the payload
+ * @param context the pointer that was given with setReceiveHandler()
+ */
+typedef void (*J1939TransportHandler)(unsigned long PGN, byte source,
+                                      const byte *data, unsigned int length,
+                                      void *context);
+
+/**
+ * @brief Sends and receives J1939 messages of up to k_maxMessageSize bytes
+ * over the Transport Protocol, on top of a J1939Interface.
+ *
+ * Broadcasts use BAM (Broadcast Announce Message), and messages to a single
+ * address use an RTS/CTS connection. All buffers are fixed in size, nothing
+ * blocks, and timeouts follow J1939-21. Call step() iteratively.
+ */
+class J1939Transport {
+  public:
+    //! Largest message that can be sent or reassembled (bytes)
+    static constexpr unsigned int k_maxMessageSize = 112;
+
+    //! Number of messages that can be received at the same time
+    static constexpr byte k_maxRxSessions = 2;
+
+    //! Transport Protocol PGNs (the low byte is the destination address)
+    enum PGN { PGN_TP_DT = 0xEB00, PGN_TP_CM = 0xEC00 };
+
+    /**
+     * @brief Construct a new J1939Transport object
+     *
+     * @param bus the J1939 interface to send and receive frames with
+     * @param address our own source address
+     */
+    J1939Transport(J1939Interface &bus, byte address);
+
+    /**
+     * @brief Registers the Transport Protocol PGNs with the J1939 interface
+     *
+     * @return true if all handlers could be registered
+     * @return false if the interface's handler table is full
+     */
+    bool begin();
+
+    /**
+     * @brief Set the function that receives reassembled messages
+     *
+     * @param handler function to call with each complete message
+     * @param context passed to the handler with each message
+     */
+    void setReceiveHandler(J1939TransportHandler handler, void *context = NULL)
+    {
+        receiveHandler = handler;
+        receiveContext = context;
+    };
+
+    /**
+     * @brief Starts sending a message. Messages of up to 8 bytes are sent as a
+     * single frame, longer ones over the Transport Protocol.
+     *
+     * @param PGN the Parameter Group Number of the message
+     * @param dest destination address, or 0xFF to broadcast
+     * @param data the payload (copied, so it does not need to stay valid)
+     * @param length number of bytes in the payload
+     * @return true if sending started
+     * @return false if the message is too long or another message is still
+     * being sent
+     */
+    bool send(unsigned long PGN, byte dest, const byte *data,
+              unsigned int length);
+
+    /**
+     * @brief Checks if a multi-packet message is still being sent
+     *
+     * @return true if the transmit session is busy
+     * @return false if a new message can be sent
+     */
+    bool isSending() { return txSession.state != SESSION_IDLE; };
+
+    /**
+     * @brief Sends pending data packets and expires timed out sessions. Call
+     * this iteratively.
+     */
+    void step();
+
+  private:
+    //! Connection management control bytes
+    enum Control {
+        CM_RTS = 16,
+        CM_CTS = 17,
+        CM_END_OF_MSG_ACK = 19,
+        CM_BAM = 32,
+        CM_ABORT = 255
+    };
+
+    //! Connection abort reasons
+    enum AbortReason {
+        ABORT_NO_RESOURCES = 2,
+        ABORT_TIMEOUT = 3,
+        ABORT_BAD_SEQUENCE = 7,
+        //! Any reason J1939-21 doesn't list, e.g. an RTS whose packet count
+        //! doesn't match its size, or a CTS for another PGN
+        ABORT_OTHER = 250
+    };
+
+    enum SessionState {
+        SESSION_IDLE,
+        SESSION_RX_BAM,
+        SESSION_RX_CTS,
+        SESSION_TX_BAM,
+        SESSION_TX_WAIT_CTS,
+        SESSION_TX_SENDING,
+        SESSION_TX_WAIT_ACK
+    };
+
+    /**
+     * @brief State of one transfer
+     */
+    typedef struct {
+        SessionState state;
+        unsigned long PGN;
+        byte remote;
+        unsigned int size;
+        byte packets;
+        byte nextPacket;
+        byte windowEnd;
+        byte maxPerCTS;
+        unsigned long timer;
+        unsigned long timeout;
+        byte data[k_maxMessageSize];
+    } Session;
+
+    //! Bytes of payload in each data packet
+    static constexpr byte k_bytesPerPacket = 7;
+
+    //! Packets we allow per CTS when receiving
+    static constexpr byte k_packetsPerCTS = 8;
+
+    //! Time between BAM data packets (ms, J1939 allows 50 to 200)
+    static constexpr unsigned long k_bamPacketIntervalMillis = 50;
+
+    //! J1939-21 timeouts (ms)
+    static constexpr unsigned long k_timeoutT1 = 750;
+    static constexpr unsigned long k_timeoutT2 = 1250;
+    static constexpr unsigned long k_timeoutT3 = 1250;
+    static constexpr unsigned long k_timeoutT4 = 1050;
+
+    //! Priority of Transport Protocol frames
+    static constexpr byte k_priority = 7;
+
+    J1939Interface &bus;
+    byte address;
+
+    J1939TransportHandler receiveHandler;
+    void *receiveContext;
+
+    Session rxSessions[k_maxRxSessions];
+    Session txSession;
+
+    static void onConnectionManagement(const J1939Message &m, void *context);
+    static void onDataTransfer(const J1939Message &m, void *context);
+    void handleConnectionManagement(const J1939Message &m);
+    void handleDataTransfer(const J1939Message &m);
+
+    void handleTxControl(const J1939Message &m, byte source);
+    Session *findRxSession(byte source, bool broadcast);
+    void startTimer(Session &session, unsigned long timeout);
+    bool timerExpired(Session &session);
+    void sendClearToSend(Session &session);
+    void sendControl(byte dest, byte control, const byte *params,
+                     unsigned long PGN);
+    void sendAbort(byte dest, AbortReason reason, unsigned long PGN);
+    void sendTxDataPackets();
+    bool sendDataPacket(Session &session, byte dest);
+    void completeRx(Session &session);
+};
+} // namespace CAN
+
+#endif
@@ -11,6 +11,8 @@
 #ifndef PIN_MAPPINGS_GUARD_H
 #define PIN_MAPPINGS_GUARD_H
 
+#include "FixedPointAngle.h"
+
 #include <Controllino.h>
 
 #define PIN_CAST(pin) static_cast<unsigned char>((pin))
@@ -18,28 +20,104 @@
 namespace Constants {
 namespace Algorithm {
 //! The value past which any rotation is not acceptable
-constexpr double k_correctTiltAtDegrees = 0.1;
+constexpr Angle::MicroDegrees k_correctTiltAt = Angle::fromDegrees(0.1);
 
 //! The value/deadband which the algorithm should not attempt to correct
 //! deviations within
-constexpr double k_stopCorrectingTiltAtDegrees = 0.05;
+constexpr Angle::MicroDegrees k_stopCorrectingTiltAt = Angle::fromDegrees(0.05);
 
 //! The maximum amount of deviation from level before throwing a fault.
 //! This is an imporant safeguard against a ram failing to move!
-constexpr double k_maximumAllowableTiltRange = 10.0;
+constexpr Angle::MicroDegrees k_maximumAllowableTiltRange =
+    Angle::fromDegrees(10.0);
 
 //! The alpha for exponentially weighted average smoothing on the inclinometer
 //! (higher = less smoothing)
 constexpr double k_inclinometerEWMASmoothingAlpha = 0.5;
+
+//! Have the inclinometer send its gyro rates, and use them instead of the
+//! filtered finite difference to decide if the reading is stable. Takes
+//! effect on the sensor after it is reflashed.
+constexpr bool k_useMeasuredRates = false;
+
+//! The measured rate past which the reading is not stable (degrees/second)
+constexpr double k_unstableRateDegreesPerSecond = 0.1;
+
+//! Measured rates older than this are ignored (microseconds)
+constexpr unsigned long k_measuredRateMaxAge = 500000UL;
+
+//! Sample periods without data before the inclinometer is considered unready
+constexpr unsigned long k_sensorUnreadySamplePeriods = 5;
+
+//! Sample periods the reading has to be stable for before it is trusted
+constexpr unsigned long k_stabilitySamplePeriods = 10;
+
+//! Lower bound for both windows above, to ride out loop jitter (ms)
+constexpr unsigned long k_minimumSensorWindowMillis = 100;
+
+//! Run the model's angles through a Kalman filter (TiltEstimator) that tracks
+//! angle and rate, instead of smoothing them with the EWMA above. The
+//! estimator follows a steady tilt rate without lag.
+constexpr bool k_useTiltEstimator = false;
+
+//! Compute the model's angles with series approximations while they are
+//! small, which is quicker on the AVR and within 1e-6 radians of the exact
+//! path (Model::setSmallAngle()). Larger angles always take the exact path.
+constexpr bool k_useSmallAngleModel = true;
+
+//! Standard deviation of the inclinometer's angles, for the estimator
+//! (degrees)
+constexpr double k_estimatorAngleNoiseDegrees = 0.01;
+
+//! Standard deviation of the measured rates, for the estimator
+//! (degrees/second)
+constexpr double k_estimatorRateNoiseDegreesPerSecond = 0.05;
+
+//! How quickly the platform's tilt rate can change, for the estimator
+//! (degrees/second^1.5)
+constexpr double k_estimatorAccelerationNoise = 0.1;
+
+//! The estimate is not stable while its angles are less certain than this
+//! (standard deviation, degrees)
+constexpr double k_maximumEstimateDeviationDegrees = 0.02;
+
+//! ACEINNA provisioning profile used until one is selected
+constexpr byte k_defaultACEINNAProfile = 0;
+
+//! Largest difference allowed between the ACEINNA and the ADXL355, on either
+//! axis, before they are considered to disagree
+constexpr Angle::MicroDegrees k_sensorDisagreementLimit =
+    Angle::fromDegrees(0.5);
+
+//! How long the two inclinometers may disagree before faulting (ms)
+constexpr unsigned long k_sensorDisagreementMillis = 2000;
 } // namespace Algorithm
 
 namespace Physical {
 //! This value represents the yaw offset of the installed sensor, which cannot
 //! be determined automatically.
 constexpr double k_inclinometerInstalledYawAdjustment = 0.0;
+
+//! Yaw offset of the installed ADXL355, like the one above
+constexpr double k_accelerometerInstalledYawAdjustment = 0.0;
 } // namespace Physical
 
 namespace Pins {
+// ========= SENSOR WIRING ========= //
+//! Whether an ADXL355 is wired to the SPI bus, to check and refine the
+//! ACEINNA with. Without one the ACEINNA is used alone.
+constexpr bool k_accelerometerFitted = false;
+
+//! Chip select of the ADXL355, if fitted. The MEGA's hardware SS (pin 53)
+//! until one is wired, which has to be changed to match it.
+enum class SENSOR { ACCEL_CS = SS };
+
+//! External interrupt pin wired to the ADXL355's DRDY output, or -1 to drain
+//! its FIFO from the loop instead. Every INT pin of the MEGA is taken: D0/D1
+//! drive a ram, IN0/IN1 are 24 V inputs and SDA/SCL carry the FRAM.
+constexpr int k_accelerometerDrdyPin = -1;
+// ================================= //
+
 // ========= BUTTON INPUTS ========= //
 enum class BUTTON {
     ZERO = CONTROLLINO_A0,
@@ -0,0 +1,116 @@
+/**
+ * @file FastMath.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Fast approximations of atan2 and 1/sqrt with bounded error, for
+ * soft-float tilt calculations on the ATmega2560
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef FAST_MATH_GUARD_H
+#define FAST_MATH_GUARD_H
+
+#include <Arduino.h>
+
+namespace FastMath {
+
+//! Worst-case error of atan2() (radians): 1e-5 from the polynomial, plus
+//! float rounding. About 0.0007 degrees.
+constexpr float k_atan2MaxError = 1.2e-5f;
+
+//! Worst-case relative error of invSqrt() after its two Newton steps
+constexpr float k_invSqrtMaxRelativeError = 5e-6f;
+
+/**
+ * @brief Arctangent on [-1, 1], from Abramowitz & Stegun 4.4.47 (|error| <=
+ * 1e-5 radians). Five multiply-adds and no division.
+ *
+ * @param t the tangent, -1 to 1
+ * @return float the angle in radians, -pi/4 to pi/4
+ */
+inline float atanUnit(float t)
+{
+    float t2 = t * t;
+    return t *
+           (0.9998660f +
+            t2 * (-0.3302995f +
+                  t2 * (0.1801410f + t2 * (-0.0851330f + t2 * 0.0208351f))));
+}
+
+/**
+ * @brief Four-quadrant arctangent, within k_atan2MaxError of atan2()
+ *
+ * The ratio is folded into [-1, 1] so atanUnit() applies, which costs one
+ * division.
+ *
+ * @param y the y coordinate
+ * @param x the x coordinate
+ * @return float the angle of (x, y) in radians, -pi to pi (0 at the origin)
+ */
+inline float atan2(float y, float x)
+{
+    float ay = fabs(y);
+    float ax = fabs(x);
+    if (ax == 0 && ay == 0) {
+        return 0;
+    }
+    float angle = (ay <= ax) ? atanUnit(ay / ax)
+                             : (float)(PI / 2) - atanUnit(ax / ay);
+    if (x < 0) {
+        angle = (float)PI - angle;
+    }
+    return (y < 0) ? -angle : angle;
+}
+
+/**
+ * @brief 1/sqrt(v), within k_invSqrtMaxRelativeError
+ *
+ * Starts from the exponent trick on the float's bits and refines it with two
+ * Newton-Raphson steps, so it needs no division.
+ *
+ * @param v a positive number
+ * @return float 1/sqrt(v)
+ */
+inline float invSqrt(float v)
+{
+    union {
+        float f;
+        uint32_t i;
+    } bits;
+    bits.f = v;
+    bits.i = 0x5F3759DFUL - (bits.i >> 1);
+    float r = bits.f;
+    float half = 0.5f * v;
+    r = r * (1.5f - half * r * r);
+    r = r * (1.5f - half * r * r);
+    return r;
+}
+
+/**
+ * @brief Pitch and roll from a gravity vector, in any units
+ *
+ * Gives the same angles as atan(y / z) and atan(-x / sqrt(y^2 + z^2)) while
+ * the sensor is less than 90 degrees from upright, without normalizing the
+ * vector first (the scale cancels out). Error is at most about
+ * 2 * k_atan2MaxError.
+ *
+ * @param x gravity along the sensor's X axis
+ * @param y gravity along the sensor's Y axis
+ * @param z gravity along the sensor's Z axis
+ * @param pitch overwritten with the pitch (radians)
+ * @param roll overwritten with the roll (radians)
+ */
+inline void tiltFromGravity(float x, float y, float z, float &pitch,
+                            float &roll)
+{
+    float yz = y * y + z * z;
+    pitch = FastMath::atan2(y, z);
+    // yz / sqrt(yz), which is 0 rather than NaN when yz is 0
+    roll = FastMath::atan2(-x, yz * invSqrt(yz));
+}
+} // namespace FastMath
+
+#endif
\ No newline at end of file
@@ -0,0 +1,365 @@
+/**
+ * @file Filters.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Digital filters that are put together at compile time
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef FILTERS_GUARD_H
+#define FILTERS_GUARD_H
+
+#include <Arduino.h>
+
+/**
+ * Every filter here has the same shape, without a common base class:
+ *
+ *  - Scalar add(Scalar x) takes a sample and returns the filtered value
+ *  - Scalar add(Scalar x, float dt) does the same, dt seconds after the
+ *    previous sample (only DtEwma uses dt, the rest ignore it)
+ *  - Scalar get() returns the newest filtered value
+ *  - void reset(Scalar x) settles the filter as if x had always come in
+ *
+ * so they can be chained (Chain<Median<5>, Biquad<>>) and run over several
+ * axes (Axes<..., 3>) with every call resolved at compile time. The Scalar can
+ * be float, double or Fixed<>. A default constructed filter passes samples
+ * straight through, until a configured one is assigned to it.
+ */
+namespace Filter {
+
+/**
+ * @brief Signed fixed point number, with FractionBits of its 32 bits after
+ * the binary point
+ *
+ * Has just the arithmetic the filters need. Products and quotients go
+ * through 64 bits, so they don't overflow on the way.
+ *
+ * A biquad's rounding grows as its cutoff drops relative to the sample
+ * rate. On angles in radians, Fixed<16> stays within 4e-4 of double down to
+ * a cutoff of a twentieth of the rate, Fixed<20> down to a hundredth (see
+ * extras/host/filtertest).
+ */
+template <byte FractionBits = 16> class Fixed {
+  public:
+    Fixed() : raw(0){};
+    Fixed(double value) : raw(toRaw(value)){};
+
+    /**
+     * @brief Makes a number straight from its bits
+     *
+     * @param raw the value times 2^FractionBits
+     * @return Fixed the number
+     */
+    static Fixed fromRaw(long raw)
+    {
+        Fixed f;
+        f.raw = raw;
+        return f;
+    };
+
+    long getRaw() const { return raw; };
+    double toDouble() const { return raw * (1.0 / (1L << FractionBits)); };
+
+    Fixed operator+(Fixed other) const { return fromRaw(raw + other.raw); };
+    Fixed operator-(Fixed other) const { return fromRaw(raw - other.raw); };
+    Fixed operator-() const { return fromRaw(-raw); };
+    Fixed operator*(Fixed other) const
+    {
+        return fromRaw((long)(((long long)raw * other.raw) >> FractionBits));
+    };
+    Fixed operator/(Fixed other) const
+    {
+        return fromRaw((long)(((long long)raw << FractionBits) / other.raw));
+    };
+    Fixed &operator+=(Fixed other)
+    {
+        raw += other.raw;
+        return *this;
+    };
+    bool operator<(Fixed other) const { return raw < other.raw; };
+    bool operator>(Fixed other) const { return raw > other.raw; };
+
+  private:
+    long raw;
+
+    static long toRaw(double value)
+    {
+        // Round to the nearest, not towards zero
+        return (long)(value * (1L << FractionBits) + (value < 0 ? -0.5 : 0.5));
+    };
+};
+
+/**
+ * @brief Exponentially weighted moving average
+ */
+template <typename Scalar = float> class Ewma {
+  public:
+    typedef Scalar ScalarType;
+
+    /**
+     * @brief Construct a new Ewma object
+     *
+     * @param alpha weight of each new sample (0.0 to 1.0). Lower gives more
+     * weight to older data, i.e. a heavier average
+     * @param start the initial value to average against
+     */
+    Ewma(Scalar alpha, Scalar start = 0) : alpha(alpha), average(start){};
+    Ewma() : alpha(1), average(0){};
+
+    Scalar add(Scalar x)
+    {
+        average += alpha * (x - average);
+        return average;
+    };
+    Scalar add(Scalar x, float) { return add(x); };
+
+    /**
+     * @brief Adds a sample that counts for less than a full one
+     *
+     * @param x the sample
+     * @param weight how much it counts (0.0 to 1.0), scales alpha
+     * @return Scalar the filtered value
+     */
+    Scalar addWeighted(Scalar x, Scalar weight)
+    {
+        average += alpha * weight * (x - average);
+        return average;
+    };
+
+    Scalar get() const { return average; };
+    void reset(Scalar x) { average = x; };
+
+  private:
+    Scalar alpha;
+    Scalar average;
+};
+
+/**
+ * @brief Exponentially weighted moving average with a time constant, for
+ * samples that don't come in at a steady rate
+ */
+template <typename Scalar = float> class DtEwma {
+  public:
+    typedef Scalar ScalarType;
+
+    /**
+     * @brief Construct a new DtEwma object
+     *
+     * @param timeConstant time to cover 63 % of a step (seconds)
+     * @param samplePeriod time between samples, for add() without dt
+     * (seconds)
+     * @param start the initial value to average against
+     */
+    DtEwma(float timeConstant, float samplePeriod, Scalar start = 0)
+        : timeConstant(timeConstant), samplePeriod(samplePeriod),
+          average(start){};
+    DtEwma() : timeConstant(0), samplePeriod(1), average(0){};
+
+    Scalar add(Scalar x) { return add(x, samplePeriod); };
+    Scalar add(Scalar x, float dt)
+    {
+        // The exact discretization is 1 - e^(-dt / tau), this is its first
+        // order approximation, which stays between 0 and 1 for any dt
+        Scalar alpha = dt / (timeConstant + dt);
+        average += alpha * (x - average);
+        return average;
+    };
+
+    Scalar get() const { return average; };
+    void reset(Scalar x) { average = x; };
+
+  private:
+    float timeConstant;
+    float samplePeriod;
+    Scalar average;
+};
+
+/**
+ * @brief Second order IIR filter (transposed direct form II)
+ *
+ * Coefficients are normalized so a0 is 1:
+ * y = b0 x + b1 x[-1] + b2 x[-2] - a1 y[-1] - a2 y[-2]
+ */
+template <typename Scalar = float> class Biquad {
+  public:
+    typedef Scalar ScalarType;
+
+    Biquad(Scalar b0, Scalar b1, Scalar b2, Scalar a1, Scalar a2)
+        : b0(b0), b1(b1), b2(b2), a1(a1), a2(a2), z1(0), z2(0), output(0){};
+    Biquad() : b0(1), b1(0), b2(0), a1(0), a2(0), z1(0), z2(0), output(0){};
+
+    /**
+     * @brief Makes a Butterworth (or other Q) low pass filter, from the
+     * Audio EQ Cookbook
+     *
+     * @param cutoff -3 dB frequency (Hz)
+     * @param sampleRate rate samples come in at (Hz)
+     * @param q quality factor, 0.7071 is Butterworth
+     * @return Biquad the filter, settled at 0
+     */
+    static Biquad lowPass(float cutoff, float sampleRate, float q = 0.7071)
+    {
+        float w0 = 2 * PI * cutoff / sampleRate;
+        float alpha = sin(w0) / (2 * q);
+        float cosW0 = cos(w0);
+        float a0 = 1 + alpha;
+        float b = (1 - cosW0) / 2 / a0;
+        return Biquad(b, 2 * b, b, -2 * cosW0 / a0, (1 - alpha) / a0);
+    };
+
+    Scalar add(Scalar x)
+    {
+        output = b0 * x + z1;
+        z1 = b1 * x - a1 * output + z2;
+        z2 = b2 * x - a2 * output;
+        return output;
+    };
+    Scalar add(Scalar x, float) { return add(x); };
+
+    Scalar get() const { return output; };
+    void reset(Scalar x)
+    {
+        // The state a constant input x ends up at
+        output = x * ((b0 + b1 + b2) / (Scalar(1) + a1 + a2));
+        z1 = output - b0 * x;
+        z2 = b2 * x - a2 * output;
+    };
+
+  private:
+    Scalar b0, b1, b2, a1, a2;
+    Scalar z1, z2;
+    Scalar output;
+};
+
+/**
+ * @brief Median of the last Size samples, which removes spikes without
+ * smearing them into the samples around them
+ */
+template <byte Size, typename Scalar = float> class Median {
+  public:
+    typedef Scalar ScalarType;
+
+    Median() : next(0), count(0), output(0){};
+
+    Scalar add(Scalar x)
+    {
+        window[next] = x;
+        next = (next + 1) % Size;
+        if (count < Size) {
+            count++;
+        }
+
+        // Insertion sort a copy, which is quick for the few samples a
+        // median filter holds
+        Scalar sorted[Size];
+        for (byte i = 0; i < count; i++) {
+            Scalar value = window[i];
+            byte j = i;
+            for (; j > 0 && value < sorted[j - 1]; j--) {
+                sorted[j] = sorted[j - 1];
+            }
+            sorted[j] = value;
+        }
+        output = sorted[count / 2];
+        return output;
+    };
+    Scalar add(Scalar x, float) { return add(x); };
+
+    Scalar get() const { return output; };
+    void reset(Scalar x)
+    {
+        for (byte i = 0; i < Size; i++) {
+            window[i] = x;
+        }
+        count = Size;
+        output = x;
+    };
+
+  private:
+    Scalar window[Size];
+    byte next;
+    byte count;
+    Scalar output;
+};
+
+/**
+ * @brief Runs filters one after the other, each on the output of the one
+ * before
+ */
+template <typename First, typename... Rest> class Chain {
+  public:
+    typedef typename First::ScalarType ScalarType;
+
+    Chain(const First &first, const Rest &... rest)
+        : first(first), rest(rest...){};
+    Chain(){};
+
+    ScalarType add(ScalarType x) { return rest.add(first.add(x)); };
+    ScalarType add(ScalarType x, float dt)
+    {
+        return rest.add(first.add(x, dt), dt);
+    };
+    ScalarType get() const { return rest.get(); };
+    void reset(ScalarType x)
+    {
+        first.reset(x);
+        rest.reset(first.get());
+    };
+
+  private:
+    First first;
+    Chain<Rest...> rest;
+};
+
+template <typename Last> class Chain<Last> {
+  public:
+    typedef typename Last::ScalarType ScalarType;
+
+    Chain(const Last &last) : last(last){};
+    Chain(){};
+
+    ScalarType add(ScalarType x) { return last.add(x); };
+    ScalarType add(ScalarType x, float dt) { return last.add(x, dt); };
+    ScalarType get() const { return last.get(); };
+    void reset(ScalarType x) { last.reset(x); };
+
+  private:
+    Last last;
+};
+
+/**
+ * @brief The same filter (or chain), run separately on each of Count axes
+ */
+template <typename Stage, byte Count> class Axes {
+  public:
+    typedef typename Stage::ScalarType ScalarType;
+
+    /**
+     * @brief Construct a new Axes object
+     *
+     * @param prototype the filter every axis starts out as a copy of
+     */
+    Axes(const Stage &prototype)
+    {
+        for (byte i = 0; i < Count; i++) {
+            stages[i] = prototype;
+        }
+    };
+
+    ScalarType add(byte axis, ScalarType x) { return stages[axis].add(x); };
+    ScalarType add(byte axis, ScalarType x, float dt)
+    {
+        return stages[axis].add(x, dt);
+    };
+    ScalarType get(byte axis) const { return stages[axis].get(); };
+    void reset(byte axis, ScalarType x) { stages[axis].reset(x); };
+
+  private:
+    Stage stages[Count];
+};
+} // namespace Filter
+
+#endif
\ No newline at end of file
@@ -0,0 +1,134 @@
+/**
+ * @file FixedPointAngle.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Fixed point angles in micro-degrees, for integer-only angle handling
+ * on the ATmega2560
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef FIXED_POINT_ANGLE_GUARD_H
+#define FIXED_POINT_ANGLE_GUARD_H
+
+#include <Arduino.h>
+
+namespace Angle {
+
+/**
+ * @brief An angle in micro-degrees (1e-6 degree per bit). A 32-bit long
+ * covers +-2147 degrees, so every sum or difference of two tilt angles fits.
+ */
+typedef long MicroDegrees;
+
+//! Micro-degrees in one degree
+constexpr MicroDegrees k_perDegree = 1000000L;
+
+/**
+ * @brief Converts degrees to micro-degrees, rounding to the nearest. Meant
+ * for constants, since it is evaluated at compile time.
+ *
+ * @param degrees the angle in degrees
+ * @return constexpr MicroDegrees the angle in micro-degrees
+ */
+constexpr MicroDegrees fromDegrees(double degrees)
+{
+    return (MicroDegrees)(degrees * k_perDegree + (degrees < 0 ? -0.5 : 0.5));
+}
+
+/**
+ * @brief Converts radians to micro-degrees, rounding to the nearest
+ *
+ * @param radians the angle in radians
+ * @return MicroDegrees the angle in micro-degrees
+ */
+inline MicroDegrees fromRadians(double radians)
+{
+    return fromDegrees(radians * (180.0 / PI));
+}
+
+/**
+ * @brief Converts micro-degrees to radians
+ *
+ * @param angle the angle in micro-degrees
+ * @return double the angle in radians
+ */
+inline double toRadians(MicroDegrees angle)
+{
+    return angle * (PI / 180.0 / k_perDegree);
+}
+
+/**
+ * @brief Converts micro-degrees to degrees
+ *
+ * @param angle the angle in micro-degrees
+ * @return double the angle in degrees
+ */
+inline double toDegrees(MicroDegrees angle)
+{
+    return angle * (1.0 / k_perDegree);
+}
+
+/**
+ * @brief Decodes a 24-bit SAE J1939 SSI2 pitch or roll field (1/32768 degree
+ * per bit, offset -250 degrees)
+ *
+ * raw * 1e6 / 32768 is raw * 15625 / 512. The product needs 38 bits, so it is
+ * split at bit 9, which keeps every step in 32 bits and gives exactly the
+ * floor of the true value.
+ *
+ * @param raw the 24-bit field
+ * @return MicroDegrees the angle in micro-degrees
+ */
+inline MicroDegrees fromSSI2(unsigned long raw)
+{
+    unsigned long whole = (raw >> 9) * 15625UL;
+    unsigned long part = ((raw & 511UL) * 15625UL) >> 9;
+    return (MicroDegrees)(whole + part) - 250L * k_perDegree;
+}
+
+/**
+ * @brief Checks if an angle is within +-limit
+ *
+ * @param angle the angle to check
+ * @param limit the largest allowed magnitude
+ * @return true if -limit <= angle <= limit
+ * @return false if the angle is outside the range
+ */
+inline bool withinRange(MicroDegrees angle, MicroDegrees limit)
+{
+    return angle <= limit && angle >= -limit;
+}
+
+/**
+ * @brief Prints an angle in degrees without going through floating point
+ *
+ * @param out where to print (e.g. Serial)
+ * @param angle the angle in micro-degrees
+ * @param decimals number of decimal places (0 to 6)
+ * @return size_t number of characters printed
+ */
+inline size_t printDegrees(Print &out, MicroDegrees angle, byte decimals = 3)
+{
+    size_t n = 0;
+    unsigned long magnitude = (angle < 0) ? -angle : angle;
+    if (angle < 0) {
+        n += out.print('-');
+    }
+    n += out.print(magnitude / k_perDegree);
+    if (decimals > 0) {
+        unsigned long fraction = magnitude % k_perDegree;
+        n += out.print('.');
+        unsigned long digit = k_perDegree / 10;
+        for (byte i = 0; i < decimals && i < 6; i++) {
+            n += out.print((char)('0' + (fraction / digit) % 10));
+            digit /= 10;
+        }
+    }
+    return n;
+}
+} // namespace Angle
+
+#endif
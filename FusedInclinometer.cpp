@@ -0,0 +1,261 @@
+#include "FusedInclinometer.h"
+
+#include "FaultHandling.h"
+
+using namespace Rotation;
+
+Inclinometer::FusedInclinometer::FusedInclinometer(
+    InclinometerDataSource &primary, InclinometerDataSource *secondary,
+    Angle::MicroDegrees disagreementLimit, unsigned long disagreementMillis,
+    double secondaryYaw)
+    : primary(primary), secondary(secondary),
+      disagreementLimit(disagreementLimit),
+      disagreementMillis(disagreementMillis), secondaryYaw(secondaryYaw),
+      secondaryStarted(false), aligned(false), secondaryLatest(0, 0),
+      disagreeing(false), disagreeingSince(0), fused(false), primaryWeight(1)
+{
+    latest.angles = Vec2(0, 0);
+    latest.timestamp = 0;
+    latest.quality.figureOfMerit = MERIT_NOT_AVAILABLE;
+    latest.quality.compensation = COMPENSATION_NOT_AVAILABLE;
+    latest.quality.latency = 0;
+}
+
+bool Inclinometer::FusedInclinometer::begin()
+{
+    // The primary alone is enough to run on, so a secondary that doesn't
+    // start is left out (see isSecondaryRunning()) instead of faulting
+    bool started = primary.begin();
+    secondaryStarted = secondary != NULL && secondary->begin();
+    return started;
+}
+
+bool Inclinometer::FusedInclinometer::hasData()
+{
+    readSecondary();
+    return primary.hasData();
+}
+
+Vec2 Inclinometer::FusedInclinometer::getData()
+{
+    // Only the newest sample is wanted, like the other sources
+    Sample sample;
+    readAll(&sample, 1);
+    return latest.angles;
+}
+
+byte Inclinometer::FusedInclinometer::readAll(Sample *samples, byte capacity)
+{
+    // The secondary goes first, so its history covers the primary samples
+    readSecondary();
+    byte count = primary.readAll(samples, capacity);
+    for (byte i = 0; i < count; i++) {
+        fuse(samples[i]);
+    }
+    if (count > 0) {
+        latest = samples[count - 1];
+    }
+    return count;
+}
+
+bool Inclinometer::FusedInclinometer::setAlignment(
+    const ModelZeropoint &primaryZero, const ModelZeropoint &secondaryZero)
+{
+    // Both sensors see the same level frame: base * Z1^T * M1 equals
+    // base * Rz(yaw) * Z2^T * M2, so M1 = Z1 * Rz(yaw) * Z2^T * M2
+    // Storage that was never written holds garbage
+    aligned = isValidZero(primaryZero) && isValidZero(secondaryZero);
+    if (aligned) {
+        alignment = (zeroToFrame(primaryZero) * Rot3::aboutZ(secondaryYaw))
+                        .multiplyTranspose(zeroToFrame(secondaryZero));
+    }
+
+    // Samples from before are in the old alignment
+    secondaryHistory.clear();
+    disagreeing = false;
+    return aligned;
+}
+
+Inclinometer::ModelZeropoint Inclinometer::FusedInclinometer::zeroSecondary()
+{
+    Model<> frame;
+    return frame.setMeasurementAsZero(secondaryLatest);
+}
+
+void Inclinometer::FusedInclinometer::readSecondary()
+{
+    if (!secondaryStarted) {
+        return;
+    }
+    Sample batch[4];
+    byte count = secondary->readAll(batch, 4);
+    for (byte i = 0; i < count; i++) {
+        secondaryLatest = batch[i].angles;
+        secondaryNoise.add(batch[i].angles);
+        if (!aligned) {
+            continue;
+        }
+
+        Vec2 angles = align(batch[i].angles);
+        unsigned long measured =
+            batch[i].timestamp - batch[i].quality.latency;
+        secondaryHistory.add(angles, measured,
+                             batch[i].quality.figureOfMerit != MERIT_FULL);
+
+        // Against the primary at the same moment, so a steady tilt doesn't
+        // look like a disagreement. The primary is always at least as new.
+        AlignedSample reference;
+        float noiseFactor;
+        if (primaryHistory.at(measured, k_maximumSkewMicros, reference,
+                              noiseFactor)) {
+            checkParity(reference.angles - angles);
+        }
+    }
+}
+
+void Inclinometer::FusedInclinometer::fuse(Sample &sample)
+{
+    // The ACEINNA's timestamp is when the sample arrived, the latency says
+    // how long before that it was measured
+    unsigned long measured = sample.timestamp - sample.quality.latency;
+    primaryNoise.add(sample.angles);
+    primaryHistory.add(sample.angles, measured,
+                       sample.quality.figureOfMerit != MERIT_FULL);
+    fused = false;
+    primaryWeight = 1;
+
+    // The secondary usually samples slower, it is extrapolated for up to
+    // one of its sample periods
+    AlignedSample other;
+    float noiseFactor;
+    if (!secondaryStarted || !aligned || disagreeing ||
+        !secondaryHistory.at(measured,
+                             secondary->getSamplePeriod() +
+                                 k_maximumSkewMicros,
+                             other, noiseFactor)) {
+        return;
+    }
+
+    Vec2 difference = sample.angles - other.angles;
+
+    float primaryVariance = primaryNoise.get();
+    float secondaryVariance = secondaryNoise.get() * noiseFactor;
+    if (sample.quality.figureOfMerit != MERIT_FULL) {
+        primaryVariance *= k_degradedVarianceFactor;
+    }
+    if (other.degraded) {
+        secondaryVariance *= k_degradedVarianceFactor;
+    }
+    primaryWeight = secondaryVariance / (primaryVariance + secondaryVariance);
+    sample.angles = other.angles + difference * primaryWeight;
+    fused = true;
+}
+
+void Inclinometer::FusedInclinometer::checkParity(const Vec2 &difference)
+{
+    const double limit = Angle::toRadians(disagreementLimit);
+    if (fabs(difference[0]) <= limit && fabs(difference[1]) <= limit) {
+        disagreeing = false;
+        return;
+    }
+    if (!disagreeing) {
+        disagreeing = true;
+        disagreeingSince = millis();
+    }
+    else if (millis() - disagreeingSince >= disagreementMillis) {
+        Fault::Handler::instance()->setFaultCode(Fault::ACCEL_PARITY_FAILURE);
+    }
+}
+
+Vec2 Inclinometer::FusedInclinometer::align(const Vec2 &angles)
+{
+    // The measured frame is Rx(angles[0]) * Ry(angles[1]), as in the model,
+    // and the model's output only depends on its last column. So only that
+    // column is rotated, and the angles come straight back out of it.
+    double sinPitch = sin(angles[1]);
+    double cosPitch = cos(angles[1]);
+    Vec3 column(sinPitch, -sin(angles[0]) * cosPitch,
+                cos(angles[0]) * cosPitch);
+    Vec3 aligned = alignment * column;
+    return Vec2(atan2(-aligned[1], aligned[2]),
+                atan2(aligned[0], sqrt(aligned[1] * aligned[1] +
+                                       aligned[2] * aligned[2])));
+}
+
+template <byte N>
+void Inclinometer::FusedInclinometer::History<N>::add(const Vec2 &angles,
+                                                       unsigned long timestamp,
+                                                       bool degraded)
+{
+    if (count == N) {
+        head = (head + 1) % N;
+        count--;
+    }
+    AlignedSample &sample = samples[(head + count) % N];
+    sample.angles = angles;
+    sample.timestamp = timestamp;
+    sample.degraded = degraded;
+    count++;
+}
+
+template <byte N>
+bool Inclinometer::FusedInclinometer::History<N>::at(unsigned long time,
+                                                      unsigned long hold,
+                                                      AlignedSample &sample,
+                                                      float &noiseFactor)
+{
+    // Newest first, count the samples after the time
+    byte newer = 0;
+    while (newer < count &&
+           (long)(time - samples[(head + count - 1 - newer) % N].timestamp) <
+               0) {
+        newer++;
+    }
+    noiseFactor = 1;
+    if (newer == count) {
+        // Every sample is newer (or there are none), use the oldest if it's
+        // close enough
+        sample = samples[head];
+        return count > 0 && sample.timestamp - time <= hold;
+    }
+
+    byte i = count - 1 - newer;
+    if (newer == 0) {
+        // Nothing newer yet, extrapolate from the newest two if the newest
+        // is recent enough
+        if (time - samples[(head + i) % N].timestamp > hold) {
+            return false;
+        }
+        if (i == 0) {
+            sample = samples[head];
+            return true;
+        }
+        i--;
+    }
+
+    const AlignedSample &before = samples[(head + i) % N];
+    const AlignedSample &after = samples[(head + i + 1) % N];
+    unsigned long span = after.timestamp - before.timestamp;
+    double fraction =
+        (span > 0) ? (double)(time - before.timestamp) / span : 1.0;
+    sample.angles = before.angles + (after.angles - before.angles) * fraction;
+    sample.timestamp = time;
+    sample.degraded = before.degraded || after.degraded;
+    // Both samples' noise, in the proportions they go in
+    noiseFactor = (1 - fraction) * (1 - fraction) + fraction * fraction;
+    return true;
+}
+
+void Inclinometer::FusedInclinometer::NoiseEstimate::add(
+    const Vec2 &angles)
+{
+    if (count < 2) {
+        previous[count++] = angles;
+        return;
+    }
+    Vec2 secondDifference = angles - previous[1] * 2 + previous[0];
+    previous[0] = previous[1];
+    previous[1] = angles;
+    // Per axis: var(second difference) / 6, averaged over both axes
+    variance.add(secondDifference.squaredNorm() / 12.0);
+}
\ No newline at end of file
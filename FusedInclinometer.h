@@ -0,0 +1,251 @@
+/**
+ * @file FusedInclinometer.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Runs two inclinometers side by side, fuses their readings and
+ * cross-checks them against each other
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef FUSED_INCLINOMETER_GUARD_H
+#define FUSED_INCLINOMETER_GUARD_H
+
+#include "FixedPointAngle.h"
+#include "InclinometerInterface.h"
+#include "InclinometerModel.h"
+#include "Filters.h"
+
+#include <Arduino.h>
+
+namespace Inclinometer {
+
+/**
+ * @brief A data source made of a primary and a secondary inclinometer
+ *
+ * Samples come out at the primary's rate, in the primary's frame, so the
+ * Module around this works (and zeroes) as if the primary were alone. The
+ * secondary's angles are rotated into the primary's frame with the two zero
+ * frames (see setAlignment()), and matched to each primary sample by the
+ * time it was measured: interpolated between secondary samples, or
+ * extrapolated from the newest two until the next comes in, so a steady
+ * tilt doesn't leave it behind. The two are then averaged, each
+ * weighted by the inverse of its noise variance, which is estimated from
+ * the samples as they come in. Neither source should smooth its samples,
+ * that hides their noise from the estimate and delays them.
+ *
+ * Each secondary sample is compared with the primary at the time it was
+ * measured. If the two disagree by more than the limit for longer than the
+ * allowed time, ACCEL_PARITY_FAILURE is raised. While they disagree, or
+ * while the secondary is missing, failed to start or is not aligned, the
+ * primary is used alone.
+ */
+class FusedInclinometer final : public InclinometerDataSource {
+  public:
+    //! Secondary samples kept to interpolate between
+    static constexpr byte k_secondaryHistory = 8;
+
+    //! Primary samples kept to check the secondary against, which has to
+    //! cover a secondary sample period and the time to read it out
+    static constexpr byte k_primaryHistory = 32;
+
+    //! Furthest a sample may be from the other sensor's in time and still
+    //! be compared with it, past the secondary's sample period when the
+    //! secondary is extrapolated (microseconds)
+    static constexpr unsigned long k_maximumSkewMicros = 100000UL;
+
+    //! Smoothing of the noise variance estimates (higher = less smoothing)
+    static constexpr float k_varianceAlpha = 0.05;
+
+    //! Smallest noise variance either sensor is assumed to have (radians^2)
+    static constexpr float k_minimumVariance = 1e-10;
+
+    //! A degraded sample is trusted as if it were this much noisier
+    static constexpr float k_degradedVarianceFactor = 4;
+
+    /**
+     * @brief Construct a new FusedInclinometer object
+     *
+     * @param primary the sensor that sets the timing and the frame
+     * @param secondary the sensor to check and refine it with, or NULL if
+     * there is none
+     * @param disagreementLimit largest difference allowed between the two,
+     * on either axis
+     * @param disagreementMillis how long they may disagree before the fault
+     * is raised (ms)
+     * @param secondaryYaw yaw of the secondary relative to the primary
+     * (radians), which zeroing cannot determine
+     */
+    FusedInclinometer(InclinometerDataSource &primary,
+                      InclinometerDataSource *secondary,
+                      Angle::MicroDegrees disagreementLimit,
+                      unsigned long disagreementMillis,
+                      double secondaryYaw = 0.0);
+
+    //! Inclinometer Data Source Interface Methods
+
+    bool begin() override;
+    bool hasData() override;
+    Rotation::Vec2 getData() override;
+    unsigned long getTimestamp() override { return latest.timestamp; };
+    unsigned long getSamplePeriod() override
+    {
+        return primary.getSamplePeriod();
+    };
+    byte readAll(Sample *samples, byte capacity) override;
+    bool getRates(RateSample &rates) override
+    {
+        return primary.getRates(rates);
+    };
+
+    /**
+     * @brief Aligns the secondary with the primary, from zero frames taken
+     * at the same time
+     *
+     * @param primaryZero the primary's zero frame (from Module::zero())
+     * @param secondaryZero the secondary's zero frame (from zeroSecondary())
+     * @return true if both are rotations, and fusion can start
+     * @return false if either one isn't (e.g. never written to storage), the
+     * primary is used alone until the next alignment
+     */
+    bool setAlignment(const ModelZeropoint &primaryZero,
+                      const ModelZeropoint &secondaryZero);
+
+    /**
+     * @brief Makes a zero frame from the secondary's newest measurement, to
+     * take together with the primary's
+     *
+     * @return ModelZeropoint the secondary's zero frame
+     */
+    ModelZeropoint zeroSecondary();
+
+    /**
+     * @brief Checks if the secondary started. One that didn't is left out,
+     * the primary alone is enough to run on.
+     *
+     * @return true if the secondary is read and fused
+     * @return false if there is none or it failed to start
+     */
+    bool isSecondaryRunning() { return secondaryStarted; };
+
+    /**
+     * @brief Checks if the newest sample was fused from both sensors
+     *
+     * @return true if both sensors went into the newest sample
+     * @return false if it came from the primary alone
+     */
+    bool isFused() { return fused; };
+
+    /**
+     * @brief Get the weight the primary had in the newest fused sample
+     *
+     * @return float weight, from 0 to 1 (the secondary has the rest)
+     */
+    float getPrimaryWeight() { return primaryWeight; };
+
+  private:
+    /**
+     * @brief A sample in the primary's frame, stamped with the time it was
+     * measured
+     */
+    typedef struct {
+        Rotation::Vec2 angles;
+        unsigned long timestamp;
+        bool degraded;
+    } AlignedSample;
+
+    /**
+     * @brief The newest samples of one sensor, to find its angles at a time
+     * in between them
+     */
+    template <byte N> class History {
+      public:
+        History() : head(0), count(0){};
+
+        void clear() { count = 0; };
+
+        void add(const Rotation::Vec2 &angles, unsigned long timestamp,
+                 bool degraded);
+
+        /**
+         * @brief Get the angles at a time, interpolated between the samples
+         * around it, or extrapolated from the newest two
+         *
+         * @param time when (micros())
+         * @param hold furthest the nearest sample may be from the time, if
+         * there are none on both sides (microseconds)
+         * @param sample overwritten with the angles
+         * @param noiseFactor overwritten with the noise variance of the
+         * result, relative to that of one sample
+         * @return true if the time is covered
+         */
+        bool at(unsigned long time, unsigned long hold, AlignedSample &sample,
+                float &noiseFactor);
+
+      private:
+        //! Oldest at head
+        AlignedSample samples[N];
+        byte head;
+        byte count;
+    };
+
+    /**
+     * @brief Estimates the noise variance of a sequence of angles
+     *
+     * Uses second differences, which a constant rate of tilt drops out of.
+     * For white noise their variance is six times the noise variance.
+     */
+    class NoiseEstimate {
+      public:
+        NoiseEstimate() : variance(k_varianceAlpha), count(0){};
+
+        void add(const Rotation::Vec2 &angles);
+
+        float get()
+        {
+            float v = variance.get();
+            return (v > k_minimumVariance) ? v : k_minimumVariance;
+        };
+
+      private:
+        Filter::Ewma<float> variance;
+        Rotation::Vec2 previous[2];
+        byte count;
+    };
+
+    InclinometerDataSource &primary;
+    InclinometerDataSource *secondary;
+    Angle::MicroDegrees disagreementLimit;
+    unsigned long disagreementMillis;
+    double secondaryYaw;
+
+    bool secondaryStarted;
+    bool aligned;
+    //! Rotates a secondary measurement frame into the primary's
+    Rotation::Rot3 alignment;
+
+    History<k_secondaryHistory> secondaryHistory;
+    //! Raw primary samples, before fusion
+    History<k_primaryHistory> primaryHistory;
+    Rotation::Vec2 secondaryLatest;
+
+    NoiseEstimate primaryNoise;
+    NoiseEstimate secondaryNoise;
+
+    bool disagreeing;
+    unsigned long disagreeingSince;
+
+    Sample latest;
+    bool fused;
+    float primaryWeight;
+
+    void readSecondary();
+    void fuse(Sample &sample);
+    void checkParity(const Rotation::Vec2 &difference);
+    Rotation::Vec2 align(const Rotation::Vec2 &angles);
+};
+}; // namespace Inclinometer
+
+#endif
\ No newline at end of file
@@ -1,8 +1,7 @@
 #include "HighestCornerAlgorithm.h"
 
-#include <cmath>
-
-void HighestCornerAlgo::update(double roll, double pitch)
+void HighestCornerAlgo::update(Angle::MicroDegrees roll,
+                               Angle::MicroDegrees pitch)
 {
     if (roll > upperbound) {
         if (pitch > upperbound) {
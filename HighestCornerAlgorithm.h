@@ -13,6 +13,8 @@
 #ifndef HIGHEST_CORNER_ALGO_H
 #define HIGHEST_CORNER_ALGO_H
 
+#include "FixedPointAngle.h"
+
 /**
  * @brief This class calculates the highest (or lowest) corner of a plane given
  * roll and pitch angles with configurable hysteresis.
@@ -29,10 +31,17 @@ class HighestCornerAlgo {
      * @param hystHigh the upper bound for which to correct deviations that are
      * larger
      */
-    HighestCornerAlgo(double hystLow, double hystHigh)
+    HighestCornerAlgo(Angle::MicroDegrees hystLow, Angle::MicroDegrees hystHigh)
         : corners({false, false, false, false}), lowerbound(hystLow),
           upperbound(hystHigh){};
-    void update(double roll, double pitch);
+
+    /**
+     * @brief Recalculates the high corners from a new measurement
+     *
+     * @param roll the roll angle
+     * @param pitch the pitch angle
+     */
+    void update(Angle::MicroDegrees roll, Angle::MicroDegrees pitch);
 
     /**
      * @brief Check if a given corner is high or low. Note: Corner 0 is the 1st
@@ -52,8 +61,8 @@ class HighestCornerAlgo {
 
   private:
     bool corners[4];
-    double lowerbound;
-    double upperbound;
+    Angle::MicroDegrees lowerbound;
+    Angle::MicroDegrees upperbound;
     void resetAll()
     {
         corners[0] = false;
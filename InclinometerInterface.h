@@ -10,16 +10,72 @@
  */
 #ifndef PLC_INCLINOMETER_INTERFACE_H
 #define PLC_INCLINOMETER_INTERFACE_H
-#include <stlport.h>
+#include "Rotation.h"
 
-#include <Eigen30.h>
-
-#include <Eigen/Core>
-#include <Eigen/Geometry>
+#include <Arduino.h>
 
 namespace Inclinometer {
+/**
+ * @brief How much a measurement can be trusted (SAE J1939 figure of merit)
+ */
+enum FigureOfMerit {
+    MERIT_FULL = 0,
+    MERIT_DEGRADED = 1,
+    MERIT_ERROR = 2,
+    MERIT_NOT_AVAILABLE = 3
+};
+
+/**
+ * @brief State of the sensor's own compensation (SAE J1939)
+ */
+enum Compensation {
+    COMPENSATION_OFF = 0,
+    COMPENSATION_ON = 1,
+    COMPENSATION_ERROR = 2,
+    COMPENSATION_NOT_AVAILABLE = 3
+};
+
+/**
+ * @brief Quality indicators that come with a measurement
+ */
+typedef struct {
+    //! The worse FigureOfMerit of the two angles: DEGRADED over
+    //! NOT_AVAILABLE over FULL. Sources drop samples with an ERROR.
+    byte figureOfMerit;
+    //! The worse Compensation of the two angles: OFF over NOT_AVAILABLE over
+    //! ON. Sources drop samples with an ERROR.
+    byte compensation;
+    //! Time from measurement to transmission (microseconds), 0 if unknown
+    unsigned int latency;
+} SampleQuality;
+
+/**
+ * @brief One filtered measurement from a data source
+ */
+typedef struct {
+    //! Pitch and roll, in radians
+    Rotation::Vec2 angles;
+    //! micros() at which the measurement was taken or received
+    unsigned long timestamp;
+    //! Quality of the newest measurement that went into the angles
+    SampleQuality quality;
+} Sample;
+
+/**
+ * @brief Angular rates measured by a data source's gyroscope
+ */
+typedef struct {
+    //! Rates about the sensor's X, Y and Z axes, in radians per second. X and
+    //! Y match the axes of Sample::angles.
+    Rotation::Vec3 rates;
+    //! micros() at which the rates were received
+    unsigned long timestamp;
+} RateSample;
+
 /**
  * @brief Interface for reading from an inclinometer
+ *
+ * Implementations are final, so a Module made for one calls it directly.
  */
 class InclinometerDataSource {
   public:
@@ -29,7 +85,7 @@ class InclinometerDataSource {
      * @return true if the inclinometer successfully initializes
      * @return false if the inclinometer failed to initialize
      */
-    virtual bool begin();
+    virtual bool begin() = 0;
 
     /**
      * @brief Checks if the inclinometer has new data available
@@ -37,14 +93,53 @@ class InclinometerDataSource {
      * @return true if there is data available
      * @return false if there is not data available
      */
-    virtual bool hasData();
+    virtual bool hasData() = 0;
 
     /**
      * @brief Get the 2D vector of euler angles in radians (pitch, roll)
      *
-     * @return Eigen::Vector2d Pitch and Roll, in radians
+     * @return Rotation::Vec2 Pitch and Roll, in radians
+     */
+    virtual Rotation::Vec2 getData() = 0;
+
+    /**
+     * @brief Get the time the sample returned by the last getData() call was
+     * measured or received
+     *
+     * @return unsigned long micros() timestamp of the sample
+     */
+    virtual unsigned long getTimestamp() = 0;
+
+    /**
+     * @brief Get the time between samples at the inclinometer's current
+     * output data rate
+     *
+     * @return unsigned long nominal sample period (microseconds)
+     */
+    virtual unsigned long getSamplePeriod() = 0;
+
+    /**
+     * @brief Collects new data (like hasData()) and reads out every sample
+     * that arrived since the last call, oldest first
+     *
+     * Every sample has already been through the source's filters, in the
+     * order it arrived. If more samples are pending than fit, the oldest ones
+     * are skipped, so the last one returned is always the newest.
+     *
+     * @param samples array to fill
+     * @param capacity number of samples that fit in the array
+     * @return byte number of samples read (0 if there is no new data)
+     */
+    virtual byte readAll(Sample *samples, byte capacity) = 0;
+
+    /**
+     * @brief Get the newest angular rates, for sources that measure them
+     *
+     * @param rates overwritten with the rates, if there are any
+     * @return true if the source has measured rates
+     * @return false if the source doesn't measure rates, or none arrived yet
      */
-    virtual Eigen::Vector2d getData();
+    virtual bool getRates(RateSample &rates) = 0;
 };
 } // namespace Inclinometer
 
@@ -12,65 +12,113 @@
 #ifndef INCLINOMETER_MODEL_H
 #define INCLINOMETER_MODEL_H
 
-#include "MovingAverage.h"
-
-#include <stlport.h>
-
-#include <Eigen30.h>
-
-#include <Eigen/Core>
-#include <Eigen/Geometry>
-
-using namespace Eigen;
+#include "Filters.h"
+#include "Rotation.h"
 
 namespace Inclinometer {
 
 /**
- * @brief The flattened version of a eigen matrix3d, which represents a
- * rotation. This "frame" can be stored to represent the zero pose of an
- * inclinometer.
+ * @brief The zero pose of an inclinometer, as the unit quaternion of the
+ * frame it measured when it was zeroed. This is what gets stored.
+ *
+ * Floats are as precise as the AVR's doubles, and four of them take 16 bytes
+ * where the 3x3 matrix this replaces took 36. A quaternion that isn't close
+ * to unit length (e.g. storage that was never written) is no zero pose at
+ * all, see isValidZero().
  *
  * This model uses Roll-Pitch-Yaw euler rotations (Left-To-Right), or
  * Yaw-Pitch-Roll (Right-to-Left)
  */
 typedef struct {
-    double m00;
-    double m01;
-    double m02;
-    double m10;
-    double m11;
-    double m12;
-    double m20;
-    double m21;
-    double m22;
+    float w;
+    float x;
+    float y;
+    float z;
 } ModelZeropoint;
 
+//! Furthest a stored zero pose's squared norm may be from 1 for it to be
+//! used. Rounding to floats is far below this, garbage is far above.
+constexpr double k_zeroNormTolerance = 1e-3;
+
+/**
+ * @brief Checks a stored zero pose is a rotation
+ *
+ * @param zero the zero pose
+ * @return true if it is close enough to unit length to be used
+ * @return false if it isn't, or holds NaN
+ */
+bool isValidZero(const ModelZeropoint &zero);
+
+/**
+ * @brief Get the rotation a zero pose stands for
+ *
+ * @param zero the zero pose, which should be valid
+ * @return Rotation::Rot3 the frame measured when it was zeroed
+ */
+Rotation::Rot3 zeroToFrame(const ModelZeropoint &zero);
+
+/**
+ * @brief Makes a zero pose from a rotation
+ *
+ * @param frame a rotation matrix
+ * @return ModelZeropoint the zero pose, rounded to floats
+ */
+ModelZeropoint frameToZero(const Rotation::Rot3 &frame);
+
 /**
  * @brief The Inclinometer Model
  *
  * This model allows a pitch-roll inclinometer to have a yaw offset and a
  * programmable zero pose.
+ *
+ * It is defined here in full, so calculate() can be inlined into the
+ * Module that runs it. On the AVR float and double are the same type, on a
+ * host float halves the size of the state.
+ *
+ * @tparam Scalar the number type the model computes in, float or double.
+ * The trig functions it relies on have no fixed point version.
  */
-class Model {
+template <typename Scalar = double> class Model {
   public:
+    typedef Rotation::Vec2T<Scalar> Vec2;
+    typedef Rotation::Vec3T<Scalar> Vec3;
+    typedef Rotation::Rot3T<Scalar> Rot3;
+    typedef Rotation::QuatT<Scalar> Quat;
+
+    //! Largest angle, in and out, the small angle mode handles (radians,
+    //! 15 degrees). Anything past it takes the exact path.
+    static constexpr double k_smallAngleLimit = 0.2618;
+
+    //! Largest difference between the small angle mode and the exact path
+    //! within the limit (radians), as measured by extras/host/modelbench
+    static constexpr double k_smallAngleMaxError = 1e-6;
+
     /**
      * @brief Construct a new Model object
      */
     Model()
-        : baseFrame(AngleAxisd(0, Vector3d::UnitX()) *
-                    AngleAxisd(0, Vector3d::UnitY()) *
-                    AngleAxisd(0, Vector3d::UnitZ())),
-          zeroFrame(AngleAxisd(0, Vector3d::UnitX()) *
-                    AngleAxisd(0, Vector3d::UnitY()) *
-                    AngleAxisd(0, Vector3d::UnitZ())),
-          rollVelocity(0, 0.1), pitchVelocity(0, 0.1){};
+        : baseFrame(Rot3::identity()), zeroPose(Quat::identity()),
+          correction(Rot3::identity()), smallAngle(false), lastAngles(0, 0),
+          rollVelocity(0.1), pitchVelocity(0.1){};
 
     /**
      * @brief Imports a ModelZeropoint and updates the model
      *
+     * The quaternion is renormalized, so rounding in storage doesn't scale
+     * the angles. An invalid one leaves the model unzeroed (the identity).
+     *
      * @param data the zero point to import
      */
-    void importZero(ModelZeropoint data);
+    void importZero(ModelZeropoint data)
+    {
+        if (isValidZero(data)) {
+            zeroPose = Quat(data.w, data.x, data.y, data.z).normalized();
+        }
+        else {
+            zeroPose = Quat::identity();
+        }
+        updateCorrection();
+    };
 
     /**
      * @brief Zeroes the model based on the passed in measurement, and returns
@@ -79,7 +127,20 @@ class Model {
      * @param angleMeasures angle measures (inclinometer pitch/roll)
      * @return ModelZeropoint
      */
-    ModelZeropoint setMeasurementAsZero(Vector2d angleMeasures);
+    ModelZeropoint setMeasurementAsZero(Vec2 angleMeasures)
+    {
+        Quat measured =
+            Quat::aboutX(angleMeasures[0]) * Quat::aboutY(angleMeasures[1]);
+        ModelZeropoint pt;
+        pt.w = measured.w;
+        pt.x = measured.x;
+        pt.y = measured.y;
+        pt.z = measured.z;
+        // The model uses the rounded pose, the same one it gets back from
+        // storage
+        importZero(pt);
+        return pt;
+    };
 
     /**
      * @brief Set the base frame (static rotation offsets) from three euler
@@ -87,35 +148,142 @@ class Model {
      *
      * @param angles roll, pitch, yaw
      */
-    void setBaseFrameAnglesRadians(Vector3d angles);
+    void setBaseFrameAnglesRadians(Vec3 angles)
+    {
+        baseFrame = Rot3::fromRPY(angles);
+        updateCorrection();
+    };
 
     /**
      * @brief Apply zero and base frame to get new coordinates.
      *
      * @param angleMeasures input (measured) angles (roll, pitch)
-     * @return Vector2d output (calculated) angles (roll, pitch)
+     * @return Vec2 output (calculated) angles (roll, pitch)
+     */
+    Vec2 calculate(Vec2 angleMeasures)
+    {
+        Vec2 calculated;
+        if (!smallAngle || !calculateSmallAngle(angleMeasures, calculated)) {
+            calculated = calculateExact(angleMeasures);
+        }
+
+        rollVelocity.add(calculated[0] - lastAngles[0]);
+        pitchVelocity.add(calculated[1] - lastAngles[1]);
+        lastAngles = calculated;
+        return calculated;
+    };
+
+    /**
+     * @brief Switches calculate() to series approximations of its trig
+     * functions, for inputs and outputs within k_smallAngleLimit
+     *
+     * @param enabled true to use the small angle mode
      */
-    Vector2d calculate(Vector2d angleMeasures);
+    void setSmallAngle(bool enabled) { smallAngle = enabled; };
 
     /**
      * @brief Returns the cumulative exponentially-weighted moving average of
      * the displacements of previous calculations
      *
-     * @return Vector2d roll, pitch
+     * @return Vec2 roll, pitch
      */
-    Vector2d getAngularAveragedVelocities();
+    Vec2 getAngularAveragedVelocities()
+    {
+        return Vec2(rollVelocity.get(), pitchVelocity.get());
+    };
+
+    /**
+     * @brief Rotates angular rates measured in the sensor's frame into the
+     * frame of calculate()'s output
+     *
+     * @param sensorRates rates about the sensor's X, Y and Z axes
+     * @return Vec2 roll and pitch rates, in the same unit as the input
+     */
+    Vec2 rotateRates(Vec3 sensorRates)
+    {
+        // For the small tilts the platform sees, the euler angle rates are
+        // the body rates rotated into the output frame, in the order
+        // calculate() puts the angles in
+        Vec3 rates = correction * sensorRates;
+        return Vec2(rates[1], rates[0]);
+    };
 
   private:
-    Matrix3d baseFrame;
-    Matrix3d zeroFrame;
+    Rot3 baseFrame;
+    //! Unit quaternion of the zero frame
+    Quat zeroPose;
+    //! baseFrame * zeroFrame^T, kept up to date with both
+    Rot3 correction;
+    bool smallAngle;
+
+    Vec2 lastAngles;
+
+    Filter::Ewma<Scalar> pitchVelocity;
+    Filter::Ewma<Scalar> rollVelocity;
 
-    Vector2d lastAngles;
+    void updateCorrection()
+    {
+        // The conjugate of a unit quaternion is its inverse, i.e. the
+        // transpose of the zero frame
+        correction = baseFrame * zeroPose.conjugate().toRotation();
+    };
 
-    ::MovingAverage pitchVelocity;
-    ::MovingAverage rollVelocity;
+    Vec2 calculateExact(const Vec2 &angleMeasures)
+    {
+        // The output is the roll and pitch of correction * measuredFrame
+        // (Rot3::toRPY()). They only depend on that product's last column,
+        // which is correction times the measured frame's last column, so
+        // the rest of both products is never needed.
+        Scalar cosY = cos(angleMeasures[1]);
+        Vec3 up = correction * Vec3(sin(angleMeasures[1]),
+                                    -sin(angleMeasures[0]) * cosY,
+                                    cos(angleMeasures[0]) * cosY);
 
-    Matrix3d convertAnglesToFrame(Vector2d angleMeasures);
+        // Closed form of the X and Y euler angles of that column
+        Scalar x = atan2(-up[1], up[2]);
+        Scalar y = atan2(up[0], sqrt(up[1] * up[1] + up[2] * up[2]));
+        return Vec2(y, x);
+    };
+
+    bool calculateSmallAngle(const Vec2 &angleMeasures, Vec2 &result)
+    {
+        Scalar a = angleMeasures[0];
+        Scalar b = angleMeasures[1];
+        if (fabs(a) > k_smallAngleLimit || fabs(b) > k_smallAngleLimit) {
+            return false;
+        }
+
+        // Same as calculateExact(), with each trig function replaced by the
+        // first terms of its series, which is all the accuracy these angles
+        // need
+        Scalar a2 = a * a;
+        Scalar b2 = b * b;
+        Scalar sinA = a * (1 - a2 / 6 * (1 - a2 / 20));
+        Scalar cosA = 1 - a2 / 2 * (1 - a2 / 12);
+        Scalar sinB = b * (1 - b2 / 6 * (1 - b2 / 20));
+        Scalar cosB = 1 - b2 / 2 * (1 - b2 / 12);
+        Vec3 up = correction * Vec3(sinB, -sinA * cosB, cosA * cosB);
+
+        // x = atan(t), and since up is a unit vector, y = asin(s)
+        Scalar t = -up[1] / up[2];
+        Scalar s = up[0];
+        if (fabs(t) > k_smallAngleLimit || fabs(s) > k_smallAngleLimit) {
+            return false;
+        }
+        Scalar t2 = t * t;
+        Scalar s2 = s * s;
+        Scalar x = t * (1 - t2 * (Scalar(1.0 / 3) -
+                                  t2 * (Scalar(1.0 / 5) - t2 / 7)));
+        Scalar y = s * (1 + s2 * (Scalar(1.0 / 6) +
+                                  s2 * (Scalar(3.0 / 40) +
+                                        s2 * Scalar(5.0 / 112))));
+        result = Vec2(y, x);
+        return true;
+    };
 };
+
+template <typename Scalar> constexpr double Model<Scalar>::k_smallAngleLimit;
+template <typename Scalar> constexpr double Model<Scalar>::k_smallAngleMaxError;
 }; // namespace Inclinometer
 
-#endif
+#endif
\ No newline at end of file
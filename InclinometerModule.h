@@ -15,24 +15,22 @@
 
 #include "InclinometerInterface.h"
 #include "InclinometerModel.h"
+#include "TiltEstimator.h"
 
 namespace Inclinometer {
 
 /**
- * @brief Holds a model and a data source
+ * @brief Interface to a Module of any source and scalar type, for code that
+ * is compiled on its own and takes whichever module it is given (like the
+ * MotionController)
+ *
+ * Everything a module does per sample happens inside update(), so going
+ * through this costs one virtual call per batch, not one per sample.
  */
-class Module {
+class ModuleBase {
   public:
-    /**
-     * @brief Construct a new Module object
-     *
-     * @param src the sensor data source
-     * @param yaw the starting yaw offset, default 0
-     */
-    Module(InclinometerDataSource *src, double yaw = 0.0) : sensor(src)
-    {
-        model.setBaseFrameAnglesRadians(Vector3d(0, 0, yaw));
-    };
+    //! Largest number of samples taken from the sensor per update()
+    static constexpr byte k_batchSize = 8;
 
     /**
      * @brief Initializes the contained sensor/data source
@@ -40,7 +38,7 @@ class Module {
      * @return true if the sensor successfully initialized
      * @return false if the sensor did not successfully initialize
      */
-    bool begin() { return sensor->begin(); };
+    virtual bool begin() = 0;
 
     /**
      * @brief Checks if the sensor has data
@@ -48,14 +46,78 @@ class Module {
      * @return true if the sensor has data that can be read
      * @return false if the sensor does not have data that can be read
      */
-    bool hasData() { return sensor->hasData(); };
+    virtual bool hasData() = 0;
 
     /**
      * @brief Get the calculated angle measures if data is available
      *
-     * @return Eigen::Vector2d roll, pitch
+     * @return Rotation::Vec2 roll, pitch
+     */
+    virtual Rotation::Vec2 getData() = 0;
+
+    /**
+     * @brief Runs every sample that is waiting in the sensor through the
+     * model, oldest first, so the model sees each one
+     *
+     * @return byte number of samples processed (0 if there was no new data)
+     */
+    virtual byte update() = 0;
+
+    /**
+     * @brief Get the calculated angle measures of the newest sample processed
+     * by update() or getData()
+     *
+     * @return Rotation::Vec2 roll, pitch
+     */
+    virtual Rotation::Vec2 getLatest() = 0;
+
+    /**
+     * @brief Get the time the newest sample processed by update() or
+     * getData() was received
+     *
+     * @return unsigned long micros() timestamp of the sample
+     */
+    virtual unsigned long getTimestamp() = 0;
+
+    /**
+     * @brief Get the time between samples at the sensor's current output data
+     * rate
+     *
+     * @return unsigned long nominal sample period (microseconds)
+     */
+    virtual unsigned long getSamplePeriod() = 0;
+
+    /**
+     * @brief Get the rates measured by the sensor's gyroscope, rotated into
+     * the frame of the calculated angles
+     *
+     * @param rates overwritten with the roll and pitch rates (radians per
+     * second)
+     * @param receivedMicros overwritten with the micros() at which the rates
+     * were received
+     * @return true if the sensor measures rates and has sent some
+     * @return false if there are no measured rates, use
+     * getAngularAveragedVelocities() instead
+     */
+    virtual bool getMeasuredRates(Rotation::Vec2 &rates,
+                                  unsigned long &receivedMicros) = 0;
+
+    /**
+     * @brief Get the model's moving average of the change between
+     * calculations
+     *
+     * @return Rotation::Vec2 roll, pitch (radians per sample)
+     */
+    virtual Rotation::Vec2 getAngularAveragedVelocities() = 0;
+
+    /**
+     * @brief Get the estimator's angles, rates and their variances
+     *
+     * @param estimate overwritten with the estimate, if there is one
+     * @return true if there is an estimator and it has an estimate
+     * @return false if there isn't (getLatest() is the model's output)
      */
-    Eigen::Vector2d getData() { return model.calculate(sensor->getData()); };
+    virtual bool getEstimate(TiltEstimate &estimate) = 0;
 
     /**
      * @brief zero the sensor and return the zero frame from the current
@@ -63,28 +125,164 @@ class Module {
      *
      * @return ModelZeropoint
      */
-    ModelZeropoint zero()
-    {
-        return model.setMeasurementAsZero(sensor->getData());
-    };
+    virtual ModelZeropoint zero() = 0;
 
     /**
      * @brief import a zero frame and zero the sensor to it
      *
      * @param zero the zero frame to zero the sensor to
      */
-    void importZero(ModelZeropoint zero) { return model.importZero(zero); };
+    virtual void importZero(ModelZeropoint zero) = 0;
+};
+
+/**
+ * @brief Holds a model and a data source
+ *
+ * Calls to the source and the model are resolved at compile time, so with
+ * a concrete (final) Source the sample to model path has no virtual calls
+ * left. Module<InclinometerDataSource> takes any source at run time.
+ *
+ * @tparam Source the data source type
+ * @tparam Scalar the number type of the model, see Model
+ */
+template <typename Source, typename Scalar = double>
+class Module final : public ModuleBase {
+  public:
+    typedef Inclinometer::Model<Scalar> ModelType;
+
+    /**
+     * @brief Construct a new Module object
+     *
+     * @param src the sensor data source
+     * @param yaw the starting yaw offset, default 0
+     * @param estimator the estimator to run the model's angles through, or
+     * NULL (default) to pass them on as they are
+     */
+    Module(Source *src, double yaw = 0.0, TiltEstimator *estimator = NULL)
+        : sensor(src), estimator(estimator), latest(0, 0), timestamp(0),
+          rateTimestamp(0)
+    {
+        model.setBaseFrameAnglesRadians(typename ModelType::Vec3(0, 0, yaw));
+    };
+
+    bool begin() override { return sensor->begin(); };
+
+    bool hasData() override { return sensor->hasData(); };
+
+    Rotation::Vec2 getData() override
+    {
+        latest = model.calculate(sensor->getData().template cast<Scalar>())
+                     .template cast<double>();
+        timestamp = sensor->getTimestamp();
+        estimate();
+        return latest;
+    };
+
+    byte update() override
+    {
+        Sample batch[k_batchSize];
+        byte count = sensor->readAll(batch, k_batchSize);
+        for (byte i = 0; i < count; i++) {
+            latest = model.calculate(batch[i].angles.template cast<Scalar>())
+                         .template cast<double>();
+            timestamp = batch[i].timestamp;
+            estimate();
+        }
+        return count;
+    };
+
+    Rotation::Vec2 getLatest() override { return latest; };
+
+    unsigned long getTimestamp() override { return timestamp; };
+
+    unsigned long getSamplePeriod() override
+    {
+        return sensor->getSamplePeriod();
+    };
+
+    bool getMeasuredRates(Rotation::Vec2 &rates,
+                          unsigned long &receivedMicros) override
+    {
+        RateSample sample;
+        if (!sensor->getRates(sample)) {
+            return false;
+        }
+        rates = rotateRates(sample.rates);
+        receivedMicros = sample.timestamp;
+        return true;
+    };
+
+    Rotation::Vec2 getAngularAveragedVelocities() override
+    {
+        return model.getAngularAveragedVelocities().template cast<double>();
+    };
+
+    bool getEstimate(TiltEstimate &estimate) override
+    {
+        return estimator != NULL && estimator->getEstimate(estimate);
+    };
+
+    ModelZeropoint zero() override
+    {
+        resetEstimator();
+        return model.setMeasurementAsZero(
+            sensor->getData().template cast<Scalar>());
+    };
+
+    void importZero(ModelZeropoint zero) override
+    {
+        resetEstimator();
+        model.importZero(zero);
+    };
 
     /**
      * @brief Get the model contained in the module
      *
-     * @return Model
+     * @return ModelType
      */
-    Model &getModel() { return model; };
+    ModelType &getModel() { return model; };
 
   private:
-    InclinometerDataSource *sensor;
-    Model model;
+    Source *sensor;
+    TiltEstimator *estimator;
+    ModelType model;
+    Rotation::Vec2 latest;
+    unsigned long timestamp;
+    unsigned long rateTimestamp;
+
+    Rotation::Vec2 rotateRates(const Rotation::Vec3 &rates)
+    {
+        return model.rotateRates(rates.template cast<Scalar>())
+            .template cast<double>();
+    };
+
+    /**
+     * @brief Runs the newest angles, and any new measured rates, through the
+     * estimator, and replaces the angles with its estimate
+     */
+    void estimate()
+    {
+        if (estimator == NULL) {
+            return;
+        }
+        estimator->addAngles(latest, timestamp);
+        RateSample rates;
+        if (sensor->getRates(rates) && rates.timestamp != rateTimestamp) {
+            estimator->addRates(rotateRates(rates.rates), rates.timestamp);
+            rateTimestamp = rates.timestamp;
+        }
+        TiltEstimate estimate;
+        if (estimator->getEstimate(estimate)) {
+            latest = estimate.angles;
+        }
+    };
+
+    void resetEstimator()
+    {
+        if (estimator != NULL) {
+            estimator->reset();
+        }
+    };
 };
 }; // namespace Inclinometer
 
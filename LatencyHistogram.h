@@ -0,0 +1,160 @@
+/**
+ * @file LatencyHistogram.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Fixed-size latency histogram with min/avg/max/percentile reporting
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef LATENCY_HISTOGRAM_GUARD_H
+#define LATENCY_HISTOGRAM_GUARD_H
+
+#include <Arduino.h>
+
+/**
+ * @brief helper class for collecting latency statistics
+ *
+ * Latencies are counted in equally sized buckets. The last bucket also
+ * collects everything longer than the histogram covers, so percentiles that
+ * land in it are reported as the maximum. When a bucket fills up, all of them
+ * are halved, so percentiles keep following the proportions of a long run
+ * (with more weight on recent samples) while count and average cover every
+ * sample.
+ */
+class LatencyHistogram {
+  public:
+    //! Number of buckets in the histogram
+    static constexpr byte k_bucketCount = 32;
+
+    /**
+     * @brief Construct a new Latency Histogram object
+     *
+     * @param bucketMicros width of each bucket in microseconds
+     */
+    LatencyHistogram(unsigned long bucketMicros = 500)
+        : bucketWidth(bucketMicros)
+    {
+        reset();
+    };
+
+    /**
+     * @brief Clears all collected samples
+     */
+    void reset()
+    {
+        for (byte i = 0; i < k_bucketCount; i++) {
+            buckets[i] = 0;
+        }
+        count = 0;
+        sum = 0;
+        min = 0xFFFFFFFF;
+        max = 0;
+    };
+
+    /**
+     * @brief Adds a latency sample
+     * @param micros the latency in microseconds
+     */
+    void add(unsigned long micros)
+    {
+        unsigned long bucket = micros / bucketWidth;
+        if (bucket >= k_bucketCount) {
+            bucket = k_bucketCount - 1;
+        }
+        // Halve every bucket instead of wrapping or saturating just this
+        // one, which would skew the percentiles. Rounding up keeps single
+        // outliers in the tail.
+        if (buckets[bucket] >= 0xFFFF) {
+            for (byte i = 0; i < k_bucketCount; i++) {
+                buckets[i] = buckets[i] / 2 + (buckets[i] & 1);
+            }
+        }
+        buckets[bucket]++;
+        count++;
+        sum += micros;
+        min = (micros < min) ? micros : min;
+        max = (micros > max) ? micros : max;
+    };
+
+    /**
+     * @brief Get the number of samples collected
+     * @return unsigned long sample count
+     */
+    unsigned long getCount() { return count; };
+
+    /**
+     * @brief Get the shortest latency
+     * @return unsigned long microseconds (0 if there are no samples)
+     */
+    unsigned long getMin() { return count ? min : 0; };
+
+    /**
+     * @brief Get the longest latency
+     * @return unsigned long microseconds
+     */
+    unsigned long getMax() { return max; };
+
+    /**
+     * @brief Get the mean latency
+     * @return unsigned long microseconds (0 if there are no samples)
+     */
+    unsigned long getAverage() { return count ? sum / count : 0; };
+
+    /**
+     * @brief Get a percentile of the latency, to the resolution of a bucket
+     *
+     * @param percent the percentile, e.g. 99
+     * @return unsigned long upper edge of the bucket holding the percentile,
+     * in microseconds
+     */
+    unsigned long getPercentile(byte percent)
+    {
+        unsigned long total = 0;
+        for (byte i = 0; i < k_bucketCount; i++) {
+            total += buckets[i];
+        }
+        unsigned long target = (total * percent + 99) / 100;
+        unsigned long seen = 0;
+        for (byte i = 0; i < k_bucketCount - 1; i++) {
+            seen += buckets[i];
+            if (seen >= target) {
+                unsigned long edge = (i + 1) * bucketWidth;
+                return (edge < max) ? edge : max;
+            }
+        }
+        return max;
+    };
+
+    /**
+     * @brief Serial logs a one-line summary
+     * @param name label for the line
+     */
+    void print(const char *name)
+    {
+        Serial.print(name);
+        Serial.print(": n=");
+        Serial.print(getCount());
+        Serial.print(" min=");
+        Serial.print(getMin());
+        Serial.print(" avg=");
+        Serial.print(getAverage());
+        Serial.print(" max=");
+        Serial.print(getMax());
+        Serial.print(" p99=");
+        Serial.print(getPercentile(99));
+        Serial.println(" us");
+    };
+
+  private:
+    unsigned long bucketWidth;
+    unsigned int buckets[k_bucketCount];
+    unsigned long count;
+    unsigned long long sum;
+    unsigned long min;
+    unsigned long max;
+};
+
+#endif
@@ -6,11 +6,10 @@
 
 #include <Arduino.h>
 
-Motion::MotionController::MotionController(Inclinometer::Module &sensor)
+Motion::MotionController::MotionController(Inclinometer::ModuleBase &sensor)
     : m_sensor(sensor), m_stateMachine(MotionStateMachine(this)),
-      m_cornerAlgo(Constants::Algorithm::k_stopCorrectingTiltAtDegrees / 180.0 *
-                       PI,
-                   Constants::Algorithm::k_correctTiltAtDegrees / 180.0 * PI)
+      m_cornerAlgo(Constants::Algorithm::k_stopCorrectingTiltAt,
+                   Constants::Algorithm::k_correctTiltAt)
 {
 }
 
@@ -76,7 +75,10 @@ void Motion::MotionController::RequestClearFaultState()
 
 void Motion::MotionController::Step()
 {
-    if (m_sensor.hasData()) {
+    unsigned long ingestMicros = micros();
+
+    // Every pending sample goes through the model, the newest one is used
+    if (m_sensor.update() > 0) {
 
         // If the inclinometer has data ready, then we can safely unlatch &
         // reset the no data ready fault
@@ -84,23 +86,62 @@ void Motion::MotionController::Step()
             Fault::FaultUnlatchEvent::INCLINOMETER_DATA_RECEIVE);
         m_lastSensorReadingTimestamp = millis();
 
-        // Calculate the angles from the data using the mathematical model
-        m_lastSensorMeasures = m_sensor.getData();
+        m_lastSensorMeasures = m_sensor.getLatest();
+
+        // The model works in floating point radians. Everything after it
+        // uses fixed point, so convert once here.
+        m_lastRoll = Angle::fromRadians(m_lastSensorMeasures[0]);
+        m_lastPitch = Angle::fromRadians(m_lastSensorMeasures[1]);
+
+        unsigned long sampleTimestamp = m_sensor.getTimestamp();
+        m_modelLatency.add(micros() - sampleTimestamp);
+        m_ingestLatency.add(ingestMicros - sampleTimestamp);
+        if (m_lastSampleTimestamp != 0) {
+            m_samplePeriod.add(sampleTimestamp - m_lastSampleTimestamp);
+        }
+        m_lastSampleTimestamp = sampleTimestamp;
+        m_sampleLatencyPending = true;
 
         double senseRollRate =
-            m_sensor.getModel().getAngularAveragedVelocities()[0] * 18000.0 /
-            PI;
+            m_sensor.getAngularAveragedVelocities()[0] * 18000.0 / PI;
         double sensePitchRate =
-            m_sensor.getModel().getAngularAveragedVelocities()[1] * 18000.0 /
-            PI;
-
-        if (senseRollRate >= 0.1 || sensePitchRate >= 0.1) {
+            m_sensor.getAngularAveragedVelocities()[1] * 18000.0 / PI;
+
+        constexpr double limit =
+            Constants::Algorithm::k_unstableRateDegreesPerSecond * PI / 180.0;
+        Inclinometer::TiltEstimate estimate;
+        Rotation::Vec2 measuredRates;
+        unsigned long rateTimestamp;
+        if (m_sensor.getEstimate(estimate)) {
+            // The estimator's rates are not lagged (and include the gyro's,
+            // if it sends them), and it says how sure it is of the angles
+            constexpr double deviation =
+                Constants::Algorithm::k_maximumEstimateDeviationDegrees * PI /
+                180.0;
+            if (fabs(estimate.rates[0]) >= limit ||
+                fabs(estimate.rates[1]) >= limit ||
+                estimate.angleVariance[0] > deviation * deviation ||
+                estimate.angleVariance[1] > deviation * deviation) {
+                m_lastSensorReadingUnstable = millis();
+            }
+        }
+        else if (Constants::Algorithm::k_useMeasuredRates &&
+                 m_sensor.getMeasuredRates(measuredRates, rateTimestamp) &&
+                 micros() - rateTimestamp <
+                     Constants::Algorithm::k_measuredRateMaxAge) {
+            // The gyro rates are noisy but not lagged, so use their magnitude
+            if (fabs(measuredRates[0]) >= limit ||
+                fabs(measuredRates[1]) >= limit) {
+                m_lastSensorReadingUnstable = millis();
+            }
+        }
+        else if (senseRollRate >= 0.1 || sensePitchRate >= 0.1) {
             m_lastSensorReadingUnstable = millis();
         }
 
-        Serial.print(m_lastSensorMeasures[0] * 180.0 / PI);
+        Angle::printDegrees(Serial, m_lastRoll);
         Serial.print("\t");
-        Serial.print(m_lastSensorMeasures[1] * 180.0 / PI);
+        Angle::printDegrees(Serial, m_lastPitch);
         Serial.print("\t");
         Serial.print(senseRollRate);
         Serial.print("\t");
@@ -108,18 +149,16 @@ void Motion::MotionController::Step()
         Serial.print("\n");
     }
 
-    if (millis() - m_lastSensorReadingTimestamp > 500) {
+    if (millis() - m_lastSensorReadingTimestamp >
+        SensorWindowMillis(
+            Constants::Algorithm::k_sensorUnreadySamplePeriods)) {
         Fault::Handler::instance()->setFaultCode(Fault::INCLINOMETER_UNREADY);
     }
 
-    if (m_lastSensorMeasures[0] >
-            Constants::Algorithm::k_maximumAllowableTiltRange ||
-        m_lastSensorMeasures[0] <
-            -Constants::Algorithm::k_maximumAllowableTiltRange ||
-        m_lastSensorMeasures[1] >
-            Constants::Algorithm::k_maximumAllowableTiltRange ||
-        m_lastSensorMeasures[1] <
-            -Constants::Algorithm::k_maximumAllowableTiltRange) {
+    constexpr Angle::MicroDegrees tiltLimit =
+        Constants::Algorithm::k_maximumAllowableTiltRange;
+    if (!Angle::withinRange(m_lastRoll, tiltLimit) ||
+        !Angle::withinRange(m_lastPitch, tiltLimit)) {
         Fault::Handler::instance()->setFaultCode(Fault::TOO_MUCH_TILT);
     }
 
@@ -181,7 +220,7 @@ void Motion::MotionController::SetCorners(bool corner1, bool corner2,
 
 void Motion::MotionController::MovementAlgorithmStep()
 {
-    m_cornerAlgo.update(m_lastSensorMeasures[0], m_lastSensorMeasures[1]);
+    m_cornerAlgo.update(m_lastRoll, m_lastPitch);
     bool lowering = m_direction == LOWER;
 
     // Control the solenoids, if no faults and in raise or lower mode
@@ -191,6 +230,47 @@ void Motion::MotionController::MovementAlgorithmStep()
                !m_cornerAlgo.getCorner(1, lowering),
                !m_cornerAlgo.getCorner(2, lowering),
                !m_cornerAlgo.getCorner(3, lowering), !lowering);
+
+    // Only the first actuation on a sample counts, later ones reuse it
+    if (m_sampleLatencyPending) {
+        m_sampleLatencyPending = false;
+        m_valveLatency.add(micros() - m_lastSampleTimestamp);
+    }
+}
+
+void Motion::MotionController::PrintLatencyReport(bool reset)
+{
+    m_samplePeriod.print("Sample period");
+    m_ingestLatency.print("Frame -> loop");
+    m_modelLatency.print("Frame -> model");
+    m_valveLatency.print("Frame -> valves");
+
+    // Filter lag does not show up in the timestamps, since it delays the
+    // signal rather than the sample. An EWMA lags by (1 - a) / a samples.
+    // The estimator doesn't lag a steady rate, so report its certainty.
+    Inclinometer::TiltEstimate estimate;
+    if (m_sensor.getEstimate(estimate)) {
+        Serial.print("Estimate deviation: ");
+        Serial.print(sqrt(estimate.angleVariance[0]) * 180.0 / PI, 4);
+        Serial.print(" / ");
+        Serial.print(sqrt(estimate.angleVariance[1]) * 180.0 / PI, 4);
+        Serial.println(" deg");
+    }
+    else {
+        const double alpha =
+            Constants::Algorithm::k_inclinometerEWMASmoothingAlpha;
+        Serial.print("EWMA lag estimate: ");
+        Serial.print((1.0 - alpha) / alpha * m_samplePeriod.getAverage() /
+                     1000.0);
+        Serial.println(" ms");
+    }
+
+    if (reset) {
+        m_samplePeriod.reset();
+        m_ingestLatency.reset();
+        m_modelLatency.reset();
+        m_valveLatency.reset();
+    }
 }
 
 void Motion::MotionController::PopMessage(char *line2)
@@ -209,8 +289,8 @@ void Motion::MotionController::DispUpdate()
     if (millis() - m_lastDispUpdate > k_dispUpdatePeriodMillis) {
         Display::SystemDisplayState dstate;
         dstate.motionState = GetState();
-        dstate.pitch = m_sensor.getData()[1] * 180.0 / PI;
-        dstate.roll = m_sensor.getData()[0] * 180.0 / PI;
+        dstate.pitch = Angle::toDegrees(m_lastPitch);
+        dstate.roll = Angle::toDegrees(m_lastRoll);
         dstate.ram1 = m_cornerAlgo.getCorner(
             static_cast<unsigned int>(CORNER_REMAPPER_LOGICAL::RAM_1),
             m_direction == LOWER);
@@ -239,5 +319,18 @@ void Motion::MotionController::DispUpdate()
 
 bool Motion::MotionController::CheckStabilityStep()
 {
-    return (millis() - m_lastSensorReadingUnstable > 1000);
+    return (millis() - m_lastSensorReadingUnstable >
+            SensorWindowMillis(
+                Constants::Algorithm::k_stabilitySamplePeriods));
+}
+
+unsigned long Motion::MotionController::SensorWindowMillis(
+    unsigned long samplePeriods)
+{
+    // Follows the sensor's output data rate, which can change at runtime
+    unsigned long window = samplePeriods * m_sensor.getSamplePeriod() / 1000;
+    if (window < Constants::Algorithm::k_minimumSensorWindowMillis) {
+        return Constants::Algorithm::k_minimumSensorWindowMillis;
+    }
+    return window;
 }
\ No newline at end of file
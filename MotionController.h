@@ -17,15 +17,11 @@
 #include "DisplayControl.h"
 #include "HighestCornerAlgorithm.h"
 #include "InclinometerModule.h"
+#include "LatencyHistogram.h"
 #include "MotionStateMachine.h"
-
-#include <stlport.h>
-
-#include <Eigen30.h>
+#include "Rotation.h"
 
 #include <Controllino.h>
-#include <Eigen/Core>
-#include <Eigen/Geometry>
 
 namespace {
 constexpr int k_dispUpdatePeriodMillis = 1000;
@@ -63,7 +59,7 @@ enum class CORNER_REMAPPER_LOGICAL {
 namespace Motion {
 class MotionController {
   public:
-    MotionController(Inclinometer::Module &sensor);
+    MotionController(Inclinometer::ModuleBase &sensor);
 
     /**
      * @brief Set up the motion controller
@@ -93,7 +89,7 @@ class MotionController {
      */
     void RequestClearFaultState();
 
-    Eigen::Vector2d GetLastMeasures() { return m_lastSensorMeasures; };
+    Rotation::Vec2 GetLastMeasures() { return m_lastSensorMeasures; };
 
     /**
      * @brief Steps the controller and state machine (call this iteratively)
@@ -122,8 +118,16 @@ class MotionController {
      */
     void PopMessage(char *line2);
 
+    /**
+     * @brief Serial logs the latency statistics, measured from the moment
+     * each sensor frame was received
+     *
+     * @param reset true to clear the statistics afterwards
+     */
+    void PrintLatencyReport(bool reset = false);
+
   private:
-    Inclinometer::Module &m_sensor;
+    Inclinometer::ModuleBase &m_sensor;
     MotionStateMachine m_stateMachine;
     Display::Controller m_displayController;
     unsigned long m_lastDispUpdate;
@@ -134,7 +138,25 @@ class MotionController {
 
     unsigned long m_lastSensorReadingTimestamp;
     unsigned long m_lastSensorReadingUnstable;
-    Eigen::Vector2d m_lastSensorMeasures;
+    Rotation::Vec2 m_lastSensorMeasures;
+
+    //! m_lastSensorMeasures in fixed point, for everything after the model
+    Angle::MicroDegrees m_lastRoll = 0;
+    Angle::MicroDegrees m_lastPitch = 0;
+
+    //! Receive time of the sample in m_lastSensorMeasures (micros)
+    unsigned long m_lastSampleTimestamp = 0;
+    //! True until the sample in m_lastSensorMeasures has driven the solenoids
+    bool m_sampleLatencyPending = false;
+
+    //! Time between received sensor frames
+    LatencyHistogram m_samplePeriod = LatencyHistogram(5000);
+    //! Frame received -> picked up by Step()
+    LatencyHistogram m_ingestLatency;
+    //! Frame received -> filtered and through the model
+    LatencyHistogram m_modelLatency;
+    //! Frame received -> solenoids set by MovementAlgorithmStep()
+    LatencyHistogram m_valveLatency;
 
     // Callback hooks from state machine:
     void StartMovement();
@@ -144,6 +166,15 @@ class MotionController {
     void MovementAlgorithmStep();
     bool CheckStabilityStep();
 
+    /**
+     * @brief Converts a number of sensor sample periods to milliseconds
+     *
+     * @param samplePeriods number of samples at the current output data rate
+     * @return unsigned long the window (ms), at least
+     * k_minimumSensorWindowMillis
+     */
+    unsigned long SensorWindowMillis(unsigned long samplePeriods);
+
     // Disp update Step
     void DispUpdate();
 
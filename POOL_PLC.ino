@@ -10,39 +10,64 @@
  */
 
 #include "ACEINNAInclinometer.h"
+#include "ADXL355Calibration.h"
+#include "ADXL355Inclinometer.h"
 #include "Constants.h"
 #include "FaultHandling.h"
+#include "FusedInclinometer.h"
 #include "InclinometerModel.h"
 #include "InclinometerModule.h"
 #include "MotionController.h"
 #include "MotionStateMachine.h"
 #include "PersistentStorage.h"
-
-#include <stlport.h>
-
-#include <Eigen30.h>
+#include "TiltEstimator.h"
 
 #include <Adafruit_EEPROM_I2C.h>
 #include <Adafruit_FRAM_I2C.h>
 #include <Controllino.h>
-#include <Eigen/Core>
-#include <Eigen/Geometry>
 #include <SPI.h>
 
 Fault::Handler *faultHandler;
 PersistentStorage::Manager storageManager;
 
-Inclinometer::ACEINNAInclinometer
-    aceinna(Serial2, Constants::Algorithm::k_inclinometerEWMASmoothingAlpha);
-Inclinometer::Module
-    inclinometer1(&aceinna,
-                  Constants::Physical::k_inclinometerInstalledYawAdjustment);
+// The estimator does its own smoothing, so the EWMA is skipped with it
+Inclinometer::ACEINNAInclinometer aceinna(
+    Serial2, Constants::Algorithm::k_useTiltEstimator
+                 ? 1.0
+                 : Constants::Algorithm::k_inclinometerEWMASmoothingAlpha);
+// The fusion weighs the ADXL355 by the noise on its samples, so it doesn't
+// smooth them
+Inclinometer::ADXL355Inclinometer
+    accelerometer(PIN_CAST(Constants::Pins::SENSOR::ACCEL_CS), -1, 1.0,
+                  ADXL355_FILTER_LPF_4HZ_ODR, 5000000,
+                  Constants::Pins::k_accelerometerDrdyPin);
+Inclinometer::FusedInclinometer fusedInclinometer(
+    aceinna, Constants::Pins::k_accelerometerFitted ? &accelerometer : NULL,
+    Constants::Algorithm::k_sensorDisagreementLimit,
+    Constants::Algorithm::k_sensorDisagreementMillis,
+    Constants::Physical::k_accelerometerInstalledYawAdjustment -
+        Constants::Physical::k_inclinometerInstalledYawAdjustment);
+Inclinometer::TiltEstimator tiltEstimator(
+    Constants::Algorithm::k_estimatorAngleNoiseDegrees * PI / 180.0,
+    Constants::Algorithm::k_estimatorRateNoiseDegreesPerSecond * PI / 180.0,
+    Constants::Algorithm::k_estimatorAccelerationNoise * PI / 180.0);
+Inclinometer::Module<Inclinometer::FusedInclinometer>
+    inclinometer1(&fusedInclinometer,
+                  Constants::Physical::k_inclinometerInstalledYawAdjustment,
+                  Constants::Algorithm::k_useTiltEstimator ? &tiltEstimator
+                                                           : NULL);
 
 Motion::MotionController motionController(inclinometer1);
 
+// Poses captured so far by the 'c' command
+ADXL355Calibrator accelCalibrator;
+
 bool raising = false;
 bool lowering = false;
 
+Inclinometer::ACEINNAInclinometer::ProvisioningStatus lastProvisioningStatus =
+    Inclinometer::ACEINNAInclinometer::PROVISION_IDLE;
+
 void setup()
 {
     //! Output and Input setup ===============
@@ -78,20 +103,45 @@ void setup()
     }
     Serial.println("Storage began");
 
-    // Setup inclinometer
+    // Setup inclinometers (the ACEINNA runs alone if the ADXL355 fails)
     if (!inclinometer1.begin()) {
         faultHandler->setFaultCode(Fault::INCLINOMETER_INIT);
     }
     Serial.println("Inclinometer began");
-    storageManager.readMap();
+    if (Constants::Pins::k_accelerometerFitted &&
+        !fusedInclinometer.isSecondaryRunning()) {
+        Serial.println("Accelerometer did not start, using the ACEINNA alone");
+    }
+    if (storageManager.readMap()) {
+        Serial.println("Storage migrated to the current layout");
+    }
     inclinometer1.importZero(storageManager.getMap()->zeroFrame1);
+    inclinometer1.getModel().setSmallAngle(
+        Constants::Algorithm::k_useSmallAngleModel);
+    accelerometer.getAccelerometer().setCalibration(
+        storageManager.getMap()->accelCalibration);
+    if (!fusedInclinometer.setAlignment(
+            storageManager.getMap()->zeroFrame1,
+            storageManager.getMap()->zeroFrame2) &&
+        fusedInclinometer.isSecondaryRunning()) {
+        Serial.println("Inclinometers not aligned, zero them to fuse");
+    }
+
+    // Memory that was never written holds garbage, use the default profile
+    if (storageManager.getMap()->aceinnaProfile >=
+        Inclinometer::ACEINNAInclinometer::k_profileCount) {
+        storageManager.getMap()->aceinnaProfile =
+            Constants::Algorithm::k_defaultACEINNAProfile;
+    }
 
     // Initialize the motion controller
     motionController.Initialize();
     motionController
         .Step(); // Step the motion controller once to show any active faults
 
-    Serial.println("Initialized");
+    Serial.print("Initialized after ");
+    Serial.print(millis());
+    Serial.println(" ms");
 }
 
 /**
@@ -123,6 +173,46 @@ void loop()
     // Step the motion controller
     motionController.Step();
 
+    // Dump the latency statistics on request ('l', or 'L' to also reset
+    // them), switch to the next aceinna provisioning profile ('p'), or
+    // capture the next accelerometer calibration pose ('c', or 'C' to start
+    // over)
+    if (Serial.available()) {
+        char command = Serial.read();
+        if (command == 'l' || command == 'L') {
+            motionController.PrintLatencyReport(command == 'L');
+        }
+        else if ((command == 'c' || command == 'C') &&
+                 motionController.GetDirection() == Motion::NONE) {
+            calibrate_accelerometer(command == 'C');
+        }
+        else if (command == 'p' &&
+                 aceinna.getProvisioningStatus() !=
+                     Inclinometer::ACEINNAInclinometer::PROVISION_BUSY) {
+            PersistentStorage::Map *map = storageManager.getMap();
+            map->aceinnaProfile =
+                (map->aceinnaProfile + 1) %
+                Inclinometer::ACEINNAInclinometer::k_profileCount;
+            storageManager.writeMap();
+            provision_aceinna();
+        }
+    }
+
+    // Report when the aceinna module has been provisioned
+    Inclinometer::ACEINNAInclinometer::ProvisioningStatus provisioningStatus =
+        aceinna.getProvisioningStatus();
+    if (provisioningStatus != lastProvisioningStatus) {
+        if (provisioningStatus ==
+            Inclinometer::ACEINNAInclinometer::PROVISION_DONE) {
+            motionController.PopMessage("FLASHED SENSE EEPROM");
+        }
+        else if (provisioningStatus ==
+                 Inclinometer::ACEINNAInclinometer::PROVISION_FAILED) {
+            motionController.PopMessage("SENSE FLASH FAILED");
+        }
+        lastProvisioningStatus = provisioningStatus;
+    }
+
     // Update indicators
     indicator_step(motionController.GetState());
 
@@ -133,14 +223,17 @@ void loop()
 
     // Check if the user wanted to reflash the aceinna module
     if (digitalRead(PIN_CAST(Constants::Pins::BUTTON::REFLASH_ACEINNA))) {
-        aceinna.ProvisionACEINNAInclinometer();
-        motionController.PopMessage("FLASHED SENSE EEPROM");
+        provision_aceinna();
         delay(500);
     }
 
-    // Check if the user wanted to zero the inclinometer
+    // Check if the user wanted to zero the inclinometers. Both are zeroed
+    // together, which also lines the ADXL355 up with the ACEINNA.
     if (digitalRead(PIN_CAST(Constants::Pins::BUTTON::ZERO))) {
-        storageManager.getMap()->zeroFrame1 = inclinometer1.zero();
+        PersistentStorage::Map *map = storageManager.getMap();
+        map->zeroFrame1 = inclinometer1.zero();
+        map->zeroFrame2 = fusedInclinometer.zeroSecondary();
+        fusedInclinometer.setAlignment(map->zeroFrame1, map->zeroFrame2);
         storageManager.writeMap();
         motionController.PopMessage("RESET LEVEL SENSOR");
         delay(500);
@@ -150,6 +243,95 @@ void loop()
     delay(10);
 }
 
+/**
+ * @brief Starts writing the selected profile to the aceinna module. The
+ * result is reported from loop() once the sensor has confirmed it.
+ */
+void provision_aceinna()
+{
+    byte dataTypes = Inclinometer::ACEINNAInclinometer::DATA_SSI2;
+    if (Constants::Algorithm::k_useMeasuredRates) {
+        dataTypes |= Inclinometer::ACEINNAInclinometer::DATA_ANGULAR_RATE;
+    }
+    if (aceinna.ProvisionACEINNAInclinometer(
+            storageManager.getMap()->aceinnaProfile, dataTypes)) {
+        motionController.PopMessage("FLASHING SENSE EEPROM");
+    }
+}
+
+/**
+ * @brief Captures the next of the six poses ADXL355Calibrator needs: +X, -X,
+ * +Y, -Y, +Z and then -Z pointing up. The sensor has to sit still in the
+ * pose for the whole capture, which blocks the loop for about 16 s. Once
+ * all six are in, the calibration is solved, put in use and stored.
+ *
+ * @param restart true to forget the poses captured so far first
+ */
+void calibrate_accelerometer(bool restart)
+{
+    if (!fusedInclinometer.isSecondaryRunning()) {
+        Serial.println("No accelerometer running to calibrate");
+        return;
+    }
+    if (restart) {
+        accelCalibrator.reset();
+    }
+    // The capture reads the data registers, which the interrupt owns
+    if (Constants::Pins::k_accelerometerDrdyPin >= 0) {
+        Serial.println("Calibration needs the DRDY interrupt off");
+        return;
+    }
+
+    byte pose = accelCalibrator.getOrientationCount();
+    Serial.print("Capturing ");
+    print_pose(pose);
+    Serial.println(" up");
+    ADXL355Measurement average;
+    ADXL355Calibrator::CaptureResult result =
+        ADXL355Calibrator::captureStatic(accelerometer.getAccelerometer(),
+                                         average);
+    if (result == ADXL355Calibrator::CAPTURE_TIMEOUT) {
+        Serial.println("Accelerometer not answering");
+        return;
+    }
+    if (result == ADXL355Calibrator::CAPTURE_MOVED) {
+        Serial.println("Accelerometer moved, capture the pose again");
+        return;
+    }
+    accelCalibrator.addOrientation(average, ADXL355Calibrator::getPose(pose));
+
+    if (accelCalibrator.getOrientationCount() <
+        ADXL355Calibrator::k_minimumOrientations) {
+        Serial.print("Now point ");
+        print_pose(accelCalibrator.getOrientationCount());
+        Serial.println(" up and send c");
+        return;
+    }
+
+    ADXL355Calibration calibration;
+    bool solved = accelCalibrator.solve(calibration);
+    accelCalibrator.reset();
+    if (!solved) {
+        Serial.println("Calibration failed, start over with C");
+        return;
+    }
+    accelerometer.getAccelerometer().setCalibration(calibration);
+    storageManager.getMap()->accelCalibration = calibration;
+    storageManager.writeMap();
+    motionController.PopMessage("ACCEL CALIBRATED");
+}
+
+/**
+ * @brief Prints the axis that points up in a pose of getPose(), e.g. "-Y"
+ *
+ * @param pose 0 to 5
+ */
+void print_pose(byte pose)
+{
+    Serial.print((pose % 2 == 0) ? '+' : '-');
+    Serial.print((char)('X' + pose / 2));
+}
+
 void indicator_step(Motion::MotionStateMachine::STATE state)
 {
     // Fault indicator
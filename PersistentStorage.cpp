@@ -1,11 +1,25 @@
 #include "PersistentStorage.h"
 
-void PersistentStorage::Manager::readMap()
+bool PersistentStorage::Manager::readMap()
 {
-    uint8_t *mapBuffer = (uint8_t *)&storageMap;
-    for (unsigned int i = 0; i < sizeof(Map); i++) {
-        mapBuffer[i] = fram.read8(i);
+    readBytes((uint8_t *)&storageMap, sizeof(Map));
+    if (storageMap.magic == k_mapMagic && storageMap.version == k_mapVersion) {
+        return false;
+    }
+
+    if (storageMap.magic == k_mapMagic) {
+        // Written by a newer layout, nothing in it can be trusted here
+        memset(&storageMap, 0, sizeof(Map));
+    }
+    else {
+        LegacyMap legacy;
+        readBytes((uint8_t *)&legacy, sizeof(LegacyMap));
+        migrate(legacy);
     }
+    storageMap.magic = k_mapMagic;
+    storageMap.version = k_mapVersion;
+    writeMap();
+    return true;
 }
 
 void PersistentStorage::Manager::writeMap()
@@ -14,4 +28,38 @@ void PersistentStorage::Manager::writeMap()
     for (unsigned int i = 0; i < sizeof(Map); i++) {
         fram.write8(i, mapBuffer[i]);
     }
+}
+
+void PersistentStorage::Manager::readBytes(uint8_t *buffer, unsigned int size)
+{
+    for (unsigned int i = 0; i < size; i++) {
+        buffer[i] = fram.read8(i);
+    }
+}
+
+void PersistentStorage::Manager::migrate(const LegacyMap &legacy)
+{
+    storageMap.zeroFrame1 = migrate(legacy.zeroFrame1);
+    storageMap.zeroFrame2 = migrate(legacy.zeroFrame2);
+    // These are checked where they are used, like they always were
+    storageMap.aceinnaProfile = legacy.aceinnaProfile;
+    storageMap.accelCalibration = legacy.accelCalibration;
+}
+
+Inclinometer::ModelZeropoint
+PersistentStorage::Manager::migrate(const LegacyZeropoint &zero)
+{
+    // clang-format off
+    Rotation::Rot3 m(zero.m00, zero.m01, zero.m02,
+                     zero.m10, zero.m11, zero.m12,
+                     zero.m20, zero.m21, zero.m22);
+    // clang-format on
+
+    // A legacy map that was never zeroed holds garbage (maybe NaN, so no
+    // comparison of it is true), which becomes an invalid zero pose
+    if (!(m.orthogonalityError() < 1e-3)) {
+        Inclinometer::ModelZeropoint invalid = {0, 0, 0, 0};
+        return invalid;
+    }
+    return Inclinometer::frameToZero(m);
 }
\ No newline at end of file
@@ -12,6 +12,7 @@
 #ifndef PERSISTENT_STORAGE_H
 #define PERSISTENT_STORAGE_H
 
+#include "ADXL355.h"
 #include "Adafruit_FRAM_I2C.h"
 #include "InclinometerModel.h"
 
@@ -19,14 +20,57 @@
 
 namespace PersistentStorage {
 
+//! Marks a map with a header, the legacy layout has none ("PP")
+constexpr uint16_t k_mapMagic = 0x5050;
+
+//! Layout version of Map, bump it (and migrate) when the layout changes.
+//! The legacy layout counts as version 1.
+constexpr byte k_mapVersion = 2;
+
 /**
  * @brief PersistentStorage memory map
  */
 typedef struct {
+    //! k_mapMagic, once the map has been written in this layout
+    uint16_t magic;
+    //! k_mapVersion of the layout
+    byte version;
     Inclinometer::ModelZeropoint zeroFrame1;
     Inclinometer::ModelZeropoint zeroFrame2;
+    //! ACEINNA provisioning profile (index into
+    //! ACEINNAInclinometer::k_profiles)
+    byte aceinnaProfile;
+    //! ADXL355 calibration, only applied if its version matches
+    ADXL355Calibration accelCalibration;
 } Map;
 
+/**
+ * @brief A zero pose as the legacy layout stored it, the flattened rotation
+ * matrix of the zero frame
+ */
+typedef struct {
+    double m00;
+    double m01;
+    double m02;
+    double m10;
+    double m11;
+    double m12;
+    double m20;
+    double m21;
+    double m22;
+} LegacyZeropoint;
+
+/**
+ * @brief The legacy memory map, without a header, which is migrated to Map
+ * on boot
+ */
+typedef struct {
+    LegacyZeropoint zeroFrame1;
+    LegacyZeropoint zeroFrame2;
+    byte aceinnaProfile;
+    ADXL355Calibration accelCalibration;
+} LegacyMap;
+
 /**
  * @brief PersistentStorage memory manager
  */
@@ -42,8 +86,14 @@ class Manager {
 
     /**
      * @brief read the memory from persistent storage into the manager
+     *
+     * A map in the legacy layout is migrated to this one and written back.
+     * A map of an unknown version is cleared, since it can't be read.
+     *
+     * @return true if the map was migrated or cleared
+     * @return false if it was read as it is
      */
-    void readMap();
+    bool readMap();
 
     /**
      * @brief write the memory from the manager into persistent storage
@@ -61,6 +111,10 @@ class Manager {
   private:
     Map storageMap;
     Adafruit_FRAM_I2C fram;
+
+    void readBytes(uint8_t *buffer, unsigned int size);
+    void migrate(const LegacyMap &legacy);
+    static Inclinometer::ModelZeropoint migrate(const LegacyZeropoint &zero);
 };
 }; // namespace PersistentStorage
 
@@ -0,0 +1,409 @@
+/**
+ * @file Rotation.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Small fixed-size vectors, rotation matrices and quaternions, for
+ * the few 3D rotations the inclinometers need
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef ROTATION_GUARD_H
+#define ROTATION_GUARD_H
+
+#include <Arduino.h>
+
+/**
+ * Everything is a plain value type with no heap, no alignment requirements
+ * and no expression templates. Each operation is written out element by
+ * element, which is what a 3x3 wants on an 8-bit CPU. Whatever C++11 lets
+ * be constexpr is, so rotations made of constants fold at compile time.
+ *
+ * The conventions are the ones the model always used: fromRPY(r, p, y) is
+ * Rx(r) Ry(p) Rz(y), applied to column vectors, and toRPY() inverts it with
+ * roll in (-pi, pi] and pitch in [-pi/2, pi/2].
+ */
+namespace Rotation {
+
+/**
+ * @brief Two element vector
+ */
+template <typename Scalar> class Vec2T {
+  public:
+    constexpr Vec2T() : v{0, 0} {};
+    constexpr Vec2T(Scalar x, Scalar y) : v{x, y} {};
+
+    Scalar &operator[](byte i) { return v[i]; };
+    constexpr Scalar operator[](byte i) const { return v[i]; };
+
+    constexpr Vec2T operator+(const Vec2T &o) const
+    {
+        return Vec2T(v[0] + o.v[0], v[1] + o.v[1]);
+    };
+    constexpr Vec2T operator-(const Vec2T &o) const
+    {
+        return Vec2T(v[0] - o.v[0], v[1] - o.v[1]);
+    };
+    constexpr Vec2T operator-() const { return Vec2T(-v[0], -v[1]); };
+    constexpr Vec2T operator*(Scalar s) const
+    {
+        return Vec2T(v[0] * s, v[1] * s);
+    };
+    constexpr Vec2T operator/(Scalar s) const
+    {
+        return Vec2T(v[0] / s, v[1] / s);
+    };
+    Vec2T &operator+=(const Vec2T &o)
+    {
+        v[0] += o.v[0];
+        v[1] += o.v[1];
+        return *this;
+    };
+    Vec2T &operator-=(const Vec2T &o)
+    {
+        v[0] -= o.v[0];
+        v[1] -= o.v[1];
+        return *this;
+    };
+
+    constexpr Scalar dot(const Vec2T &o) const
+    {
+        return v[0] * o.v[0] + v[1] * o.v[1];
+    };
+    constexpr Scalar squaredNorm() const { return dot(*this); };
+    Scalar norm() const { return sqrt(squaredNorm()); };
+
+    template <typename Other> constexpr Vec2T<Other> cast() const
+    {
+        return Vec2T<Other>(v[0], v[1]);
+    };
+
+  private:
+    Scalar v[2];
+};
+
+/**
+ * @brief Three element vector
+ */
+template <typename Scalar> class Vec3T {
+  public:
+    constexpr Vec3T() : v{0, 0, 0} {};
+    constexpr Vec3T(Scalar x, Scalar y, Scalar z) : v{x, y, z} {};
+
+    static constexpr Vec3T unitX() { return Vec3T(1, 0, 0); };
+    static constexpr Vec3T unitY() { return Vec3T(0, 1, 0); };
+    static constexpr Vec3T unitZ() { return Vec3T(0, 0, 1); };
+
+    Scalar &operator[](byte i) { return v[i]; };
+    constexpr Scalar operator[](byte i) const { return v[i]; };
+
+    constexpr Vec3T operator+(const Vec3T &o) const
+    {
+        return Vec3T(v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2]);
+    };
+    constexpr Vec3T operator-(const Vec3T &o) const
+    {
+        return Vec3T(v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2]);
+    };
+    constexpr Vec3T operator-() const { return Vec3T(-v[0], -v[1], -v[2]); };
+    constexpr Vec3T operator*(Scalar s) const
+    {
+        return Vec3T(v[0] * s, v[1] * s, v[2] * s);
+    };
+    constexpr Vec3T operator/(Scalar s) const
+    {
+        return Vec3T(v[0] / s, v[1] / s, v[2] / s);
+    };
+
+    constexpr Scalar dot(const Vec3T &o) const
+    {
+        return v[0] * o.v[0] + v[1] * o.v[1] + v[2] * o.v[2];
+    };
+    constexpr Vec3T cross(const Vec3T &o) const
+    {
+        return Vec3T(v[1] * o.v[2] - v[2] * o.v[1],
+                     v[2] * o.v[0] - v[0] * o.v[2],
+                     v[0] * o.v[1] - v[1] * o.v[0]);
+    };
+    constexpr Scalar squaredNorm() const { return dot(*this); };
+    Scalar norm() const { return sqrt(squaredNorm()); };
+
+    template <typename Other> constexpr Vec3T<Other> cast() const
+    {
+        return Vec3T<Other>(v[0], v[1], v[2]);
+    };
+
+  private:
+    Scalar v[3];
+};
+
+/**
+ * @brief 3x3 rotation matrix
+ *
+ * Nothing keeps it orthonormal, orthogonalityError() tells how far it is.
+ */
+template <typename Scalar> class Rot3T {
+  public:
+    //! The identity
+    constexpr Rot3T() : m{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}} {};
+    constexpr Rot3T(Scalar m00, Scalar m01, Scalar m02, Scalar m10,
+                    Scalar m11, Scalar m12, Scalar m20, Scalar m21,
+                    Scalar m22)
+        : m{{m00, m01, m02}, {m10, m11, m12}, {m20, m21, m22}} {};
+
+    static constexpr Rot3T identity() { return Rot3T(); };
+
+    static Rot3T aboutX(Scalar angle)
+    {
+        Scalar c = cos(angle);
+        Scalar s = sin(angle);
+        return Rot3T(1, 0, 0, 0, c, -s, 0, s, c);
+    };
+    static Rot3T aboutY(Scalar angle)
+    {
+        Scalar c = cos(angle);
+        Scalar s = sin(angle);
+        return Rot3T(c, 0, s, 0, 1, 0, -s, 0, c);
+    };
+    static Rot3T aboutZ(Scalar angle)
+    {
+        Scalar c = cos(angle);
+        Scalar s = sin(angle);
+        return Rot3T(c, -s, 0, s, c, 0, 0, 0, 1);
+    };
+
+    /**
+     * @brief Makes Rx(roll) Ry(pitch) Rz(yaw), without multiplying the three
+     * out
+     */
+    static Rot3T fromRPY(Scalar roll, Scalar pitch, Scalar yaw)
+    {
+        Scalar cr = cos(roll), sr = sin(roll);
+        Scalar cp = cos(pitch), sp = sin(pitch);
+        Scalar cy = cos(yaw), sy = sin(yaw);
+        // clang-format off
+        return Rot3T(cp * cy,                -cp * sy,                sp,
+                     cr * sy + sr * sp * cy, cr * cy - sr * sp * sy,  -sr * cp,
+                     sr * sy - cr * sp * cy, sr * cy + cr * sp * sy,  cr * cp);
+        // clang-format on
+    };
+    static Rot3T fromRPY(const Vec3T<Scalar> &angles)
+    {
+        return fromRPY(angles[0], angles[1], angles[2]);
+    };
+
+    /**
+     * @brief The roll, pitch and yaw fromRPY() would make this from
+     *
+     * @return Vec3T roll, pitch, yaw
+     */
+    Vec3T<Scalar> toRPY() const
+    {
+        return Vec3T<Scalar>(
+            atan2(-m[1][2], m[2][2]),
+            atan2(m[0][2], sqrt(m[1][2] * m[1][2] + m[2][2] * m[2][2])),
+            atan2(-m[0][1], m[0][0]));
+    };
+
+    Scalar &operator()(byte row, byte col) { return m[row][col]; };
+    constexpr Scalar operator()(byte row, byte col) const
+    {
+        return m[row][col];
+    };
+
+    constexpr Vec3T<Scalar> row(byte i) const
+    {
+        return Vec3T<Scalar>(m[i][0], m[i][1], m[i][2]);
+    };
+    constexpr Vec3T<Scalar> col(byte i) const
+    {
+        return Vec3T<Scalar>(m[0][i], m[1][i], m[2][i]);
+    };
+
+    constexpr Rot3T transpose() const
+    {
+        return Rot3T(m[0][0], m[1][0], m[2][0], m[0][1], m[1][1], m[2][1],
+                     m[0][2], m[1][2], m[2][2]);
+    };
+
+    constexpr Vec3T<Scalar> operator*(const Vec3T<Scalar> &v) const
+    {
+        return Vec3T<Scalar>(row(0).dot(v), row(1).dot(v), row(2).dot(v));
+    };
+
+    /**
+     * @brief this^T * v, without making the transpose
+     */
+    constexpr Vec3T<Scalar> transposeMultiply(const Vec3T<Scalar> &v) const
+    {
+        return Vec3T<Scalar>(col(0).dot(v), col(1).dot(v), col(2).dot(v));
+    };
+
+    Rot3T operator*(const Rot3T &o) const
+    {
+        Rot3T product;
+        for (byte i = 0; i < 3; i++) {
+            for (byte j = 0; j < 3; j++) {
+                product.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j] +
+                                  m[i][2] * o.m[2][j];
+            }
+        }
+        return product;
+    };
+
+    /**
+     * @brief this * o^T, without making the transpose
+     */
+    Rot3T multiplyTranspose(const Rot3T &o) const
+    {
+        Rot3T product;
+        for (byte i = 0; i < 3; i++) {
+            for (byte j = 0; j < 3; j++) {
+                product.m[i][j] = m[i][0] * o.m[j][0] + m[i][1] * o.m[j][1] +
+                                  m[i][2] * o.m[j][2];
+            }
+        }
+        return product;
+    };
+
+    /**
+     * @brief How far this is from a rotation
+     *
+     * @return Scalar Frobenius norm of this * this^T - I, NaN for NaN
+     */
+    Scalar orthogonalityError() const
+    {
+        Rot3T square = multiplyTranspose(*this);
+        Scalar sum = 0;
+        for (byte i = 0; i < 3; i++) {
+            for (byte j = 0; j < 3; j++) {
+                Scalar e = square.m[i][j] - (i == j ? 1 : 0);
+                sum += e * e;
+            }
+        }
+        return sqrt(sum);
+    };
+
+    template <typename Other> Rot3T<Other> cast() const
+    {
+        return Rot3T<Other>(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1],
+                            m[1][2], m[2][0], m[2][1], m[2][2]);
+    };
+
+  private:
+    Scalar m[3][3];
+};
+
+/**
+ * @brief Quaternion, w + xi + yj + zk
+ *
+ * Only unit quaternions are rotations. Nothing renormalizes them on the way,
+ * call normalized() on one that came from storage.
+ */
+template <typename Scalar> class QuatT {
+  public:
+    Scalar w, x, y, z;
+
+    //! The identity
+    constexpr QuatT() : w(1), x(0), y(0), z(0){};
+    constexpr QuatT(Scalar w, Scalar x, Scalar y, Scalar z)
+        : w(w), x(x), y(y), z(z){};
+
+    static constexpr QuatT identity() { return QuatT(); };
+
+    static QuatT aboutX(Scalar angle)
+    {
+        return QuatT(cos(angle / 2), sin(angle / 2), 0, 0);
+    };
+    static QuatT aboutY(Scalar angle)
+    {
+        return QuatT(cos(angle / 2), 0, sin(angle / 2), 0);
+    };
+    static QuatT aboutZ(Scalar angle)
+    {
+        return QuatT(cos(angle / 2), 0, 0, sin(angle / 2));
+    };
+
+    /**
+     * @brief Makes the quaternion of a rotation matrix (Shepperd's method,
+     * which divides by the largest of the four components, so it is
+     * accurate for every rotation)
+     *
+     * @param r a rotation matrix
+     * @return QuatT the unit quaternion, with w >= 0
+     */
+    static QuatT fromRotation(const Rot3T<Scalar> &r)
+    {
+        Scalar trace = r(0, 0) + r(1, 1) + r(2, 2);
+        QuatT q;
+        if (trace > r(0, 0) && trace > r(1, 1) && trace > r(2, 2)) {
+            Scalar s = 2 * sqrt(1 + trace);
+            q = QuatT(s / 4, (r(2, 1) - r(1, 2)) / s, (r(0, 2) - r(2, 0)) / s,
+                      (r(1, 0) - r(0, 1)) / s);
+        }
+        else if (r(0, 0) > r(1, 1) && r(0, 0) > r(2, 2)) {
+            Scalar s = 2 * sqrt(1 + r(0, 0) - r(1, 1) - r(2, 2));
+            q = QuatT((r(2, 1) - r(1, 2)) / s, s / 4, (r(0, 1) + r(1, 0)) / s,
+                      (r(0, 2) + r(2, 0)) / s);
+        }
+        else if (r(1, 1) > r(2, 2)) {
+            Scalar s = 2 * sqrt(1 - r(0, 0) + r(1, 1) - r(2, 2));
+            q = QuatT((r(0, 2) - r(2, 0)) / s, (r(0, 1) + r(1, 0)) / s, s / 4,
+                      (r(1, 2) + r(2, 1)) / s);
+        }
+        else {
+            Scalar s = 2 * sqrt(1 - r(0, 0) - r(1, 1) + r(2, 2));
+            q = QuatT((r(1, 0) - r(0, 1)) / s, (r(0, 2) + r(2, 0)) / s,
+                      (r(1, 2) + r(2, 1)) / s, s / 4);
+        }
+        return (q.w < 0 ? -q : q).normalized();
+    };
+
+    constexpr QuatT operator*(const QuatT &o) const
+    {
+        return QuatT(w * o.w - x * o.x - y * o.y - z * o.z,
+                     w * o.x + x * o.w + y * o.z - z * o.y,
+                     w * o.y - x * o.z + y * o.w + z * o.x,
+                     w * o.z + x * o.y - y * o.x + z * o.w);
+    };
+    constexpr QuatT operator-() const { return QuatT(-w, -x, -y, -z); };
+
+    //! The inverse, for a unit quaternion
+    constexpr QuatT conjugate() const { return QuatT(w, -x, -y, -z); };
+
+    constexpr Scalar squaredNorm() const
+    {
+        return w * w + x * x + y * y + z * z;
+    };
+    QuatT normalized() const
+    {
+        Scalar n = 1 / sqrt(squaredNorm());
+        return QuatT(w * n, x * n, y * n, z * n);
+    };
+
+    /**
+     * @brief The rotation matrix of a unit quaternion
+     */
+    constexpr Rot3T<Scalar> toRotation() const
+    {
+        return Rot3T<Scalar>(
+            1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y),
+            2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x),
+            2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y));
+    };
+
+    template <typename Other> constexpr QuatT<Other> cast() const
+    {
+        return QuatT<Other>(w, x, y, z);
+    };
+};
+
+typedef Vec2T<double> Vec2;
+typedef Vec3T<double> Vec3;
+typedef Rot3T<double> Rot3;
+typedef QuatT<double> Quat;
+} // namespace Rotation
+
+#endif
\ No newline at end of file
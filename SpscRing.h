@@ -0,0 +1,110 @@
+/**
+ * @file SpscRing.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Lock-free single-producer/single-consumer ring buffer, for handing
+ * data from an interrupt to the main loop
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef SPSC_RING_GUARD_H
+#define SPSC_RING_GUARD_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Fixed-size queue shared by exactly one producer (e.g. an ISR) and
+ * one consumer (e.g. loop()), without disabling interrupts
+ *
+ * The head is only written by the producer and the tail only by the
+ * consumer. Both are single bytes, so reads and writes of them are atomic on
+ * the AVR. They count freely and wrap at 256, and are masked down to a slot,
+ * which is why N has to be a power of two no bigger than 128 (one slot is
+ * not left empty, the difference of the counters tells full from empty). An
+ * element is copied in or out before the index that hands it over is
+ * written, with a compiler barrier in between.
+ *
+ * @tparam T element type, copied by value
+ * @tparam N capacity, a power of two from 2 to 128
+ */
+template <typename T, byte N> class SpscRing {
+    static_assert(N >= 2 && N <= 128 && (N & (N - 1)) == 0,
+                  "SpscRing capacity must be a power of two up to 128");
+
+  public:
+    SpscRing() : head(0), tail(0){};
+
+    /**
+     * @brief Adds an element. Only call this from the producer.
+     *
+     * @param item the element to add
+     * @return true if it was added
+     * @return false if the ring is full (the element is dropped)
+     */
+    bool push(const T &item)
+    {
+        byte h = head;
+        if ((byte)(h - tail) == N) {
+            return false;
+        }
+        slots[h & (N - 1)] = item;
+        barrier();
+        head = h + 1;
+        return true;
+    };
+
+    /**
+     * @brief Takes the oldest element. Only call this from the consumer.
+     *
+     * @param item overwritten with the element
+     * @return true if there was an element
+     * @return false if the ring is empty
+     */
+    bool pop(T &item)
+    {
+        byte t = tail;
+        if (t == head) {
+            return false;
+        }
+        item = slots[t & (N - 1)];
+        barrier();
+        tail = t + 1;
+        return true;
+    };
+
+    /**
+     * @brief Get the number of elements waiting. Exact from the consumer,
+     * which can only see it grow in the meantime.
+     *
+     * @return byte number of elements
+     */
+    byte size() { return (byte)(head - tail); };
+
+    /**
+     * @brief Checks if there is nothing to pop
+     *
+     * @return true if the ring is empty
+     * @return false if there is at least one element
+     */
+    bool empty() { return head == tail; };
+
+    /**
+     * @brief Get the capacity
+     *
+     * @return byte N
+     */
+    static constexpr byte capacity() { return N; };
+
+  private:
+    T slots[N];
+    volatile byte head;
+    volatile byte tail;
+
+    //! Keeps the compiler from moving the element copy past the index update
+    static inline void barrier() { asm volatile("" ::: "memory"); };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "TiltEstimator.h"
+
+Inclinometer::TiltEstimator::TiltEstimator(double angleNoise, double rateNoise,
+                                           double accelerationNoise)
+    : angleVariance(angleNoise * angleNoise),
+      rateVariance(rateNoise * rateNoise),
+      accelerationVariance(accelerationNoise * accelerationNoise),
+      started(false), lastTimestamp(0)
+{
+}
+
+void Inclinometer::TiltEstimator::reset() { started = false; }
+
+void Inclinometer::TiltEstimator::addAngles(const Rotation::Vec2 &angles,
+                                            unsigned long timestamp)
+{
+    if (started && timestamp - lastTimestamp > k_maximumGapMicros &&
+        (long)(timestamp - lastTimestamp) > 0) {
+        started = false;
+    }
+    if (!started) {
+        // Only the angle is known, the rate could be anything the platform
+        // does
+        for (byte i = 0; i < 2; i++) {
+            axes[i].angle = angles[i];
+            axes[i].rate = 0;
+            axes[i].p00 = angleVariance;
+            axes[i].p01 = 0;
+            axes[i].p11 = 1;
+        }
+        lastTimestamp = timestamp;
+        started = true;
+        return;
+    }
+
+    predict(timestamp);
+    for (byte i = 0; i < 2; i++) {
+        correctAngle(axes[i], angles[i]);
+    }
+}
+
+void Inclinometer::TiltEstimator::addRates(const Rotation::Vec2 &rates,
+                                           unsigned long timestamp)
+{
+    if (!started) {
+        return;
+    }
+    predict(timestamp);
+    for (byte i = 0; i < 2; i++) {
+        correctRate(axes[i], rates[i]);
+    }
+}
+
+bool Inclinometer::TiltEstimator::getEstimate(TiltEstimate &estimate)
+{
+    if (!started) {
+        return false;
+    }
+    for (byte i = 0; i < 2; i++) {
+        estimate.angles[i] = axes[i].angle;
+        estimate.rates[i] = axes[i].rate;
+        estimate.angleVariance[i] = axes[i].p00;
+        estimate.rateVariance[i] = axes[i].p11;
+    }
+    estimate.timestamp = lastTimestamp;
+    return true;
+}
+
+void Inclinometer::TiltEstimator::predict(unsigned long timestamp)
+{
+    // A sample from before the newest one corrects the state as it is
+    long elapsed = (long)(timestamp - lastTimestamp);
+    if (elapsed <= 0) {
+        return;
+    }
+    lastTimestamp = timestamp;
+
+    double dt = elapsed * 1e-6;
+    double q = accelerationVariance;
+    for (byte i = 0; i < 2; i++) {
+        Axis &axis = axes[i];
+        axis.angle += axis.rate * dt;
+        // F P F^T + Q, for F = [1 dt; 0 1] and white acceleration
+        axis.p00 += dt * (2 * axis.p01 + dt * axis.p11) + q * dt * dt * dt / 3;
+        axis.p01 += dt * axis.p11 + q * dt * dt / 2;
+        axis.p11 += q * dt;
+    }
+}
+
+void Inclinometer::TiltEstimator::correctAngle(Axis &axis, double angle)
+{
+    double innovation = angle - axis.angle;
+    double s = axis.p00 + angleVariance;
+    double k0 = axis.p00 / s;
+    double k1 = axis.p01 / s;
+    axis.angle += k0 * innovation;
+    axis.rate += k1 * innovation;
+    // (I - K H) P, with H = [1 0]
+    axis.p11 -= k1 * axis.p01;
+    axis.p01 -= k0 * axis.p01;
+    axis.p00 -= k0 * axis.p00;
+}
+
+void Inclinometer::TiltEstimator::correctRate(Axis &axis, double rate)
+{
+    double innovation = rate - axis.rate;
+    double s = axis.p11 + rateVariance;
+    double k0 = axis.p01 / s;
+    double k1 = axis.p11 / s;
+    axis.angle += k0 * innovation;
+    axis.rate += k1 * innovation;
+    // (I - K H) P, with H = [0 1]
+    axis.p00 -= k0 * axis.p01;
+    axis.p01 -= k0 * axis.p11;
+    axis.p11 -= k1 * axis.p11;
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+/**
+ * @file TiltEstimator.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Kalman filter that estimates tilt angle and rate from timestamped
+ * samples
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef TILT_ESTIMATOR_GUARD_H
+#define TILT_ESTIMATOR_GUARD_H
+
+#include "Rotation.h"
+
+#include <Arduino.h>
+
+namespace Inclinometer {
+
+/**
+ * @brief The estimator's output for both axes
+ */
+typedef struct {
+    //! Estimated angles, in the same order as Module::getLatest() (radians)
+    Rotation::Vec2 angles;
+    //! Estimated rates of the angles (radians per second)
+    Rotation::Vec2 rates;
+    //! Variance of the estimated angles (radians^2)
+    Rotation::Vec2 angleVariance;
+    //! Variance of the estimated rates (radians^2 / second^2)
+    Rotation::Vec2 rateVariance;
+    //! micros() the estimate is for
+    unsigned long timestamp;
+} TiltEstimate;
+
+/**
+ * @brief Tracks angle and rate on two axes, as a constant rate with random
+ * changes in rate (white angular acceleration)
+ *
+ * The axes are independent. Each angle sample and each measured rate
+ * corrects the state, weighted by how much it can be trusted against what
+ * the state has already seen. Unlike a chain of moving averages, a steady
+ * tilt rate is followed without lag, since the rate is part of the state.
+ */
+class TiltEstimator {
+  public:
+    //! Longest gap between samples that is bridged, past it the estimate
+    //! starts over (microseconds)
+    static constexpr unsigned long k_maximumGapMicros = 1000000UL;
+
+    /**
+     * @brief Construct a new TiltEstimator object
+     *
+     * @param angleNoise standard deviation of the angle samples (radians)
+     * @param rateNoise standard deviation of the measured rates (radians per
+     * second)
+     * @param accelerationNoise how quickly the tilt rate can change, as the
+     * spectral density of the angular acceleration (radians / second^1.5)
+     */
+    TiltEstimator(double angleNoise, double rateNoise,
+                  double accelerationNoise);
+
+    /**
+     * @brief Forgets the estimate, the next angle sample starts it over
+     */
+    void reset();
+
+    /**
+     * @brief Corrects the estimate with an angle sample
+     *
+     * @param angles the measured angles (radians)
+     * @param timestamp micros() the sample was taken at
+     */
+    void addAngles(const Rotation::Vec2 &angles, unsigned long timestamp);
+
+    /**
+     * @brief Corrects the estimate with measured rates
+     *
+     * @param rates the measured rates (radians per second)
+     * @param timestamp micros() the rates were taken at
+     */
+    void addRates(const Rotation::Vec2 &rates, unsigned long timestamp);
+
+    /**
+     * @brief Get the estimate as of the newest sample
+     *
+     * @param estimate overwritten with the estimate, if there is one
+     * @return true if there is an estimate
+     * @return false if no angle sample came in yet
+     */
+    bool getEstimate(TiltEstimate &estimate);
+
+  private:
+    /**
+     * @brief State and covariance of one axis
+     */
+    typedef struct {
+        double angle;
+        double rate;
+        //! Covariance, which is symmetric
+        double p00;
+        double p01;
+        double p11;
+    } Axis;
+
+    double angleVariance;
+    double rateVariance;
+    double accelerationVariance;
+
+    Axis axes[2];
+    bool started;
+    unsigned long lastTimestamp;
+
+    void predict(unsigned long timestamp);
+    void correctAngle(Axis &axis, double angle);
+    void correctRate(Axis &axis, double rate);
+};
+}; // namespace Inclinometer
+
+#endif
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "ACEINNASimulator.h"
+
+namespace {
+//! PGNs the simulator knows about
+enum PGN {
+    PGN_ACKNOWLEDGEMENT = 0xE800,
+    PGN_REQUEST = 0xEA00,
+    PGN_ENABLED_PERIODIC_DATA_TYPES = 61366,
+    PGN_SSI2DATA = 61481,
+    PGN_ANGULAR_RATE = 61482,
+    PGN_SAVE_EEPROM = 65361,
+    PGN_ODR = 65365,
+    PGN_PERIODIC_DATA_TYPES = 65366,
+    PGN_LOW_PASS = 65367
+};
+
+//! Periodic data type bits for SSI2 and ARI
+constexpr byte k_typeSSI2 = 1;
+constexpr byte k_typeARI = 2;
+
+constexpr unsigned long long k_never = ~0ULL;
+
+unsigned long makeID(byte priority, unsigned long PGN, byte source)
+{
+    return ((unsigned long)priority << 26) | (PGN << 8) | source;
+}
+
+void putRate(byte *data, double degreesPerSecond)
+{
+    // 1/128 degree/s per bit, offset -250 degrees/s
+    unsigned int raw =
+        (unsigned int)((degreesPerSecond + 250.0) * 128.0 + 0.5);
+    data[0] = raw & 0xFF;
+    data[1] = (raw >> 8) & 0xFF;
+}
+
+void putAngle(byte *data, double degrees)
+{
+    // 1/32768 degree per bit, offset -250 degrees
+    unsigned long raw = (unsigned long)((degrees + 250.0) * 32768.0 + 0.5);
+    data[0] = raw & 0xFF;
+    data[1] = (raw >> 8) & 0xFF;
+    data[2] = (raw >> 16) & 0xFF;
+}
+} // namespace
+
+ACEINNASimulator::ACEINNASimulator(unsigned int odrHz, byte address)
+    : address(address), samplePeriod(1000000ULL / odrHz), nextSampleTime(0),
+      dataTypes(k_typeSSI2), addressedReplies(false), lowPassRate(2),
+      lowPassAcceleration(2), saveCount(0), sampleCount(0), amplitude(2.0),
+      motionPeriod(60.0)
+{
+    nextSampleTime = samplePeriod;
+}
+
+void ACEINNASimulator::setMotion(double amplitudeDegrees, double periodSeconds)
+{
+    amplitude = amplitudeDegrees;
+    motionPeriod = periodSeconds;
+}
+
+bool ACEINNASimulator::loadScript(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    script.clear();
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ScriptPoint point;
+        if (line[0] != '#' &&
+            sscanf(line, "%lf %lf %lf", &point.time, &point.pitch,
+                   &point.roll) == 3) {
+            point.time *= 1000.0;
+            script.push_back(point);
+        }
+    }
+    fclose(file);
+    return !script.empty();
+}
+
+void ACEINNASimulator::getAngles(unsigned long long time, double &pitch,
+                                 double &roll)
+{
+    if (script.empty()) {
+        double phase = 2.0 * PI * (time / 1e6) / motionPeriod;
+        pitch = amplitude * sin(phase);
+        roll = amplitude * cos(phase);
+        return;
+    }
+
+    size_t i = 0;
+    while (i + 1 < script.size() && script[i + 1].time <= time) {
+        i++;
+    }
+    if (i + 1 == script.size() || time <= script[i].time) {
+        pitch = script[i].pitch;
+        roll = script[i].roll;
+        return;
+    }
+    double t =
+        (time - script[i].time) / (script[i + 1].time - script[i].time);
+    pitch = script[i].pitch + t * (script[i + 1].pitch - script[i].pitch);
+    roll = script[i].roll + t * (script[i + 1].roll - script[i].roll);
+}
+
+void ACEINNASimulator::getRates(unsigned long long time, double &pitchRate,
+                                double &rollRate)
+{
+    // Central difference over a millisecond
+    unsigned long long before = time > 500 ? time - 500 : 0;
+    double pitchBefore, rollBefore, pitchAfter, rollAfter;
+    getAngles(before, pitchBefore, rollBefore);
+    getAngles(time + 500, pitchAfter, rollAfter);
+    double span = (time + 500 - before) / 1e6;
+    pitchRate = (pitchAfter - pitchBefore) / span;
+    rollRate = (rollAfter - rollBefore) / span;
+}
+
+unsigned long long ACEINNASimulator::nextFrameTime()
+{
+    unsigned long long next =
+        (dataTypes & (k_typeSSI2 | k_typeARI)) && samplePeriod != 0
+            ? nextSampleTime
+            : k_never;
+    if (!responses.empty() && responses.front().time < next) {
+        next = responses.front().time;
+    }
+    return next;
+}
+
+void ACEINNASimulator::nextFrame(EmulatedCanFrame &frame)
+{
+    if (!responses.empty() && responses.front().time <= nextFrameTime()) {
+        frame = responses.front();
+        responses.pop_front();
+        return;
+    }
+
+    // ARI goes out right after SSI2, at the same time
+    if (dataTypes & k_typeARI) {
+        queueRates(nextSampleTime);
+    }
+    if (!(dataTypes & k_typeSSI2)) {
+        nextSampleTime += samplePeriod;
+        frame = responses.front();
+        responses.pop_front();
+        return;
+    }
+
+    double pitch, roll;
+    getAngles(nextSampleTime, pitch, roll);
+    frame.id = makeID(6, PGN_SSI2DATA, address);
+    // The inclinometer class flips the sign of pitch
+    putAngle(frame.data, -pitch);
+    putAngle(frame.data + 3, roll);
+    frame.data[6] = 0;
+    frame.data[7] = 0;
+    frame.time = nextSampleTime;
+
+    nextSampleTime += samplePeriod;
+    sampleCount++;
+}
+
+void ACEINNASimulator::onFrame(const EmulatedCanFrame &frame)
+{
+    byte pf = (frame.id >> 16) & 0xFF;
+    byte ps = (frame.id >> 8) & 0xFF;
+    byte source = frame.id & 0xFF;
+    unsigned long PGN = (frame.id >> 8) & 0x3FFFF;
+
+    if ((PGN & 0x3FF00) == PGN_REQUEST && (ps == address || ps == 0xFF)) {
+        unsigned long requested = (unsigned long)frame.data[0] |
+                                  ((unsigned long)frame.data[1] << 8) |
+                                  ((unsigned long)frame.data[2] << 16);
+        byte data[8];
+        memset(data, 0xFF, sizeof(data));
+        // Readbacks have the layout of the command: address, then settings
+        data[0] = source;
+        if (requested == PGN_ENABLED_PERIODIC_DATA_TYPES) {
+            // The MTLT answers with the PGN as it is, even though 0xEF is a
+            // peer-to-peer format. J1939 puts the requester in the PDU
+            // specific byte instead.
+            unsigned long reply =
+                addressedReplies ? (requested & 0x3FF00) | source : requested;
+            data[1] = dataTypes;
+            respond(makeID(6, reply, address), data, frame.time);
+        }
+        else if (requested == PGN_ODR) {
+            data[1] = samplePeriod / 10000ULL;
+            respond(makeID(6, requested, address), data, frame.time);
+        }
+        else if (requested == PGN_LOW_PASS) {
+            data[1] = lowPassRate;
+            data[2] = lowPassAcceleration;
+            respond(makeID(6, requested, address), data, frame.time);
+        }
+        else {
+            memset(data, 0xFF, sizeof(data));
+            data[0] = 1; // Negative acknowledgement
+            data[4] = source;
+            data[5] = requested & 0xFF;
+            data[6] = (requested >> 8) & 0xFF;
+            data[7] = (requested >> 16) & 0xFF;
+            respond(makeID(6, PGN_ACKNOWLEDGEMENT | 0xFF, address), data,
+                    frame.time);
+        }
+    }
+    else if (pf >= 0xF0 && frame.data[0] == address) {
+        // Command messages carry the destination in the first byte
+        if (PGN == PGN_ODR) {
+            setODR(frame.data[1], frame.time);
+        }
+        else if (PGN == PGN_PERIODIC_DATA_TYPES) {
+            dataTypes = frame.data[1];
+        }
+        else if (PGN == PGN_LOW_PASS) {
+            lowPassRate = frame.data[1];
+            lowPassAcceleration = frame.data[2];
+        }
+    }
+    else if (PGN == PGN_SAVE_EEPROM && frame.data[0] == 0 &&
+             frame.data[1] == address) {
+        // Answered with the response flag, the requester and success
+        byte data[8];
+        memset(data, 0xFF, sizeof(data));
+        data[0] = 1;
+        data[1] = source;
+        data[2] = 1;
+        saveCount++;
+        respond(makeID(6, PGN_SAVE_EEPROM, address), data, frame.time);
+    }
+}
+
+void ACEINNASimulator::setODR(byte code, unsigned long long time)
+{
+    // The rate is 100 Hz divided by the code, 0 stops the periodic data
+    samplePeriod = code * 10000ULL;
+    nextSampleTime = time + samplePeriod;
+}
+
+void ACEINNASimulator::queueRates(unsigned long long time)
+{
+    double pitchRate, rollRate;
+    getRates(time, pitchRate, rollRate);
+    EmulatedCanFrame frame;
+    frame.id = makeID(6, PGN_ANGULAR_RATE, address);
+    memset(frame.data, 0xFF, sizeof(frame.data));
+    // Same sign convention as the angles, and no yaw
+    putRate(frame.data, -pitchRate);
+    putRate(frame.data + 2, rollRate);
+    putRate(frame.data + 4, 0.0);
+    frame.time = time;
+
+    // Any pending responses are due later
+    responses.push_front(frame);
+}
+
+void ACEINNASimulator::respond(unsigned long id, const byte *data,
+                               unsigned long long requestTime)
+{
+    EmulatedCanFrame frame;
+    frame.id = id;
+    memcpy(frame.data, data, 8);
+    frame.time = requestTime + k_responseMicros;
+    responses.push_back(frame);
+}
@@ -0,0 +1,170 @@
+/**
+ * @file ACEINNASimulator.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Simulates an ACEINNA MTLT inclinometer on the emulated CAN bus
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef HOST_ACEINNA_SIMULATOR_H
+#define HOST_ACEINNA_SIMULATOR_H
+
+#include "LonganEmulator.h"
+
+#include <deque>
+#include <vector>
+
+/**
+ * @brief An ACEINNA MTLT that broadcasts SSI2 (pitch and roll), and
+ * optionally angular rates (ARI), at its output data rate
+ *
+ * The angles either follow a generated motion (a slow circle of the given
+ * amplitude) or a script. It answers Requests for the enabled periodic data
+ * types, output data rate and low pass filter, NACKs any other Request, and
+ * obeys the output data rate, periodic data type, low pass filter and save
+ * commands.
+ */
+class ACEINNASimulator : public EmulatedCanNode {
+  public:
+    /**
+     * @brief Construct a new ACEINNA Simulator object
+     *
+     * @param odrHz output data rate (Hz)
+     * @param address the sensor's source address
+     */
+    ACEINNASimulator(unsigned int odrHz = 10, byte address = 0x80);
+
+    /**
+     * @brief Set the generated motion
+     *
+     * @param amplitudeDegrees tilt of the circle (degrees)
+     * @param periodSeconds time for one full circle (s)
+     */
+    void setMotion(double amplitudeDegrees, double periodSeconds);
+
+    /**
+     * @brief Plays back angles from a script instead of the generated motion
+     *
+     * Each line holds "time_ms pitch_degrees roll_degrees". Angles are
+     * interpolated between lines and hold after the last one. Lines starting
+     * with # are ignored.
+     *
+     * @param path file to read
+     * @return true if the script was loaded
+     * @return false if it could not be read or had no lines
+     */
+    bool loadScript(const char *path);
+
+    /**
+     * @brief Get the angles the sensor measures at a point in time
+     *
+     * @param time simulated time (us)
+     * @param pitch overwritten with the pitch (degrees)
+     * @param roll overwritten with the roll (degrees)
+     */
+    void getAngles(unsigned long long time, double &pitch, double &roll);
+
+    /**
+     * @brief Get the angular rates the sensor measures at a point in time
+     *
+     * @param time simulated time (us)
+     * @param pitchRate overwritten with the pitch rate (degrees/s)
+     * @param rollRate overwritten with the roll rate (degrees/s)
+     */
+    void getRates(unsigned long long time, double &pitchRate,
+                  double &rollRate);
+
+    /**
+     * @brief Set the periodic data types, as if provisioned over the bus
+     *
+     * @param types data type bits (1 = SSI2, 2 = ARI)
+     */
+    void setDataTypes(byte types) { dataTypes = types; };
+
+    /**
+     * @brief Answers the enabled periodic data types readback the way J1939
+     * addresses a peer-to-peer PGN, with the requester in the PDU specific
+     * byte (0xEF11 for the sketch), instead of with 0xEFB6 like the MTLT
+     *
+     * @param addressed true for the J1939 addressing
+     */
+    void setAddressedReplies(bool addressed) { addressedReplies = addressed; };
+
+    /**
+     * @brief Get the number of SSI2 frames sent
+     *
+     * @return unsigned long frame count
+     */
+    unsigned long getSampleCount() { return sampleCount; };
+
+    /**
+     * @brief Get the number of times the configuration was saved
+     *
+     * @return unsigned long save count
+     */
+    unsigned long getSaveCount() { return saveCount; };
+
+    /**
+     * @brief Get the low pass filter cutoffs
+     *
+     * @param rate overwritten with the rate sensor cutoff (Hz)
+     * @param acceleration overwritten with the accelerometer cutoff (Hz)
+     */
+    void getLowPass(byte &rate, byte &acceleration)
+    {
+        rate = lowPassRate;
+        acceleration = lowPassAcceleration;
+    };
+
+    /**
+     * @brief Get the output data rate
+     *
+     * @return unsigned int samples per second, 0 if stopped
+     */
+    unsigned int getODR()
+    {
+        return samplePeriod ? 1000000ULL / samplePeriod : 0;
+    };
+
+    //! EmulatedCanNode interface
+
+    unsigned long long nextFrameTime() override;
+    void nextFrame(EmulatedCanFrame &frame) override;
+    void onFrame(const EmulatedCanFrame &frame) override;
+
+  private:
+    //! Time the sensor takes to answer a Request (us)
+    static constexpr unsigned long long k_responseMicros = 1000;
+
+    typedef struct {
+        double time;
+        double pitch;
+        double roll;
+    } ScriptPoint;
+
+    byte address;
+    unsigned long long samplePeriod;
+    unsigned long long nextSampleTime;
+    byte dataTypes;
+    bool addressedReplies;
+    byte lowPassRate;
+    byte lowPassAcceleration;
+    unsigned long saveCount;
+    unsigned long sampleCount;
+
+    double amplitude;
+    double motionPeriod;
+    std::vector<ScriptPoint> script;
+
+    std::deque<EmulatedCanFrame> responses;
+
+    void setODR(byte code, unsigned long long time);
+    void queueRates(unsigned long long time);
+    void respond(unsigned long id, const byte *data,
+                 unsigned long long requestTime);
+};
+
+#endif
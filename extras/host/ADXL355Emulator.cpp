@@ -0,0 +1,196 @@
+#include "ADXL355Emulator.h"
+
+namespace {
+constexpr byte k_regDeviceId = 0x00;
+constexpr byte k_regStatus = 0x04;
+constexpr byte k_regFifoEntries = 0x05;
+constexpr byte k_regDataBegin = 0x08;
+constexpr byte k_regDataEnd = 0x10;
+constexpr byte k_regFifoData = 0x11;
+constexpr byte k_regFilter = 0x28;
+constexpr byte k_regRange = 0x2C;
+constexpr byte k_regPowerControl = 0x2D;
+
+constexpr byte k_statusDataReady = 0x01;
+constexpr byte k_statusFifoFull = 0x02;
+constexpr byte k_statusFifoOverrun = 0x04;
+
+constexpr long k_xMarker = 0x01;
+constexpr long k_emptyMarker = 0x02;
+
+//! LSB of the 20 bit reading per g, in the 2 g range
+constexpr double k_lsbPerG = 256000.0;
+} // namespace
+
+ADXL355Emulator::ADXL355Emulator(uint8_t cs, unsigned int seed)
+    : noise(0), alive(true), generator(seed), measuring(false),
+      nextSampleMicros(0), samples(0), transferIndex(0), address(0),
+      reading(false), fifoByte(3)
+{
+    setGravity(0, 0, 1);
+    const double identity[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    const double none[3] = {0, 0, 0};
+    setErrors(identity, none);
+
+    memset(registers, 0, sizeof(registers));
+    registers[k_regDeviceId] = 0xAD;
+    registers[k_regRange] = 0x81;
+    registers[k_regPowerControl] = 0x01;
+    SPI.hostAttach(this, cs);
+}
+
+ADXL355Emulator::~ADXL355Emulator() { SPI.hostDetach(this); }
+
+void ADXL355Emulator::setGravity(double x, double y, double z)
+{
+    gravity[0] = x;
+    gravity[1] = y;
+    gravity[2] = z;
+}
+
+void ADXL355Emulator::setErrors(const double gain[3][3], const double offset[3])
+{
+    memcpy(this->gain, gain, sizeof(this->gain));
+    memcpy(this->offset, offset, sizeof(this->offset));
+}
+
+void ADXL355Emulator::acceleration(unsigned long long micros, double *g)
+{
+    (void)micros;
+    memcpy(g, gravity, sizeof(gravity));
+}
+
+unsigned long long ADXL355Emulator::samplePeriod()
+{
+    // The low bits of the filter setting halve the 4 kHz ODR for each step
+    return 250ULL << (registers[k_regFilter] & 0x0F);
+}
+
+void ADXL355Emulator::select()
+{
+    catchUp();
+    transferIndex = 0;
+    fifoByte = 3;
+}
+
+void ADXL355Emulator::catchUp()
+{
+    if (!measuring) {
+        return;
+    }
+    // Only the samples that can still be in the FIFO matter
+    unsigned long long now = hostMicros();
+    unsigned long long period = samplePeriod();
+    unsigned long long keep = period * (k_fifoEntries / 3 + 1);
+    if (nextSampleMicros + keep < now) {
+        unsigned long long skipped = (now - keep - nextSampleMicros) / period;
+        nextSampleMicros += skipped * period;
+        samples += skipped;
+        registers[k_regStatus] |= k_statusFifoOverrun;
+    }
+    while (nextSampleMicros <= now) {
+        takeSample(nextSampleMicros);
+        nextSampleMicros += period;
+    }
+}
+
+void ADXL355Emulator::takeSample(unsigned long long micros)
+{
+    double truth[3];
+    acceleration(micros, truth);
+    double lsbPerG = k_lsbPerG / (1 << ((registers[k_regRange] & 0x03) - 1));
+
+    for (int i = 0; i < 3; i++) {
+        double measured = offset[i] + noise * normal(generator);
+        for (int j = 0; j < 3; j++) {
+            measured += gain[i][j] * truth[j];
+        }
+        long raw = lround(measured * lsbPerG);
+        raw = (raw > 0x7FFFF) ? 0x7FFFF : (raw < -0x80000) ? -0x80000 : raw;
+        long word = (raw << 4) & 0xFFFFF0;
+
+        registers[k_regDataBegin + 3 * i] = word >> 16;
+        registers[k_regDataBegin + 3 * i + 1] = word >> 8;
+        registers[k_regDataBegin + 3 * i + 2] = word;
+        if (fifo.size() < (size_t)k_fifoEntries) {
+            fifo.push_back(word | ((i == 0) ? k_xMarker : 0));
+        }
+        else {
+            registers[k_regStatus] |= k_statusFifoOverrun;
+        }
+    }
+    registers[k_regStatus] |= k_statusDataReady;
+    samples++;
+}
+
+byte ADXL355Emulator::transfer(byte out)
+{
+    if (transferIndex++ == 0) {
+        address = out >> 1;
+        reading = out & 0x01;
+        return 0;
+    }
+    if (!alive) {
+        return 0;
+    }
+    if (reading) {
+        return readRegister();
+    }
+    writeRegister(out);
+    return 0;
+}
+
+byte ADXL355Emulator::readRegister()
+{
+    // FIFO_DATA doesn't advance the address, each entry is three reads
+    if (address == k_regFifoData) {
+        if (fifoByte == 3) {
+            long word = k_emptyMarker;
+            if (!fifo.empty()) {
+                word = fifo.front();
+                fifo.pop_front();
+            }
+            fifoEntry[0] = word >> 16;
+            fifoEntry[1] = word >> 8;
+            fifoEntry[2] = word;
+            fifoByte = 0;
+        }
+        return fifoEntry[fifoByte++];
+    }
+
+    byte value = 0;
+    if (address == k_regStatus) {
+        value = registers[k_regStatus];
+        if (fifo.size() >= (size_t)k_fifoEntries) {
+            value |= k_statusFifoFull;
+        }
+        registers[k_regStatus] &= ~k_statusFifoOverrun;
+    }
+    else if (address == k_regFifoEntries) {
+        value = fifo.size();
+    }
+    else if (address < sizeof(registers)) {
+        value = registers[address];
+    }
+    if (address >= k_regDataBegin && address <= k_regDataEnd) {
+        registers[k_regStatus] &= ~k_statusDataReady;
+    }
+    address++;
+    return value;
+}
+
+void ADXL355Emulator::writeRegister(byte value)
+{
+    if (address < sizeof(registers)) {
+        registers[address] = value;
+    }
+    if (address == k_regPowerControl) {
+        // Bit 0 is standby
+        bool start = (value & 0x01) == 0;
+        if (start && !measuring) {
+            nextSampleMicros = hostMicros() + samplePeriod();
+        }
+        measuring = start;
+    }
+    address++;
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+/**
+ * @file ADXL355Emulator.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Emulates an ADXL355 accelerometer on the SPI shim, for running the
+ * driver and everything built on it on a Linux host
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef HOST_ADXL355_EMULATOR_H
+#define HOST_ADXL355_EMULATOR_H
+
+#include <SPI.h>
+
+#include <deque>
+#include <random>
+
+/**
+ * @brief An ADXL355 behind a chip select pin
+ *
+ * It samples at the output data rate set in the FILTER register, on the
+ * simulated clock, once POWER_CTL has started measurement. Each sample is
+ * latched into the data registers (setting DATA_RDY, which reading them
+ * clears) and queued in the 96 entry FIFO, with the X marker and empty
+ * flags of the real chip. The chip's own low pass filter is not modelled.
+ *
+ * What it measures comes from acceleration(), gravity by default, put
+ * through a gain and offset error and white noise.
+ */
+class ADXL355Emulator : public SPIDevice {
+  public:
+    //! FIFO capacity in entries, one axis each
+    static constexpr int k_fifoEntries = 96;
+
+    /**
+     * @brief Construct a new ADXL355 Emulator and put it on the SPI bus
+     *
+     * @param cs the chip select pin the driver uses
+     * @param seed for the noise, so runs repeat
+     */
+    ADXL355Emulator(uint8_t cs, unsigned int seed = 1);
+
+    //! Takes it off the SPI bus
+    ~ADXL355Emulator() override;
+
+    /**
+     * @brief Sets what the chip measures as long as acceleration() isn't
+     * overridden
+     *
+     * @param x X (g)
+     * @param y Y (g)
+     * @param z Z (g)
+     */
+    void setGravity(double x, double y, double z);
+
+    /**
+     * @brief Sets the errors of this particular chip: measured = gain *
+     * acceleration + offset
+     *
+     * @param gain gain and cross-axis coupling, row major
+     * @param offset offset (g)
+     */
+    void setErrors(const double gain[3][3], const double offset[3]);
+
+    //! Standard deviation of the white noise on each axis (g)
+    void setNoise(double g) { noise = g; };
+
+    //! A dead chip answers every read with zeros
+    void setAlive(bool alive) { this->alive = alive; };
+
+    //! Number of samples taken since measurement started
+    unsigned long getSampleCount() { return samples; };
+
+    void select() override;
+    byte transfer(byte out) override;
+
+  protected:
+    /**
+     * @brief What the chip is subjected to at a moment in time
+     *
+     * @param micros simulated time (us)
+     * @param g overwritten with X, Y and Z (g)
+     */
+    virtual void acceleration(unsigned long long micros, double *g);
+
+  private:
+    double gravity[3];
+    double gain[3][3];
+    double offset[3];
+    double noise;
+    bool alive;
+    std::mt19937 generator;
+    std::normal_distribution<double> normal;
+
+    byte registers[0x30];
+    std::deque<long> fifo;
+    bool measuring;
+    unsigned long long nextSampleMicros;
+    unsigned long samples;
+
+    //! State of the transfer in progress
+    int transferIndex;
+    byte address;
+    bool reading;
+    byte fifoEntry[3];
+    int fifoByte;
+
+    unsigned long long samplePeriod();
+    void catchUp();
+    void takeSample(unsigned long long micros);
+    byte readRegister();
+    void writeRegister(byte value);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "LonganEmulator.h"
+
+namespace {
+//! UART baudrates selected by AT+S, in order
+const unsigned long k_baudrates[] = {9600, 19200, 38400, 57600, 115200};
+
+//! Silence after which a partial data mode frame is thrown away (us)
+constexpr unsigned long long k_frameGapMicros = 5000;
+
+constexpr unsigned long long k_never = ~0ULL;
+} // namespace
+
+LonganEmulator::LonganEmulator(unsigned long moduleBaud,
+                               unsigned int moduleQueueFrames)
+    : hostBaud(9600), moduleBaud(moduleBaud), pendingModuleBaud(0),
+      moduleQueueFrames(moduleQueueFrames), nodeCount(0), txDoneTime(0),
+      moduleOutDoneTime(0), dataMode(true), frameInLength(0),
+      lastDataByteTime(0), filtersActive(false)
+{
+    masks[0] = masks[1] = 0x1FFFFFFF;
+    for (int i = 0; i < 6; i++) {
+        filters[i] = 0;
+    }
+    memset(&stats, 0, sizeof(stats));
+}
+
+void LonganEmulator::addNode(EmulatedCanNode *node)
+{
+    if (nodeCount < k_maxNodes) {
+        nodes[nodeCount++] = node;
+    }
+}
+
+void LonganEmulator::update() { runUntil(hostMicros()); }
+
+void LonganEmulator::begin(unsigned long baud)
+{
+    update();
+    hostBaud = baud;
+}
+
+int LonganEmulator::available()
+{
+    update();
+    return rxBuffer.size();
+}
+
+int LonganEmulator::peek()
+{
+    update();
+    return rxBuffer.empty() ? -1 : rxBuffer.front();
+}
+
+int LonganEmulator::read()
+{
+    update();
+    if (rxBuffer.empty()) {
+        return -1;
+    }
+    byte c = rxBuffer.front();
+    rxBuffer.pop_front();
+    return c;
+}
+
+int LonganEmulator::availableForWrite()
+{
+    update();
+    return k_serialBufferSize - txBuffer.size();
+}
+
+void LonganEmulator::flush()
+{
+    update();
+    if (!txBuffer.empty()) {
+        // Blocks until the last byte is out, like the AVR core
+        unsigned long long done =
+            txDoneTime + (txBuffer.size() - 1) * byteMicros(hostBaud);
+        stats.txBlockedMicros += done - hostMicros();
+        hostAdvanceMicros(done - hostMicros());
+        update();
+    }
+}
+
+size_t LonganEmulator::write(uint8_t c)
+{
+    update();
+    if (txBuffer.size() >= (size_t)k_serialBufferSize) {
+        // The AVR core spins until there is room
+        stats.txBlockedMicros += txDoneTime - hostMicros();
+        hostAdvanceMicros(txDoneTime - hostMicros());
+        update();
+    }
+    if (txBuffer.empty()) {
+        txDoneTime = hostMicros() + byteMicros(hostBaud);
+    }
+    txBuffer.push_back(c);
+    return 1;
+}
+
+unsigned long long LonganEmulator::byteMicros(unsigned long baud)
+{
+    // Start bit, 8 data bits and a stop bit
+    return (10000000ULL + baud - 1) / baud;
+}
+
+void LonganEmulator::runUntil(unsigned long long now)
+{
+    // Handle every event up to now in the order it happened
+    while (true) {
+        unsigned long long txTime = txBuffer.empty() ? k_never : txDoneTime;
+        unsigned long long outTime =
+            moduleOut.empty() ? k_never : moduleOutDoneTime;
+        unsigned long long nodeTime = k_never;
+        int node = -1;
+        for (int i = 0; i < nodeCount; i++) {
+            if (nodes[i]->nextFrameTime() < nodeTime) {
+                nodeTime = nodes[i]->nextFrameTime();
+                node = i;
+            }
+        }
+
+        if (txTime <= outTime && txTime <= nodeTime && txTime <= now) {
+            byte c = txBuffer.front();
+            txBuffer.pop_front();
+            if (!txBuffer.empty()) {
+                txDoneTime = txTime + byteMicros(hostBaud);
+            }
+            moduleReceive(c, txTime);
+        }
+        else if (outTime <= nodeTime && outTime <= now) {
+            byte c = moduleOut.front();
+            moduleOut.pop_front();
+            if (hostBaud != moduleBaud) {
+                c ^= 0xA5;
+                stats.garbledBytes++;
+            }
+            if (rxBuffer.size() >= (size_t)k_serialBufferSize) {
+                stats.rxOverflowBytes++;
+            }
+            else {
+                rxBuffer.push_back(c);
+            }
+
+            if (!moduleOut.empty()) {
+                moduleOutDoneTime = outTime + byteMicros(moduleBaud);
+            }
+            else if (pendingModuleBaud != 0) {
+                // AT+S takes effect once its reply is out
+                moduleBaud = pendingModuleBaud;
+                pendingModuleBaud = 0;
+            }
+        }
+        else if (node >= 0 && nodeTime <= now) {
+            EmulatedCanFrame frame;
+            nodes[node]->nextFrame(frame);
+            frame.time = nodeTime;
+            busFrame(frame);
+        }
+        else {
+            return;
+        }
+    }
+}
+
+void LonganEmulator::moduleReceive(byte c, unsigned long long time)
+{
+    if (hostBaud != moduleBaud) {
+        // Noise on the line, which also breaks up whatever came before it
+        stats.garbledBytes++;
+        atLine.clear();
+        frameInLength = 0;
+        return;
+    }
+
+    if (dataMode) {
+        handleDataByte(c, time);
+    }
+    else if (c == '\n') {
+        // "+++" is not a command, it only has to get us into AT mode
+        while (atLine.compare(0, 3, "+++") == 0) {
+            atLine.erase(0, 3);
+        }
+        if (!atLine.empty() && atLine[atLine.size() - 1] == '\r') {
+            atLine.erase(atLine.size() - 1);
+        }
+        if (!atLine.empty()) {
+            handleAtCommand(atLine, time);
+        }
+        atLine.clear();
+    }
+    else if (atLine.size() < 64) {
+        atLine += (char)c;
+    }
+}
+
+void LonganEmulator::handleDataByte(byte c, unsigned long long time)
+{
+    if (frameInLength > 0 && time - lastDataByteTime > k_frameGapMicros) {
+        frameInLength = 0;
+    }
+    lastDataByteTime = time;
+    frameIn[frameInLength++] = c;
+
+    if (frameInLength == 3 && memcmp(frameIn, "+++", 3) == 0) {
+        dataMode = false;
+        frameInLength = 0;
+        atLine.clear();
+        return;
+    }
+
+    if (frameInLength == k_txFrameSize) {
+        frameInLength = 0;
+        EmulatedCanFrame frame;
+        frame.id = ((unsigned long)frameIn[0] << 24) |
+                   ((unsigned long)frameIn[1] << 16) |
+                   ((unsigned long)frameIn[2] << 8) | frameIn[3];
+        memcpy(frame.data, frameIn + 6, 8);
+        frame.time = time;
+        stats.txFrames++;
+        for (int i = 0; i < nodeCount; i++) {
+            nodes[i]->onFrame(frame);
+        }
+    }
+}
+
+void LonganEmulator::handleAtCommand(const std::string &command,
+                                     unsigned long long time)
+{
+    int slot, extended, value;
+    unsigned long id;
+    bool ok = true;
+
+    if (command == "AT") {
+    }
+    else if (sscanf(command.c_str(), "AT+S=%d", &value) == 1) {
+        ok = value >= 0 && value < 5;
+        if (ok) {
+            pendingModuleBaud = k_baudrates[value];
+        }
+    }
+    else if (sscanf(command.c_str(), "AT+C=%d", &value) == 1) {
+        ok = value >= 1 && value <= 18;
+    }
+    else if (sscanf(command.c_str(), "AT+M=[%d][%d][%lx]", &slot, &extended,
+                    &id) == 3) {
+        ok = slot >= 0 && slot < 2;
+        if (ok) {
+            masks[slot] = id;
+        }
+    }
+    else if (sscanf(command.c_str(), "AT+F=[%d][%d][%lx]", &slot, &extended,
+                    &id) == 3) {
+        ok = slot >= 0 && slot < 6;
+        if (ok) {
+            filters[slot] = id;
+            filtersActive = true;
+        }
+    }
+    else if (command == "AT+Q") {
+        dataMode = true;
+        frameInLength = 0;
+    }
+    else {
+        ok = false;
+    }
+
+    const char *reply = ok ? "OK\r\n" : "ERROR\r\n";
+    moduleSend((const byte *)reply, strlen(reply), time);
+    if (ok) {
+        stats.atCommands++;
+    }
+}
+
+void LonganEmulator::moduleSend(const byte *bytes, size_t length,
+                                unsigned long long time)
+{
+    if (moduleOut.empty()) {
+        moduleOutDoneTime = time + byteMicros(moduleBaud);
+    }
+    moduleOut.insert(moduleOut.end(), bytes, bytes + length);
+}
+
+void LonganEmulator::busFrame(const EmulatedCanFrame &frame)
+{
+    stats.busFrames++;
+    if (!dataMode) {
+        stats.atModeFrames++;
+        return;
+    }
+    if (!accepts(frame.id)) {
+        stats.filteredFrames++;
+        return;
+    }
+    size_t queued = (moduleOut.size() + k_rxFrameSize - 1) / k_rxFrameSize;
+    if (queued >= moduleQueueFrames) {
+        stats.moduleOverflowFrames++;
+        return;
+    }
+
+    byte bytes[k_rxFrameSize];
+    bytes[0] = frame.id >> 24;
+    bytes[1] = frame.id >> 16 & 0xff;
+    bytes[2] = frame.id >> 8 & 0xff;
+    bytes[3] = frame.id & 0xff;
+    memcpy(bytes + 4, frame.data, 8);
+    moduleSend(bytes, k_rxFrameSize, frame.time);
+    stats.forwardedFrames++;
+}
+
+bool LonganEmulator::accepts(unsigned long id)
+{
+    if (!filtersActive) {
+        return true;
+    }
+    // Mask 0 goes with filters 0 and 1, mask 1 with filters 2 to 5
+    for (int i = 0; i < 6; i++) {
+        unsigned long mask = masks[(i < 2) ? 0 : 1];
+        if (((id ^ filters[i]) & mask) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file LonganEmulator.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Emulates the Longan Labs Serial CAN module on the other end of a
+ * HardwareSerial, for running the CAN stack on a Linux host
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef HOST_LONGAN_EMULATOR_H
+#define HOST_LONGAN_EMULATOR_H
+
+#include <Arduino.h>
+
+#include <deque>
+#include <string>
+
+/**
+ * @brief A frame on the emulated CAN bus
+ */
+typedef struct {
+    unsigned long id;
+    byte data[8];
+    //! Simulated time the frame finished on the bus (us)
+    unsigned long long time;
+} EmulatedCanFrame;
+
+/**
+ * @brief Something on the emulated CAN bus, besides us
+ */
+class EmulatedCanNode {
+  public:
+    virtual ~EmulatedCanNode(){};
+
+    /**
+     * @brief Get the time at which the node sends its next frame
+     *
+     * @return unsigned long long simulated time (us)
+     */
+    virtual unsigned long long nextFrameTime() = 0;
+
+    /**
+     * @brief Produces the frame that is due at nextFrameTime()
+     *
+     * @param frame overwritten with the frame to put on the bus
+     */
+    virtual void nextFrame(EmulatedCanFrame &frame) = 0;
+
+    /**
+     * @brief Called with every frame the module sends on the bus. Any answer
+     * is produced through nextFrameTime() and nextFrame().
+     *
+     * @param frame the frame that was sent
+     */
+    virtual void onFrame(const EmulatedCanFrame &frame) = 0;
+};
+
+/**
+ * @brief Statistics kept by the emulator
+ */
+typedef struct {
+    //! Frames the nodes put on the bus
+    unsigned long busFrames;
+    //! Frames that passed the acceptance filters and were queued for the UART
+    unsigned long forwardedFrames;
+    //! Frames rejected by the acceptance filters
+    unsigned long filteredFrames;
+    //! Frames that arrived while the module was in AT mode
+    unsigned long atModeFrames;
+    //! Frames dropped because the module's own queue was full
+    unsigned long moduleOverflowFrames;
+    //! Bytes lost because the receive buffer on the host side was full
+    unsigned long rxOverflowBytes;
+    //! Bytes sent or received while the two ends of the UART disagreed on
+    //! the baudrate
+    unsigned long garbledBytes;
+    //! Frames the host sent on the bus
+    unsigned long txFrames;
+    //! AT commands the module accepted
+    unsigned long atCommands;
+    //! Time the host spent blocked on a full transmit buffer (us)
+    unsigned long long txBlockedMicros;
+} LonganEmulatorStats;
+
+/**
+ * @brief The HardwareSerial the CAN module is connected to, with the module
+ * emulated on the other end
+ *
+ * The UART is modelled byte by byte at the baudrate both ends are set to,
+ * with a 10 bit character time. The host side has the 64 byte receive and
+ * transmit buffers of the AVR core: received bytes are lost when the receive
+ * buffer is full, and writes block (advancing the simulated clock) when the
+ * transmit buffer is full. If the two ends use different baudrates, every
+ * byte arrives garbled.
+ *
+ * The module understands "+++", AT, AT+S, AT+C, AT+M, AT+F and AT+Q, and
+ * powers up in data mode at the given baudrate. In data mode it turns 14 byte
+ * frames from the host into bus frames, and sends every accepted bus frame to
+ * the host as 12 bytes (ID, then data). The acceptance filters only become
+ * active once a filter has been set, like on the real module.
+ */
+class LonganEmulator : public HardwareSerial {
+  public:
+    //! Size of the AVR core's serial buffers
+    static constexpr int k_serialBufferSize = 64;
+
+    /**
+     * @brief Construct a new Longan Emulator object
+     *
+     * @param moduleBaud the baudrate the module is set to at power-up
+     * @param moduleQueueFrames how many received frames the module can hold
+     * while they wait for the UART
+     */
+    LonganEmulator(unsigned long moduleBaud = 9600,
+                   unsigned int moduleQueueFrames = 8);
+
+    /**
+     * @brief Puts a node on the emulated bus (up to k_maxNodes)
+     *
+     * @param node the node, which has to outlive the emulator
+     */
+    void addNode(EmulatedCanNode *node);
+
+    /**
+     * @brief Runs the emulation up to the current simulated time. This
+     * happens on every call from the host, so it is only needed to move the
+     * bus along without touching the UART.
+     */
+    void update();
+
+    /**
+     * @brief Get the emulator statistics
+     *
+     * @return const LonganEmulatorStats& counters since construction
+     */
+    const LonganEmulatorStats &getStats() { return stats; };
+
+    /**
+     * @brief Checks if the module is in data mode
+     *
+     * @return true if frames are forwarded
+     * @return false if the module is in AT mode
+     */
+    bool inDataMode() { return dataMode; };
+
+    //! HardwareSerial interface, as seen by the sketch
+
+    void begin(unsigned long baud) override;
+    int available() override;
+    int peek() override;
+    int read() override;
+    int availableForWrite() override;
+    void flush() override;
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+  private:
+    static constexpr int k_maxNodes = 4;
+    static constexpr byte k_rxFrameSize = 12;
+    static constexpr byte k_txFrameSize = 14;
+
+    unsigned long hostBaud;
+    unsigned long moduleBaud;
+    unsigned long pendingModuleBaud;
+    unsigned int moduleQueueFrames;
+
+    EmulatedCanNode *nodes[k_maxNodes];
+    int nodeCount;
+
+    //! Host transmit buffer, and when its first byte is through the UART
+    std::deque<byte> txBuffer;
+    unsigned long long txDoneTime;
+
+    //! Bytes the module still has to send, and when the first one is through
+    std::deque<byte> moduleOut;
+    unsigned long long moduleOutDoneTime;
+
+    //! Host receive buffer
+    std::deque<byte> rxBuffer;
+
+    bool dataMode;
+    std::string atLine;
+    byte frameIn[k_txFrameSize];
+    byte frameInLength;
+    unsigned long long lastDataByteTime;
+
+    bool filtersActive;
+    unsigned long masks[2];
+    unsigned long filters[6];
+
+    LonganEmulatorStats stats;
+
+    unsigned long long byteMicros(unsigned long baud);
+    void runUntil(unsigned long long now);
+    void moduleReceive(byte c, unsigned long long time);
+    void moduleSend(const byte *bytes, size_t length, unsigned long long time);
+    void handleAtCommand(const std::string &command, unsigned long long time);
+    void handleDataByte(byte c, unsigned long long time);
+    void busFrame(const EmulatedCanFrame &frame);
+    bool accepts(unsigned long id);
+};
+
+#endif
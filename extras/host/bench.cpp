@@ -0,0 +1,442 @@
+/**
+ * @file bench.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Runs the CAN stack against the emulated Longan module and ACEINNA
+ * inclinometer, and reports throughput and loss. With -T, compares the
+ * transmit paths instead.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "ACEINNASimulator.h"
+#include "LonganEmulator.h"
+
+#include "../../ACEINNAInclinometer.h"
+#include "../../CANSAEJ1939.h"
+
+#include <chrono>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief Other traffic on the bus, from nodes we don't care about
+ */
+class BusLoadNode : public EmulatedCanNode {
+  public:
+    BusLoadNode(unsigned int framesPerSecond)
+        : period(framesPerSecond ? 1000000ULL / framesPerSecond : 0),
+          next(period ? period / 2 : ~0ULL), count(0){};
+
+    unsigned long long nextFrameTime() override { return next; };
+
+    void nextFrame(EmulatedCanFrame &frame) override
+    {
+        // Rotate through a few engine PGNs and source addresses
+        static const unsigned long pgns[] = {0xF004, 0xFEF1, 0xFEEE, 0xF003};
+        frame.id = (6UL << 26) | (pgns[count % 4] << 8) | (count % 3);
+        memset(frame.data, count & 0xFF, sizeof(frame.data));
+        next += period;
+        count++;
+    };
+
+    void onFrame(const EmulatedCanFrame &frame) override { (void)frame; };
+
+  private:
+    unsigned long long period;
+    unsigned long long next;
+    unsigned long count;
+};
+
+/**
+ * @brief Options from the command line
+ */
+typedef struct {
+    double seconds;
+    unsigned int odrHz;
+    unsigned int loopMillis;
+    unsigned int busLoad;
+    unsigned int moduleQueue;
+    unsigned long moduleBaud;
+    const char *script;
+    bool filters;
+    bool fullSensor;
+    bool rates;
+    int profile;
+    unsigned int txBurst;
+} BenchOptions;
+
+/**
+ * @brief What one transmit run did
+ */
+typedef struct {
+    //! Frames handed to the interface
+    unsigned long frames;
+    //! Frames that made it onto the bus
+    unsigned long sent;
+    //! Frames the interface dropped
+    unsigned long dropped;
+    //! Simulated time the loop was blocked on a full UART (us)
+    unsigned long long blockedMicros;
+    //! Most simulated time a single loop iteration was blocked (us)
+    unsigned long long worstLoopMicros;
+    //! Host time spent handing frames over, emulated UART included (us)
+    double hostMicros;
+} TxResult;
+
+unsigned long ssi2Frames = 0;
+
+void onSSI2(const CAN::J1939Message &m, void *context)
+{
+    (void)m;
+    (void)context;
+    ssi2Frames++;
+}
+
+double wallMicros()
+{
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-t seconds] [-o odr_hz] [-l loop_ms] [-b bus_fps]\n"
+            "          [-q module_queue_frames] [-B module_baud] [-s script]\n"
+            "          [-n] [-A] [-R] [-P profile] [-T burst]\n"
+            "  -n  don't set the module's acceptance filters\n"
+            "  -A  run the full ACEINNAInclinometer instead of the bare J1939\n"
+            "      interface (uses its own filters)\n"
+            "  -R  have the sensor send angular rates (ARI) too\n"
+            "  -P  with -A, provision the sensor with a profile at start\n"
+            "  -T  send a burst of frames every loop, once a byte at a time\n"
+            "      like before the transmit queue, then through the queue\n",
+            name);
+}
+
+void printEmulatorStats(LonganEmulator &module, ACEINNASimulator &sensor)
+{
+    const LonganEmulatorStats &stats = module.getStats();
+    printf("Bus:    %lu frames, %lu SSI2, %lu forwarded, %lu filtered, "
+           "%lu in AT mode, %lu dropped in module\n",
+           stats.busFrames, sensor.getSampleCount(), stats.forwardedFrames,
+           stats.filteredFrames, stats.atModeFrames,
+           stats.moduleOverflowFrames);
+    printf("UART:   %lu bytes lost to RX overflow, %lu garbled, "
+           "%lu frames sent, %.1f ms blocked on TX\n",
+           stats.rxOverflowBytes, stats.garbledBytes, stats.txFrames,
+           stats.txBlockedMicros / 1000.0);
+}
+
+/**
+ * @brief Drives a bare J1939 interface, and counts what makes it through
+ */
+int runInterface(const BenchOptions &options, LonganEmulator &module,
+                 ACEINNASimulator &sensor)
+{
+    CAN::J1939Interface bus(module);
+    bus.registerHandler(61481, onSSI2, NULL);
+    if (options.filters) {
+        const unsigned long pgns[] = {61481};
+        bus.acceptOnly(pgns, 1, 0x80);
+    }
+    bus.begin(CAN::SerialBaudrate::baud_115200, CAN::CANBusBaudrate::kbps_250);
+
+    unsigned long frames = 0;
+    double parseMicros = 0;
+    unsigned long long end = (unsigned long long)(options.seconds * 1e6);
+    while (hostMicros() < end) {
+        double start = wallMicros();
+        frames += bus.poll();
+        parseMicros += wallMicros() - start;
+        delay(options.loopMillis);
+    }
+
+    if (!bus.isReady()) {
+        printf("CAN module did not come up\n");
+        return 1;
+    }
+    printEmulatorStats(module, sensor);
+    printf("Parser: %lu frames, %lu SSI2, %lu resyncs, %lu bytes discarded\n",
+           frames, ssi2Frames, bus.getResyncCount(),
+           bus.getDiscardedByteCount());
+    printf("Bring-up %lu ms, SSI2 loss %.2f %%, host parse throughput "
+           "%.0f frames/s\n",
+           bus.getBringupMillis(),
+           sensor.getSampleCount()
+               ? 100.0 * (sensor.getSampleCount() - ssi2Frames) /
+                     sensor.getSampleCount()
+               : 0.0,
+           parseMicros > 0 ? frames / (parseMicros / 1e6) : 0.0);
+    return 0;
+}
+
+/**
+ * @brief Serializes a frame and writes it a byte at a time, the way
+ * RawInterface::write() did before it had a transmit queue. Blocks while the
+ * UART has no room.
+ */
+void writePerByte(HardwareSerial &serial, const CAN::ExtendedCanDataPacket &p)
+{
+    byte dta[14] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    dta[0] = p.id >> 24;
+    dta[1] = p.id >> 16 & 0xff;
+    dta[2] = p.id >> 8 & 0xff;
+    dta[3] = p.id & 0xff;
+    dta[4] = 1;
+    dta[5] = 0;
+    for (int i = 0; i < 8; i++) {
+        dta[6 + i] = p.data[i];
+    }
+    for (int i = 0; i < 14; i++) {
+        serial.write(dta[i]);
+    }
+}
+
+/**
+ * @brief Sends options.txBurst frames every loop on a freshly brought up
+ * module
+ *
+ * @param queued true to go through RawInterface::write(), false to write a
+ * byte at a time
+ */
+TxResult runTxPath(const BenchOptions &options, bool queued)
+{
+    LonganEmulator module(options.moduleBaud, options.moduleQueue);
+    CAN::RawInterface can(module);
+    can.begin(CAN::SerialBaudrate::baud_115200, CAN::CANBusBaudrate::kbps_250);
+    while (!can.step()) {
+        if (can.hasFailed()) {
+            TxResult none = {0, 0, 0, 0, 0, 0};
+            return none;
+        }
+        delay(1);
+    }
+
+    const LonganEmulatorStats &stats = module.getStats();
+    unsigned long sentBefore = stats.txFrames;
+    unsigned long long blockedBefore = stats.txBlockedMicros;
+    TxResult result = {0, 0, 0, 0, 0, 0};
+
+    // A broadcast from us, with a counter in it
+    CAN::ExtendedCanDataPacket p;
+    p.id = (6UL << 26) | (0xFEF1UL << 8) | 0x10;
+    unsigned long long end = hostMicros() + options.seconds * 1e6;
+    while (hostMicros() < end) {
+        unsigned long long loopBlocked = stats.txBlockedMicros;
+        double start = wallMicros();
+        if (queued) {
+            // What the sketch does on every poll
+            can.flushTx();
+        }
+        for (unsigned int i = 0; i < options.txBurst; i++) {
+            p.data[0] = result.frames & 0xFF;
+            p.data[1] = result.frames >> 8 & 0xFF;
+            if (queued) {
+                can.write(p);
+            }
+            else {
+                writePerByte(module, p);
+            }
+            result.frames++;
+        }
+        result.hostMicros += wallMicros() - start;
+        if (stats.txBlockedMicros - loopBlocked > result.worstLoopMicros) {
+            result.worstLoopMicros = stats.txBlockedMicros - loopBlocked;
+        }
+        delay(options.loopMillis);
+    }
+    module.update();
+
+    result.sent = stats.txFrames - sentBefore;
+    result.dropped = can.getTxDroppedCount();
+    result.blockedMicros = stats.txBlockedMicros - blockedBefore;
+    return result;
+}
+
+/**
+ * @brief Compares writing a frame a byte at a time with the transmit queue
+ */
+int runTx(const BenchOptions &options)
+{
+    printf("%.1f s, %u frames every %u ms loop, module at %lu baud before "
+           "bring-up\n",
+           options.seconds, options.txBurst, options.loopMillis,
+           options.moduleBaud);
+    const char *names[] = {"Per byte:", "Queued:  "};
+    for (int queued = 0; queued < 2; queued++) {
+        TxResult r = runTxPath(options, queued);
+        if (r.frames == 0) {
+            printf("CAN module did not come up\n");
+            return 1;
+        }
+        printf("%s %.0f frames/s on the bus, %lu of %lu dropped, loop blocked "
+               "%.1f ms\n          (worst loop %.2f ms), %.2f us host time "
+               "per frame\n",
+               names[queued], r.sent / options.seconds, r.dropped, r.frames,
+               r.blockedMicros / 1000.0, r.worstLoopMicros / 1000.0,
+               r.hostMicros / r.frames);
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the inclinometer class the sketch uses, and checks its angles
+ */
+int runSensor(const BenchOptions &options, LonganEmulator &module,
+              ACEINNASimulator &sensor)
+{
+    Inclinometer::ACEINNAInclinometer inclinometer(module);
+    inclinometer.begin();
+    if (options.profile >= 0) {
+        byte dataTypes = Inclinometer::ACEINNAInclinometer::DATA_SSI2;
+        if (options.rates) {
+            dataTypes |= Inclinometer::ACEINNAInclinometer::DATA_ANGULAR_RATE;
+        }
+        inclinometer.ProvisionACEINNAInclinometer(options.profile, dataTypes);
+    }
+
+    unsigned long samples = 0;
+    unsigned long rateSamples = 0;
+    unsigned long lastRateTimestamp = 0;
+    double maxError = 0;
+    double maxRateError = 0;
+    double sensorMicros = 0;
+    unsigned long long end = (unsigned long long)(options.seconds * 1e6);
+    while (hostMicros() < end) {
+        double start = wallMicros();
+        Inclinometer::Sample batch[4];
+        byte count = inclinometer.readAll(batch, 4);
+        for (byte i = 0; i < count; i++) {
+            double pitch, roll;
+            sensor.getAngles(batch[i].timestamp, pitch, roll);
+            double error = fabs(batch[i].angles[0] * 180.0 / PI - pitch);
+            error = fmax(error, fabs(batch[i].angles[1] * 180.0 / PI - roll));
+            maxError = fmax(maxError, error);
+        }
+        samples += count;
+
+        Inclinometer::RateSample rates;
+        if (inclinometer.getRates(rates) &&
+            rates.timestamp != lastRateTimestamp) {
+            double pitchRate, rollRate;
+            sensor.getRates(rates.timestamp, pitchRate, rollRate);
+            double error = fabs(rates.rates[0] * 180.0 / PI - pitchRate);
+            error = fmax(error, fabs(rates.rates[1] * 180.0 / PI - rollRate));
+            maxRateError = fmax(maxRateError, error);
+            lastRateTimestamp = rates.timestamp;
+            rateSamples++;
+        }
+        sensorMicros += wallMicros() - start;
+        delay(options.loopMillis);
+    }
+
+    printEmulatorStats(module, sensor);
+    printf("Sensor: %lu samples, max error %.4f deg, %.1f us host time per "
+           "sample\n",
+           samples, maxError, samples ? sensorMicros / samples : 0.0);
+    if (options.rates) {
+        printf("Rates:  %lu samples, max error %.4f deg/s\n", rateSamples,
+               maxRateError);
+    }
+    if (options.profile >= 0) {
+        byte rate, acceleration;
+        sensor.getLowPass(rate, acceleration);
+        printf("Profile: status %d, sensor at %u Hz ODR, %u/%u Hz low pass, "
+               "saved %lu times, sample period %lu us\n",
+               (int)inclinometer.getProvisioningStatus(), sensor.getODR(),
+               rate, acceleration, sensor.getSaveCount(),
+               inclinometer.getSamplePeriod());
+        if (inclinometer.getProvisioningStatus() !=
+            Inclinometer::ACEINNAInclinometer::PROVISION_DONE) {
+            return 1;
+        }
+    }
+    return samples > 0 ? 0 : 1;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchOptions options = {60.0, 10, 10, 0, 8, 9600, NULL, true, false,
+                            false, -1, 0};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:o:l:b:q:B:s:nARP:T:h")) != -1) {
+        switch (opt) {
+        case 't':
+            options.seconds = atof(optarg);
+            break;
+        case 'o':
+            options.odrHz = atoi(optarg);
+            break;
+        case 'l':
+            options.loopMillis = atoi(optarg);
+            break;
+        case 'b':
+            options.busLoad = atoi(optarg);
+            break;
+        case 'q':
+            options.moduleQueue = atoi(optarg);
+            break;
+        case 'B':
+            options.moduleBaud = atol(optarg);
+            break;
+        case 's':
+            options.script = optarg;
+            break;
+        case 'n':
+            options.filters = false;
+            break;
+        case 'A':
+            options.fullSensor = true;
+            break;
+        case 'R':
+            options.rates = true;
+            break;
+        case 'P':
+            options.profile = atoi(optarg);
+            break;
+        case 'T':
+            options.txBurst = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.odrHz == 0 || options.odrHz > 100) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.txBurst > 0) {
+        return runTx(options);
+    }
+
+    LonganEmulator module(options.moduleBaud, options.moduleQueue);
+    ACEINNASimulator sensor(options.odrHz);
+    BusLoadNode load(options.busLoad);
+    if (options.script != NULL && !sensor.loadScript(options.script)) {
+        fprintf(stderr, "could not read %s\n", options.script);
+        return 2;
+    }
+    if (options.rates) {
+        sensor.setDataTypes(
+            Inclinometer::ACEINNAInclinometer::DATA_SSI2 |
+            Inclinometer::ACEINNAInclinometer::DATA_ANGULAR_RATE);
+    }
+    module.addNode(&sensor);
+    module.addNode(&load);
+
+    printf("%.1f s at %u Hz ODR, %u ms loop, %u frames/s other traffic, "
+           "module at %lu baud\n",
+           options.seconds, options.odrHz, options.loopMillis,
+           options.busLoad, options.moduleBaud);
+    return options.fullSensor ? runSensor(options, module, sensor)
+                              : runInterface(options, module, sensor);
+}
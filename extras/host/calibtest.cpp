@@ -0,0 +1,158 @@
+/**
+ * @file calibtest.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Calibrates an emulated ADXL355 with a known gain, cross-axis
+ * coupling and offset, and checks what the solved calibration does to its
+ * readings
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "ADXL355Emulator.h"
+
+#include "../../ADXL355Calibration.h"
+
+namespace {
+
+constexpr uint8_t k_chipSelect = 53;
+
+//! Largest error allowed after calibration, on any axis (g)
+constexpr double k_allowedErrorG = 3e-4;
+
+/**
+ * @brief An accelerometer that is being shaken
+ */
+class ShakenADXL355 : public ADXL355Emulator {
+  public:
+    ShakenADXL355(uint8_t cs) : ADXL355Emulator(cs){};
+
+  protected:
+    void acceleration(unsigned long long micros, double *g) override
+    {
+        g[0] = 0.2 * sin(micros * 1e-6 * 2 * PI * 0.7);
+        g[1] = 0;
+        g[2] = 1;
+    };
+};
+
+/**
+ * @brief Captures the six poses, solves them and applies the result
+ *
+ * @return true if every reading afterwards is within k_allowedErrorG of
+ * the true acceleration
+ */
+bool checkSolve()
+{
+    const double gain[3][3] = {
+        {1.012, 0.004, -0.003}, {-0.006, 0.991, 0.008}, {0.002, -0.005, 1.007}};
+    const double offset[3] = {0.021, -0.034, 0.047};
+
+    ADXL355Emulator chip(k_chipSelect);
+    chip.setErrors(gain, offset);
+    chip.setNoise(0.0005);
+    ADXL355 accel(k_chipSelect);
+    if (!accel.begin(ADXL355_RANGE_2G, ADXL355_FILTER_LPF_4HZ_ODR)) {
+        printf("Calibration: emulated ADXL355 did not start\n");
+        return false;
+    }
+
+    ADXL355Calibrator calibrator;
+    bool captured = true;
+    for (byte pose = 0; pose < 6; pose++) {
+        ADXL355Measurement reference = ADXL355Calibrator::getPose(pose);
+        chip.setGravity(reference.x / ADXL355_MEASUREMENT_PER_G,
+                        reference.y / ADXL355_MEASUREMENT_PER_G,
+                        reference.z / ADXL355_MEASUREMENT_PER_G);
+        ADXL355Measurement average;
+        captured = captured && ADXL355Calibrator::captureStatic(
+                                   accel, average) ==
+                                   ADXL355Calibrator::CAPTURE_STATIC;
+        calibrator.addOrientation(average, reference);
+    }
+    ADXL355Calibration calibration;
+    bool solved = captured && calibrator.solve(calibration) &&
+                  accel.setCalibration(calibration);
+
+    // Orientations the calibration never saw, without noise
+    chip.setNoise(0);
+    double before = 0;
+    double after = 0;
+    srand(3);
+    for (int n = 0; n < 200; n++) {
+        double g[3];
+        double norm = 0;
+        for (int i = 0; i < 3; i++) {
+            g[i] = rand() / (double)RAND_MAX - 0.5;
+            norm += g[i] * g[i];
+        }
+        for (int i = 0; i < 3; i++) {
+            g[i] /= sqrt(norm);
+        }
+        chip.setGravity(g[0], g[1], g[2]);
+        delay(300);
+        long raw[3];
+        accel.readRaw(raw);
+        ADXL355Measurement nominal = accel.toMeasurement(raw, false);
+        ADXL355Measurement corrected = accel.toMeasurement(raw);
+        const double uncorrected[3] = {nominal.x, nominal.y, nominal.z};
+        const double fixed[3] = {corrected.x, corrected.y, corrected.z};
+        for (int i = 0; i < 3; i++) {
+            before = fmax(before, fabs(uncorrected[i] /
+                                           ADXL355_MEASUREMENT_PER_G -
+                                       g[i]));
+            after = fmax(after,
+                         fabs(fixed[i] / ADXL355_MEASUREMENT_PER_G - g[i]));
+        }
+    }
+
+    printf("Calibration: %s, max error %.2g g before, %.2g g after (limit "
+           "%.0e)\n",
+           solved ? "solved" : "NOT SOLVED", before, after, k_allowedErrorG);
+    return solved && after <= k_allowedErrorG;
+}
+
+/**
+ * @brief Captures from a chip that has died, and from one that is moving
+ *
+ * @return true if both captures say what went wrong, and the dead chip
+ * gives up after about k_sampleTimeoutMillis
+ */
+bool checkCaptureFailures()
+{
+    ADXL355Emulator dead(k_chipSelect - 1);
+    ADXL355 deadAccel(k_chipSelect - 1);
+    deadAccel.begin(ADXL355_RANGE_2G, ADXL355_FILTER_LPF_4HZ_ODR);
+    dead.setAlive(false);
+    ADXL355Measurement average;
+    unsigned long start = millis();
+    ADXL355Calibrator::CaptureResult deadResult =
+        ADXL355Calibrator::captureStatic(deadAccel, average);
+    unsigned long waited = millis() - start;
+
+    ShakenADXL355 shaken(k_chipSelect - 2);
+    ADXL355 shakenAccel(k_chipSelect - 2);
+    shakenAccel.begin(ADXL355_RANGE_2G, ADXL355_FILTER_LPF_4HZ_ODR);
+    ADXL355Calibrator::CaptureResult shakenResult =
+        ADXL355Calibrator::captureStatic(shakenAccel, average);
+
+    bool timedOut = deadResult == ADXL355Calibrator::CAPTURE_TIMEOUT &&
+                    waited >= ADXL355Calibrator::k_sampleTimeoutMillis &&
+                    waited < 2 * ADXL355Calibrator::k_sampleTimeoutMillis;
+    bool moved = shakenResult == ADXL355Calibrator::CAPTURE_MOVED;
+    printf("Capture:     dead chip %s after %lu ms, shaken chip %s\n",
+           timedOut ? "timed out" : "DID NOT TIME OUT", waited,
+           moved ? "moved" : "NOT MOVED");
+    return timedOut && moved;
+}
+} // namespace
+
+int main()
+{
+    bool ok = checkSolve();
+    ok = checkCaptureFailures() && ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,705 @@
+/**
+ * @file cantest.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Feeds the CAN stack byte streams that start in the middle of a
+ * frame, lose bytes or pick up noise, and checks what comes out of it. Also
+ * checks that bring-up doesn't go on past a command the module ignores, and
+ * runs the Transport Protocol between two stacks on an emulated bus, and
+ * reads the ACEINNA's configuration back through its acceptance filters.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "ACEINNASimulator.h"
+#include "LonganEmulator.h"
+
+#include "../../ACEINNAInclinometer.h"
+#include "../../CANInterface.h"
+#include "../../CANSAEJ1939Transport.h"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace {
+
+//! SSI2 from the ACEINNA, as the module sends it: ID, then data
+const byte k_ssi2Frame[12] = {0x18, 0xF0, 0x29, 0x80, 0x12, 0x34,
+                              0x7D, 0x56, 0x78, 0x7D, 0x00, 0x14};
+
+//! Matches PGN and source address, like J1939Interface::acceptOnly()
+constexpr unsigned long k_pgnSourceMask = 0x03FFFFFF;
+
+/**
+ * @brief A CAN module that answers OK to every AT command, and otherwise
+ * sends exactly the bytes it is given
+ */
+class ScriptedModule : public HardwareSerial {
+  public:
+    ScriptedModule() : ignoredCount(0), ignoredSeen(0){};
+
+    /**
+     * @brief Doesn't answer commands that start with a prefix
+     *
+     * @param prefix e.g. "AT+C"
+     * @param count how many of them to ignore, or -1 for all
+     */
+    void ignore(const char *prefix, int count)
+    {
+        ignoredPrefix = prefix;
+        ignoredCount = count;
+    };
+
+    //! How many commands with the ignored prefix were sent
+    int getIgnoredSeen() { return ignoredSeen; };
+
+    void feed(const std::vector<byte> &bytes)
+    {
+        rx.insert(rx.end(), bytes.begin(), bytes.end());
+    };
+
+    int available() override { return rx.size(); };
+    int peek() override { return rx.empty() ? -1 : rx.front(); };
+    int read() override
+    {
+        if (rx.empty()) {
+            return -1;
+        }
+        byte c = rx.front();
+        rx.pop_front();
+        return c;
+    };
+    int availableForWrite() override { return 64; };
+    void flush() override{};
+    size_t write(uint8_t c) override
+    {
+        if (c != '\n') {
+            line += (char)c;
+            return 1;
+        }
+        bool answer = true;
+        if (!ignoredPrefix.empty() && line.find(ignoredPrefix) == 0) {
+            ignoredSeen++;
+            answer = ignoredCount >= 0 && ignoredSeen > ignoredCount;
+        }
+        if (answer) {
+            const char ok[] = "OK\r\n";
+            rx.insert(rx.end(), ok, ok + 4);
+        }
+        line.clear();
+        return 1;
+    };
+    using Print::write;
+
+  private:
+    std::deque<byte> rx;
+    std::string line;
+    std::string ignoredPrefix;
+    int ignoredCount;
+    int ignoredSeen;
+};
+
+/**
+ * @brief What came out of one stream
+ */
+typedef struct {
+    //! Frames that match one that was sent
+    unsigned long frames;
+    //! Frames that don't match anything that was sent
+    unsigned long wrong;
+    //! Most wrong frames in a row, i.e. how long the parser stayed misaligned
+    unsigned long wrongRun;
+    unsigned long resyncs;
+    unsigned long discarded;
+} StreamResult;
+
+/**
+ * @brief Brings an interface up on a scripted module, feeds it a stream, and
+ * reads everything that comes out
+ *
+ * @param stream bytes the module sends once it is in data mode
+ * @param sent the frames the stream was made from
+ * @param filter if nonzero, the only ID the module is set up to forward
+ */
+StreamResult runStream(const std::vector<byte> &stream,
+                       const std::vector<std::vector<byte>> &sent,
+                       unsigned long filter)
+{
+    ScriptedModule module;
+    CAN::RawInterface can(module);
+    if (filter != 0) {
+        for (int i = CAN::mask_START; i < CAN::mask_END; i++) {
+            can.setMask((CAN::AcceptanceMask)i, k_pgnSourceMask);
+        }
+        for (int i = CAN::filter_START; i < CAN::filter_END; i++) {
+            can.setFilter((CAN::AcceptanceFilter)i, filter);
+        }
+    }
+    can.begin();
+    while (!can.step()) {
+        delay(1);
+    }
+
+    StreamResult result = {0, 0, 0, 0, 0};
+    unsigned long run = 0;
+    module.feed(stream);
+    CAN::ExtendedCanDataPacket p;
+    while (can.read(p)) {
+        std::vector<byte> frame(12);
+        for (int i = 0; i < 4; i++) {
+            frame[i] = p.id >> (24 - 8 * i);
+        }
+        memcpy(&frame[4], p.data, 8);
+        bool found = false;
+        for (const std::vector<byte> &s : sent) {
+            found = found || s == frame;
+        }
+        if (found) {
+            result.frames++;
+            run = 0;
+        }
+        else {
+            result.wrong++;
+            result.wrongRun = std::max(result.wrongRun, ++run);
+        }
+    }
+    result.resyncs = can.getResyncCount();
+    result.discarded = can.getDiscardedByteCount();
+    return result;
+}
+
+/**
+ * @brief Starts a stream of identical SSI2 frames some bytes into the first
+ * one. Only the filters can tell where these frames start, since bytes 10
+ * and 11 look like the start of an ID in every one of them.
+ *
+ * @return true if every whole frame came through, and nothing else
+ */
+bool checkOffsets()
+{
+    const int frames = 40;
+    std::vector<std::vector<byte>> sent(
+        1, std::vector<byte>(k_ssi2Frame, k_ssi2Frame + 12));
+    bool ok = true;
+    for (int skip = 1; skip < 12; skip++) {
+        std::vector<byte> stream;
+        for (int i = 0; i < frames; i++) {
+            stream.insert(stream.end(), k_ssi2Frame, k_ssi2Frame + 12);
+        }
+        stream.erase(stream.begin(), stream.begin() + skip);
+        StreamResult r = runStream(stream, sent, 0x18F02980);
+        printf("Offset %2d:  %2lu of %d frames, %lu wrong, %lu resyncs, %2lu "
+               "bytes discarded\n",
+               skip, r.frames, frames - 1, r.wrong, r.resyncs, r.discarded);
+        ok = ok && r.frames == frames - 1 && r.wrong == 0 &&
+             r.discarded == 12UL - skip;
+    }
+    return ok;
+}
+
+/**
+ * @brief Sends frames with random payloads, and now and then drops or
+ * inserts bytes between them
+ *
+ * The stream has no checksum, so now and then the bytes around a
+ * corruption happen to make up a plausible frame, and that frame comes out
+ * wrong. What matters is that the parser never stays misaligned.
+ *
+ * @param filtered if true, the module only forwards SSI2 and only SSI2 is
+ * sent. Otherwise three PGNs are mixed and nothing is filtered, so a frame
+ * start is only recognized by the top three bits of the ID.
+ * @return true if at most two frames were lost around each corruption, and
+ * wrong frames came out rarely and never more than one or two in a row
+ */
+bool checkCorruption(bool filtered)
+{
+    const unsigned long ids[] = {0x18F02980, 0x0CF02A80, 0x08F02D80};
+    const int frames = 3000;
+    const int corruptionPeriod = 17;
+
+    srand(filtered ? 1 : 2);
+    std::vector<std::vector<byte>> sent;
+    std::vector<byte> stream;
+    int events = 0;
+    for (int i = 0; i < frames; i++) {
+        unsigned long id = filtered ? ids[0] : ids[i % 3];
+        std::vector<byte> frame(12);
+        for (int j = 0; j < 4; j++) {
+            frame[j] = id >> (24 - 8 * j);
+        }
+        for (int j = 4; j < 12; j++) {
+            frame[j] = rand();
+        }
+        if (filtered) {
+            // Quality and latency bytes, which hardly ever change
+            frame[10] = 0x00;
+            frame[11] = 0x14;
+        }
+
+        if (i % corruptionPeriod == corruptionPeriod / 2) {
+            std::vector<byte> broken = frame;
+            int count = 1 + rand() % 11;
+            if (events % 2 == 0) {
+                // Lost in an RX overflow
+                int at = rand() % (13 - count);
+                broken.erase(broken.begin() + at,
+                             broken.begin() + at + count);
+            }
+            else {
+                // Noise on the line
+                for (int j = 0; j < count; j++) {
+                    broken.insert(broken.begin() + rand() % broken.size(),
+                                  (byte)rand());
+                }
+            }
+            stream.insert(stream.end(), broken.begin(), broken.end());
+            events++;
+            continue;
+        }
+        sent.push_back(frame);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    StreamResult r = runStream(stream, sent, filtered ? ids[0] : 0);
+    unsigned long lost = sent.size() - r.frames;
+    printf("%s %lu of %zu frames, %lu lost around %d corruptions, %lu "
+           "resyncs,\n            %lu wrong, at most %lu in a row\n",
+           filtered ? "Filtered:  " : "Unfiltered:", r.frames, sent.size(),
+           lost, events, r.resyncs, r.wrong, r.wrongRun);
+    if (filtered) {
+        return lost <= 2UL * events && r.wrong * 20 <= (unsigned long)events &&
+               r.wrongRun <= 1;
+    }
+    return lost <= 2UL * events && r.wrongRun <= 2;
+}
+
+/**
+ * @brief Sends single frames with quiet time in between, like replies to
+ * requests, the second one behind the tail of a frame that lost its start
+ *
+ * @return true if each frame came out without any more traffic behind it
+ */
+bool checkLoneFrames()
+{
+    ScriptedModule module;
+    CAN::RawInterface can(module);
+    can.begin();
+    while (!can.step()) {
+        delay(1);
+    }
+
+    std::vector<byte> frame(k_ssi2Frame, k_ssi2Frame + 12);
+    std::vector<byte> tail(k_ssi2Frame + 7, k_ssi2Frame + 12);
+    std::vector<byte> stream = tail;
+    stream.insert(stream.end(), frame.begin(), frame.end());
+
+    // Polled like a loop() would, for a few milliseconds each
+    CAN::ExtendedCanDataPacket p;
+    int first = 0;
+    module.feed(frame);
+    for (int i = 0; i < 5; i++, delay(1)) {
+        while (can.read(p)) {
+            first += p.id == 0x18F02980 ? 1 : 100;
+        }
+    }
+    int second = 0;
+    module.feed(stream);
+    for (int i = 0; i < 5; i++, delay(1)) {
+        while (can.read(p)) {
+            second += p.id == 0x18F02980 ? 1 : 100;
+        }
+    }
+
+    printf("Lone frames: first %s, second behind a broken one %s, %lu bytes "
+           "discarded\n",
+           first == 1 ? "read" : "NOT READ",
+           second == 1 ? "read" : "NOT READ",
+           can.getDiscardedByteCount());
+    return first == 1 && second == 1 &&
+           can.getDiscardedByteCount() == tail.size();
+}
+
+/**
+ * @brief Feeds frames in pieces, reading some of them only later
+ *
+ * @return true if each frame is stamped with the time its last byte was
+ * taken from the UART
+ */
+bool checkTimestamps()
+{
+    ScriptedModule module;
+    CAN::RawInterface can(module);
+    can.begin();
+    while (!can.step()) {
+        delay(1);
+    }
+
+    std::vector<byte> frame(k_ssi2Frame, k_ssi2Frame + 12);
+    std::vector<byte> head(k_ssi2Frame, k_ssi2Frame + 5);
+    std::vector<byte> tail(k_ssi2Frame + 5, k_ssi2Frame + 12);
+    unsigned long expected[4];
+
+    // Two whole frames taken in separate calls, then one split across two
+    module.feed(frame);
+    can.hasPacket();
+    expected[0] = micros();
+    delay(2);
+    module.feed(frame);
+    can.hasPacket();
+    expected[1] = micros();
+    delay(2);
+    module.feed(head);
+    can.hasPacket();
+    delay(2);
+    module.feed(tail);
+    module.feed(frame);
+    can.hasPacket();
+    expected[2] = micros();
+    expected[3] = expected[2];
+    delay(2);
+
+    CAN::ExtendedCanDataPacket p;
+    int frames = 0;
+    int wrong = 0;
+    while (can.read(p)) {
+        wrong += frames >= 4 || p.timestamp != expected[frames];
+        frames++;
+    }
+    printf("Timestamps: %d of 4 frames, %d stamped wrong\n", frames, wrong);
+    return frames == 4 && wrong == 0;
+}
+
+/**
+ * @brief Brings the interface up on a module that ignores some commands
+ *
+ * @return true if a command that is never answered fails bring-up after a
+ * few tries, and one that is answered on the second try doesn't
+ */
+bool checkBringup()
+{
+    ScriptedModule deaf;
+    deaf.ignore("AT+C", -1);
+    CAN::RawInterface failing(deaf);
+    failing.begin();
+    for (int i = 0; i < 1000 && !failing.step() && !failing.hasFailed(); i++) {
+        delay(1);
+    }
+
+    ScriptedModule flaky;
+    flaky.ignore("AT+C", 1);
+    CAN::RawInterface retrying(flaky);
+    retrying.begin();
+    for (int i = 0; i < 1000 && !retrying.step(); i++) {
+        delay(1);
+    }
+
+    printf("Bring-up:   AT+C never answered: %s after %d tries, answered on "
+           "try 2: %s\n",
+           failing.hasFailed() ? "failed" : "did not fail",
+           deaf.getIgnoredSeen(), retrying.isReady() ? "ready" : "not ready");
+    return failing.hasFailed() && !failing.isReady() &&
+           deaf.getIgnoredSeen() == 3 && retrying.isReady();
+}
+
+/**
+ * @brief Connects two emulated modules to the same bus. Every frame one of
+ * them sends shows up on the other one.
+ */
+class LinkNode : public EmulatedCanNode {
+  public:
+    LinkNode() : peer(NULL){};
+
+    void connect(LinkNode &other)
+    {
+        peer = &other;
+        other.peer = this;
+    };
+
+    unsigned long long nextFrameTime() override
+    {
+        return inbox.empty() ? ~0ULL : inbox.front().time;
+    };
+    void nextFrame(EmulatedCanFrame &frame) override
+    {
+        frame = inbox.front();
+        inbox.pop_front();
+    };
+    void onFrame(const EmulatedCanFrame &frame) override
+    {
+        if (peer != NULL) {
+            peer->inbox.push_back(frame);
+        }
+    };
+
+  private:
+    LinkNode *peer;
+    std::deque<EmulatedCanFrame> inbox;
+};
+
+/**
+ * @brief Two J1939 stacks on one emulated bus. Node A runs a transport,
+ * node B runs one too, and also records the connection management frames
+ * it is sent, so a test can play a misbehaving peer from B.
+ */
+class TransportLoop {
+  public:
+    static constexpr byte k_addressA = 0x21;
+    static constexpr byte k_addressB = 0x42;
+    static constexpr unsigned long k_PGN = 0xEF00;
+
+    TransportLoop()
+        : received(false), receivedLength(0), moduleA(9600), moduleB(9600),
+          busA(moduleA), busB(moduleB), tpA(busA, k_addressA),
+          tpB(busB, k_addressB)
+    {
+        linkA.connect(linkB);
+        moduleA.addNode(&linkA);
+        moduleB.addNode(&linkB);
+        tpA.begin();
+        tpB.begin();
+        tpB.setReceiveHandler(onMessage, this);
+        busA.begin();
+        busB.begin();
+        for (int i = 0; i < 2000 && !(busA.step() && busB.step()); i++) {
+            delay(1);
+        }
+    };
+
+    bool isUp() { return busA.isReady() && busB.isReady(); };
+
+    /**
+     * @brief Runs both stacks for a while
+     *
+     * @param millis simulated time to run for
+     * @param untilReceived stop as soon as B has a complete message
+     */
+    void run(unsigned long millis, bool untilReceived)
+    {
+        for (unsigned long i = 0; i < millis; i++) {
+            busA.poll();
+            busB.poll();
+            tpA.step();
+            tpB.step();
+            if (untilReceived && received) {
+                return;
+            }
+            delay(1);
+        }
+    };
+
+    //! Stops B's transport from answering, so B can be played by hand
+    void takeOverB()
+    {
+        busB.registerHandler(CAN::J1939Transport::PGN_TP_CM | k_addressB,
+                             onControl, this);
+    };
+
+    //! Sends a connection management frame from B to A
+    void sendControlFromB(const byte *payload)
+    {
+        busB.write(CAN::J1939Message(
+                       CAN::J1939ID(7, k_addressB,
+                                    CAN::J1939Transport::PGN_TP_CM),
+                       payload, 8),
+                   k_addressA);
+    };
+
+    CAN::J1939Transport &getA() { return tpA; };
+
+    bool received;
+    byte receivedData[CAN::J1939Transport::k_maxMessageSize];
+    unsigned int receivedLength;
+    std::vector<std::vector<byte>> controlFrames;
+
+  private:
+    LonganEmulator moduleA;
+    LonganEmulator moduleB;
+    LinkNode linkA;
+    LinkNode linkB;
+    CAN::J1939Interface busA;
+    CAN::J1939Interface busB;
+    CAN::J1939Transport tpA;
+    CAN::J1939Transport tpB;
+
+    static void onMessage(unsigned long PGN, byte source, const byte *data,
+                          unsigned int length, void *context)
+    {
+        TransportLoop *loop = (TransportLoop *)context;
+        loop->received = PGN == k_PGN && source == k_addressA;
+        memcpy(loop->receivedData, data, length);
+        loop->receivedLength = length;
+    };
+
+    static void onControl(const CAN::J1939Message &m, void *context)
+    {
+        ((TransportLoop *)context)
+            ->controlFrames.push_back(std::vector<byte>(m.data, m.data + 8));
+    };
+};
+
+/**
+ * @brief Sends messages of several sizes from A to B, directed (RTS/CTS) and
+ * broadcast (BAM)
+ *
+ * @return true if every message up to the largest size arrived intact, and
+ * the one past it was refused
+ */
+bool checkTransportLoopback()
+{
+    const unsigned int sizes[] = {9, 50, 112, 113};
+    bool ok = true;
+    for (int broadcast = 0; broadcast < 2; broadcast++) {
+        printf("%s", broadcast ? "BAM:    " : "RTS/CTS:");
+        for (unsigned int size : sizes) {
+            TransportLoop loop;
+            if (!loop.isUp()) {
+                printf(" CAN modules did not come up\n");
+                return false;
+            }
+            byte data[128];
+            for (unsigned int i = 0; i < size; i++) {
+                data[i] = (byte)(i * 7 + size);
+            }
+            byte dest = broadcast ? 0xFF : TransportLoop::k_addressB;
+            unsigned long start = millis();
+            bool started = loop.getA().send(TransportLoop::k_PGN, dest, data,
+                                            size);
+            loop.run(5000, true);
+            // Let the end of message acknowledgement through
+            loop.run(50, false);
+
+            bool fits = size <= CAN::J1939Transport::k_maxMessageSize;
+            bool intact = loop.received && loop.receivedLength == size &&
+                          memcmp(loop.receivedData, data, size) == 0;
+            if (!fits) {
+                printf(" %u bytes %s", size,
+                       started ? "sent anyway" : "refused");
+                ok = ok && !started && !loop.received;
+            }
+            else {
+                printf(" %u bytes %s in %lu ms,", size,
+                       intact ? "arrived" : "LOST", millis() - start - 50);
+                ok = ok && started && intact && !loop.getA().isSending();
+            }
+        }
+        printf("\n");
+    }
+    return ok;
+}
+
+/**
+ * @brief Plays a peer that gets the connection management wrong
+ *
+ * @return true if A aborts each of these connections, instead of waiting
+ * for a timeout or sending data it was never asked for
+ */
+bool checkTransportErrors()
+{
+    const byte pgn[3] = {TransportLoop::k_PGN & 0xFF,
+                         TransportLoop::k_PGN >> 8 & 0xFF, 0};
+
+    // An RTS for 50 bytes (8 packets) that only announces 2. A used to
+    // accept it, and after packet 2 it asked for no packets at all.
+    TransportLoop shortRTS;
+    shortRTS.takeOverB();
+    const byte rts[8] = {16, 50, 0, 2, 0xFF, pgn[0], pgn[1], pgn[2]};
+    shortRTS.sendControlFromB(rts);
+    shortRTS.run(100, false);
+    bool shortAborted = shortRTS.controlFrames.size() == 1 &&
+                        shortRTS.controlFrames[0][0] == 255;
+
+    // A CTS that names another PGN
+    byte data[50] = {0};
+    TransportLoop wrongPGN;
+    wrongPGN.takeOverB();
+    wrongPGN.getA().send(TransportLoop::k_PGN, TransportLoop::k_addressB, data,
+                         sizeof(data));
+    wrongPGN.run(100, false);
+    const byte cts[8] = {17, 8, 1, 0xFF, 0xFF, 0x00, 0xFE, 0};
+    wrongPGN.sendControlFromB(cts);
+    wrongPGN.run(100, false);
+    bool pgnAborted = !wrongPGN.getA().isSending() &&
+                      !wrongPGN.controlFrames.empty() &&
+                      wrongPGN.controlFrames.back()[0] == 255;
+
+    // A CTS whose window runs past packet 255, which used to wrap around
+    // into a window inside the message
+    TransportLoop wrapping;
+    wrapping.takeOverB();
+    wrapping.getA().send(TransportLoop::k_PGN, TransportLoop::k_addressB, data,
+                         sizeof(data));
+    wrapping.run(100, false);
+    const byte wrap[8] = {17, 10, 250, 0xFF, 0xFF, pgn[0], pgn[1], pgn[2]};
+    wrapping.sendControlFromB(wrap);
+    wrapping.run(100, false);
+    bool wrapAborted = !wrapping.getA().isSending() &&
+                       !wrapping.controlFrames.empty() &&
+                       wrapping.controlFrames.back()[0] == 255;
+
+    printf("TP errors: short RTS %s, CTS for another PGN %s, CTS window past "
+           "255 %s\n",
+           shortAborted ? "aborted" : "NOT ABORTED",
+           pgnAborted ? "aborted" : "NOT ABORTED",
+           wrapAborted ? "aborted" : "NOT ABORTED");
+    return shortAborted && pgnAborted && wrapAborted;
+}
+
+/**
+ * @brief Reads back the enabled data types from a simulated ACEINNA through
+ * the acceptance filters ACEINNAInclinometer sets, answered as 0xEFB6 like
+ * the MTLT and as 0xEF11 like J1939 addresses it
+ *
+ * @return true if both answers get through the filters to the requester
+ */
+bool checkReadbackFilter()
+{
+    const byte enabled = Inclinometer::ACEINNAInclinometer::DATA_SSI2 |
+                         Inclinometer::ACEINNAInclinometer::DATA_ANGULAR_RATE;
+    bool arrived[2];
+    unsigned long filtered = 0;
+    for (int addressed = 0; addressed < 2; addressed++) {
+        LonganEmulator module;
+        ACEINNASimulator sensor;
+        sensor.setDataTypes(enabled);
+        sensor.setAddressedReplies(addressed);
+        module.addNode(&sensor);
+        Inclinometer::ACEINNAInclinometer inclinometer(module);
+        inclinometer.begin();
+
+        unsigned long start = millis();
+        while (millis() - start < 5000 &&
+               inclinometer.getEnabledDataTypes() < 0) {
+            inclinometer.hasData();
+            delay(1);
+        }
+        arrived[addressed] = inclinometer.getEnabledDataTypes() == enabled;
+        filtered += module.getStats().filteredFrames;
+    }
+
+    // The sensor only sends what the filters should let through
+    printf("Readback through filters: 0xEFB6 %s, 0xEF11 %s, %lu frames "
+           "filtered out\n",
+           arrived[0] ? "arrived" : "LOST", arrived[1] ? "arrived" : "LOST",
+           filtered);
+    return arrived[0] && arrived[1] && filtered == 0;
+}
+} // namespace
+
+int main()
+{
+    bool ok = checkBringup();
+    ok = checkOffsets() && ok;
+    ok = checkCorruption(true) && ok;
+    ok = checkCorruption(false) && ok;
+    ok = checkLoneFrames() && ok;
+    ok = checkTimestamps() && ok;
+    ok = checkTransportLoopback() && ok;
+    ok = checkTransportErrors() && ok;
+    ok = checkReadbackFilter() && ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
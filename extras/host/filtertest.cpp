@@ -0,0 +1,248 @@
+/**
+ * @file filtertest.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Checks the filters in Filters.h: Fixed<> against double, the
+ * biquad's response, the median on spikes, DtEwma over uneven steps and
+ * Chain against its stages run by hand
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "../../Filters.h"
+
+namespace {
+
+typedef Filter::Fixed<16> Fixed16;
+
+//! Largest difference allowed between a fixed point and a double biquad, on
+//! angles in radians
+constexpr double k_allowedFixedBiquadError = 4e-4;
+
+//! Largest tilt the sketch works with, the +-10 degree envelope (radians)
+constexpr double k_envelope = 10 * PI / 180;
+
+//! Largest error of one Fixed<16> operation, a little over one LSB
+constexpr double k_allowedFixedError = 2.0 / (1L << 16);
+
+/**
+ * @brief A slow signal, the kind of tilt the filters see
+ */
+double slow(int n) { return 0.5 * sin(n * 0.01) + 0.2 * cos(n * 0.0037); }
+
+/**
+ * @brief Checks Fixed<16> arithmetic against double, on values the size of
+ * angles and alphas and on products that need the 64 bit intermediate
+ */
+bool checkFixed()
+{
+    const double values[] = {-300.25, -2.5, -0.3, -1e-4, 0.0, 1e-4,
+                             0.7071,  1.0,  3.14159, 150.0, 199.5};
+    const int count = sizeof(values) / sizeof(values[0]);
+    double maxError = 0;
+    for (int i = 0; i < count; i++) {
+        Fixed16 a(values[i]);
+        maxError = fmax(maxError, fabs(a.toDouble() - values[i]));
+        for (int j = 0; j < count; j++) {
+            Fixed16 b(values[j]);
+            double x = a.toDouble();
+            double y = b.toDouble();
+            maxError = fmax(maxError, fabs((a + b).toDouble() - (x + y)));
+            maxError = fmax(maxError, fabs((a - b).toDouble() - (x - y)));
+            if (fabs(x * y) < 30000) {
+                maxError = fmax(maxError, fabs((a * b).toDouble() - x * y));
+            }
+            if (fabs(y) >= 0.1 && fabs(x / y) < 30000) {
+                maxError = fmax(maxError, fabs((a / b).toDouble() - x / y));
+            }
+        }
+    }
+    // Rounds to the nearest on both sides of zero
+    bool rounded = Fixed16(0.6 / (1L << 16)).getRaw() == 1 &&
+                   Fixed16(-0.6 / (1L << 16)).getRaw() == -1;
+
+    printf("Fixed<16>:  max error %.2g (limit %.2g), %s\n", maxError,
+           k_allowedFixedError, rounded ? "rounds to nearest" : "ROUNDING");
+    return maxError <= k_allowedFixedError && rounded;
+}
+
+/**
+ * @brief Runs a Butterworth low pass at 100 Hz in double and in fixed point,
+ * on noisy angles over the envelope
+ *
+ * @param cutoff -3 dB frequency (Hz)
+ * @return double the largest difference between the two (radians)
+ */
+template <byte Bits> double fixedBiquadError(float cutoff)
+{
+    typedef Filter::Biquad<Filter::Fixed<Bits>> FixedBiquad;
+    Filter::Biquad<double> exact = Filter::Biquad<double>::lowPass(cutoff, 100);
+    FixedBiquad fixed = FixedBiquad::lowPass(cutoff, 100);
+    srand(5);
+    double error = 0;
+    for (int n = 0; n < 20000; n++) {
+        double x = k_envelope * (slow(n) / 0.7 +
+                                 0.05 * (rand() / (double)RAND_MAX - 0.5));
+        double y = exact.add(x);
+        error = fmax(error, fabs(fixed.add(x).toDouble() - y));
+    }
+    return error;
+}
+
+/**
+ * @brief Checks fixed point biquads against double, and what a 2 Hz low
+ * pass at 100 Hz passes and stops
+ *
+ * @return true if Fixed<16> tracks double within k_allowedFixedBiquadError
+ * at a 5 Hz cutoff and Fixed<20> does at 1 Hz (see Fixed), a step settles
+ * at 1 (to the float coefficients), reset() starts settled, and a 25 Hz
+ * tone comes out below 2 %
+ */
+bool checkBiquad()
+{
+    double fixedError = fixedBiquadError<16>(5);
+    double finerError = fixedBiquadError<20>(1);
+
+    Filter::Biquad<double> step = Filter::Biquad<double>::lowPass(2, 100);
+    for (int n = 0; n < 500; n++) {
+        step.add(1.0);
+    }
+    Filter::Biquad<double> settled = Filter::Biquad<double>::lowPass(2, 100);
+    settled.reset(0.25);
+    double start = settled.get();
+    double resetError = fabs(settled.add(0.25) - start);
+
+    Filter::Biquad<double> tone = Filter::Biquad<double>::lowPass(2, 100);
+    double toneAmplitude = 0;
+    for (int n = 0; n < 1000; n++) {
+        double y = tone.add(sin(2 * PI * 25 * n / 100.0 + 0.3));
+        if (n >= 500) {
+            toneAmplitude = fmax(toneAmplitude, fabs(y));
+        }
+    }
+
+    printf("Biquad:     Fixed<16> at 5 Hz within %.2g of double, Fixed<20> "
+           "at 1 Hz within\n            %.2g (limit %.0e), step at %.6f, "
+           "reset off by %.2g, 25 Hz\n            passed at %.2g %%\n",
+           fixedError, finerError, k_allowedFixedBiquadError, step.get(),
+           resetError, toneAmplitude * 100);
+    return fixedError <= k_allowedFixedBiquadError &&
+           finerError <= k_allowedFixedBiquadError &&
+           fabs(step.get() - 1) < 1e-5 && resetError < 1e-9 &&
+           toneAmplitude < 0.02;
+}
+
+/**
+ * @brief Puts single and double spikes on a slow signal
+ *
+ * @return true if a Median<5> takes them all out without an EWMA's
+ * smearing, and odd windows are the middle value while it fills
+ */
+bool checkMedian()
+{
+    Filter::Median<5, double> median;
+    Filter::Ewma<double> ewma(0.2);
+    median.reset(slow(0));
+    ewma.reset(slow(0));
+    double medianError = 0;
+    double ewmaError = 0;
+    for (int n = 1; n < 5000; n++) {
+        double x = slow(n);
+        if (n % 97 == 0 || n % 211 == 0 || n % 211 == 1) {
+            x += (n % 2) ? 1.0 : -1.0;
+        }
+        // Both lag the signal a little, the spikes are what's measured
+        medianError = fmax(medianError, fabs(median.add(x) - slow(n - 2)));
+        ewmaError = fmax(ewmaError, fabs(ewma.add(x) - slow(n)));
+    }
+
+    Filter::Median<3, double> filling;
+    bool fills = filling.add(3) == 3 && filling.add(1) == 3 &&
+                 filling.add(2) == 2 && filling.add(9) == 2;
+
+    printf("Median:     spikes of 1 leave %.2g (an EWMA leaves %.2g), %s\n",
+           medianError, ewmaError, fills ? "fills right" : "FILLS WRONG");
+    return medianError < 0.01 && fills;
+}
+
+/**
+ * @brief Steps a DtEwma over even and uneven sample times
+ *
+ * @return true if the same time covered in different steps gives close to
+ * the same result, close to 1 - e^(-t / tau), add() without dt uses the
+ * sample period, and a very long gap jumps to the sample
+ */
+bool checkDtEwma()
+{
+    const float tau = 0.5;
+    Filter::DtEwma<double> even(tau, 0.01);
+    Filter::DtEwma<double> uneven(tau, 0.01);
+    Filter::DtEwma<double> implicit(tau, 0.01);
+    double time = 0;
+    for (int n = 0; n < 100; n++) {
+        even.add(1.0, 0.01);
+        implicit.add(1.0);
+    }
+    // 1 s in steps of 2 to 18 ms
+    for (int n = 0; time < 1.0 - 1e-9; n++) {
+        float dt = fmin(0.002 * (1 + n % 9), 1.0 - time);
+        uneven.add(1.0, dt);
+        time += dt;
+    }
+    double expected = 1 - exp(-1.0 / tau);
+    double spread = fabs(even.get() - uneven.get());
+    double error = fmax(fabs(even.get() - expected),
+                        fabs(uneven.get() - expected));
+
+    Filter::DtEwma<double> gap(tau, 0.01);
+    gap.add(2.0, 1e6);
+
+    printf("DtEwma:     1 s in even and uneven steps %.2g apart, %.2g from "
+           "1 - e^(-t/tau)\n",
+           spread, error);
+    return spread < 0.005 && error < 0.01 &&
+           implicit.get() == even.get() && fabs(gap.get() - 2.0) < 1e-5;
+}
+
+/**
+ * @brief Runs a Chain<Median<3>, Biquad<>> next to the same two filters
+ * called by hand
+ *
+ * @return true if both give the same result, and reset() settles the whole
+ * chain
+ */
+bool checkChain()
+{
+    typedef Filter::Median<3, double> Spikes;
+    typedef Filter::Biquad<double> Smooth;
+    Filter::Chain<Spikes, Smooth> chain(Spikes(), Smooth::lowPass(2, 100));
+    Spikes spikes;
+    Smooth smooth = Smooth::lowPass(2, 100);
+    double difference = 0;
+    for (int n = 0; n < 2000; n++) {
+        double x = slow(n) + ((n % 50 == 0) ? 1.0 : 0.0);
+        difference = fmax(difference,
+                          fabs(chain.add(x) - smooth.add(spikes.add(x))));
+    }
+    chain.reset(0.75);
+    double start = chain.get();
+    double settled = fabs(chain.add(0.75) - start);
+
+    printf("Chain:      %.2g from the stages by hand, reset off by %.2g\n",
+           difference, settled);
+    return difference == 0 && settled < 1e-9;
+}
+} // namespace
+
+int main()
+{
+    bool ok = checkFixed();
+    ok = checkBiquad() && ok;
+    ok = checkMedian() && ok;
+    ok = checkDtEwma() && ok;
+    ok = checkChain() && ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
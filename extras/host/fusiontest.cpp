@@ -0,0 +1,284 @@
+/**
+ * @file fusiontest.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Fuses a simulated ACEINNA with an ADXL355Inclinometer on an
+ * emulated ADXL355 while both are tilted, and checks the weights, the error
+ * and the parity check
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "ADXL355Emulator.h"
+
+#include "../../ADXL355Inclinometer.h"
+#include "../../FaultHandling.h"
+#include "../../FusedInclinometer.h"
+
+namespace {
+
+using Inclinometer::Sample;
+using Rotation::Vec2;
+
+constexpr double k_degrees = 180.0 / PI;
+
+constexpr uint8_t k_chipSelect = 53;
+
+//! Noise of the primary, the same as the estimator assumes for the ACEINNA
+constexpr double k_primaryNoiseDegrees = 0.01;
+
+//! Noise of the ADXL355, about as much tilt as the primary's
+constexpr double k_secondaryNoiseG = 0.0002;
+
+//! How long both sit level before tilting, for the noise estimates
+constexpr unsigned long long k_levelMicros = 10000000ULL;
+
+//! How long they tilt for
+constexpr unsigned long long k_tiltMicros = 20000000ULL;
+
+//! Largest mean error allowed while tilting, on the first axis (degrees)
+constexpr double k_allowedBiasDegrees = 0.005;
+
+//! Least of the samples that have to be fused while tilting
+constexpr double k_minimumFusedFraction = 0.95;
+
+//! Range the primary's mean weight has to be in. The secondary is about as
+//! noisy, and more so while it is extrapolated, so the primary should have
+//! the larger share, but not all of it.
+constexpr double k_minimumPrimaryWeight = 0.5;
+constexpr double k_maximumPrimaryWeight = 0.9;
+
+/**
+ * @brief Level, then tilting about the first axis at a steady rate
+ */
+class Ramp {
+  public:
+    Ramp(double degreesPerSecond, unsigned long long start)
+        : rate(degreesPerSecond / k_degrees), start(start){};
+
+    //! Tilt at a moment in time (radians)
+    double at(unsigned long long micros) const
+    {
+        return (micros > start) ? rate * (micros - start) * 1e-6 : 0;
+    };
+
+    unsigned long long getStart() const { return start; };
+
+  private:
+    double rate;
+    unsigned long long start;
+};
+
+/**
+ * @brief An accelerometer on the ramp
+ */
+class RampADXL355 : public ADXL355Emulator {
+  public:
+    RampADXL355(uint8_t cs, const Ramp &ramp)
+        : ADXL355Emulator(cs), ramp(ramp){};
+
+  protected:
+    void acceleration(unsigned long long micros, double *g) override
+    {
+        g[0] = 0;
+        g[1] = sin(ramp.at(micros));
+        g[2] = cos(ramp.at(micros));
+    };
+
+  private:
+    const Ramp &ramp;
+};
+
+/**
+ * @brief Stands in for the ACEINNA: a sample every 10 ms, which arrives
+ * 2 ms after it was measured and says so in its latency
+ */
+class SimulatedACEINNA final : public Inclinometer::InclinometerDataSource {
+  public:
+    static constexpr unsigned long k_period = 10000;
+    static constexpr unsigned int k_latency = 2000;
+
+    SimulatedACEINNA(const Ramp &ramp, double offsetDegrees)
+        : ramp(ramp), offset(offsetDegrees / k_degrees), generator(2),
+          next(0), timestamp(0){};
+
+    bool begin() override
+    {
+        next = hostMicros() + k_period;
+        return true;
+    };
+    bool hasData() override { return hostMicros() >= next + k_latency; };
+    Vec2 getData() override
+    {
+        Sample sample;
+        readAll(&sample, 1);
+        return sample.angles;
+    };
+    unsigned long getTimestamp() override { return timestamp; };
+    unsigned long getSamplePeriod() override { return k_period; };
+    byte readAll(Sample *samples, byte capacity) override
+    {
+        const double noise = k_primaryNoiseDegrees / k_degrees;
+        byte count = 0;
+        while (count < capacity && hasData()) {
+            Sample &sample = samples[count++];
+            sample.angles =
+                Vec2(ramp.at(next) + offset + noise * normal(generator),
+                     noise * normal(generator));
+            timestamp = next + k_latency;
+            sample.timestamp = timestamp;
+            sample.quality.figureOfMerit = Inclinometer::MERIT_FULL;
+            sample.quality.compensation = Inclinometer::COMPENSATION_ON;
+            sample.quality.latency = k_latency;
+            next += k_period;
+        }
+        return count;
+    };
+    bool getRates(Inclinometer::RateSample &) override { return false; };
+
+  private:
+    const Ramp &ramp;
+    double offset;
+    std::mt19937 generator;
+    std::normal_distribution<double> normal;
+    unsigned long long next;
+    unsigned long timestamp;
+};
+
+/**
+ * @brief What came out of the fused source while tilting
+ */
+typedef struct {
+    bool started;
+    bool secondaryRunning;
+    unsigned long samples;
+    unsigned long fused;
+    double weightSum;
+    double errorSum;
+    double squaredErrorSum;
+    bool parityFault;
+    bool majorFault;
+} RunResult;
+
+/**
+ * @brief Runs the two sensors on a ramp, polling them every millisecond
+ * like the loop does
+ *
+ * @param degreesPerSecond rate of tilt after the level period
+ * @param offsetDegrees how far the primary reads off, once aligned
+ * @param secondaryAlive false for an ADXL355 that never answers
+ */
+RunResult run(double degreesPerSecond, double offsetDegrees,
+              bool secondaryAlive)
+{
+    Ramp ramp(degreesPerSecond, hostMicros() + k_levelMicros);
+    RampADXL355 chip(k_chipSelect, ramp);
+    chip.setNoise(k_secondaryNoiseG);
+    chip.setAlive(secondaryAlive);
+    SimulatedACEINNA aceinna(ramp, offsetDegrees);
+    Inclinometer::ADXL355Inclinometer accelerometer(
+        k_chipSelect, -1, 1.0, ADXL355_FILTER_LPF_4HZ_ODR);
+    Inclinometer::FusedInclinometer fused(
+        aceinna, &accelerometer, Angle::fromDegrees(0.5), 2000);
+
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+    result.started = fused.begin();
+    result.secondaryRunning = fused.isSecondaryRunning();
+
+    // Both sensors level, in the same frame
+    Inclinometer::Model<> frame;
+    Inclinometer::ModelZeropoint level = frame.setMeasurementAsZero(Vec2(0, 0));
+    fused.setAlignment(level, level);
+
+    unsigned long long end = ramp.getStart() + k_tiltMicros;
+    while (hostMicros() < end) {
+        delay(1);
+        Sample batch[8];
+        byte count = fused.readAll(batch, 8);
+        if (count == 0 || hostMicros() < ramp.getStart()) {
+            continue;
+        }
+        // Every sample of the batch went through fuse(), only the newest
+        // says whether it was fused
+        const Sample &sample = batch[count - 1];
+        double measured = ramp.at(sample.timestamp - sample.quality.latency);
+        double error = (sample.angles[0] - measured) * k_degrees;
+        result.samples++;
+        result.errorSum += error;
+        result.squaredErrorSum += error * error;
+        if (fused.isFused()) {
+            result.fused++;
+            result.weightSum += fused.getPrimaryWeight();
+        }
+    }
+
+    Fault::Handler *faults = Fault::Handler::instance();
+    result.parityFault = faults->nextFault(Fault::ACCEL_PARITY_FAILURE) ==
+                         Fault::ACCEL_PARITY_FAILURE;
+    result.majorFault = faults->hasMajorFault();
+    faults->unlatchFaultCode(Fault::ACCEL_PARITY_FAILURE);
+    return result;
+}
+
+/**
+ * @brief Tilts both sensors at a steady rate
+ *
+ * @return true if nearly every sample was fused, the primary had a fair
+ * share of the weight, the result is less noisy than the primary alone and
+ * doesn't lag, and the two were never taken to disagree
+ */
+bool checkRamp(double degreesPerSecond)
+{
+    RunResult result = run(degreesPerSecond, 0, true);
+    double fusedFraction = (double)result.fused / result.samples;
+    double weight = result.fused ? result.weightSum / result.fused : 1;
+    double bias = result.errorSum / result.samples;
+    double rms = sqrt(result.squaredErrorSum / result.samples);
+
+    printf("Ramp %.2f deg/s: %lu of %lu fused, primary weight %.2f, error "
+           "%+.4f deg mean,\n                 %.4f deg RMS (primary alone "
+           "%.4f)%s\n",
+           degreesPerSecond, result.fused, result.samples, weight, bias, rms,
+           k_primaryNoiseDegrees,
+           result.parityFault ? ", PARITY FAULT" : "");
+    return fusedFraction >= k_minimumFusedFraction &&
+           weight >= k_minimumPrimaryWeight &&
+           weight <= k_maximumPrimaryWeight &&
+           fabs(bias) <= k_allowedBiasDegrees && rms < k_primaryNoiseDegrees &&
+           !result.parityFault;
+}
+
+/**
+ * @brief Runs a primary that reads 1 degree off, and a secondary that
+ * doesn't answer
+ *
+ * @return true if the first raises the parity fault without fusing, and
+ * the second runs on the primary alone without a fatal fault
+ */
+bool checkFailures()
+{
+    RunResult disagreeing = run(0.2, 1.0, true);
+    bool caught = disagreeing.parityFault && disagreeing.fused == 0;
+
+    RunResult dead = run(0.2, 0, false);
+    bool alone = dead.started && !dead.secondaryRunning &&
+                 dead.samples > 0 && dead.fused == 0 && !dead.majorFault;
+
+    printf("Failures:        1 deg apart %s, dead ADXL355 %s\n",
+           caught ? "raised the parity fault" : "NOT CAUGHT",
+           alone ? "left out" : "NOT LEFT OUT");
+    return caught && alone;
+}
+} // namespace
+
+int main()
+{
+    bool ok = checkRamp(0.2);
+    ok = checkRamp(0.25) && ok;
+    ok = checkFailures() && ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file mathbench.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Checks the FastMath kernels against libm over the tilt range, and
+ * times them against libm
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "../../FastMath.h"
+
+#include <chrono>
+
+namespace {
+
+constexpr double k_degrees = 180.0 / PI;
+
+//! Largest error we accept, well under the 0.05 degree deadband
+constexpr double k_allowedErrorDegrees = 0.005;
+
+volatile float sink;
+
+double wallNanos()
+{
+    return std::chrono::duration<double, std::nano>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Sweeps pitch and roll over +-range at the given magnitude, and
+ * returns the largest error against the libm formula the sketch used before
+ */
+double sweepTilt(double rangeDegrees, double stepDegrees, double magnitude)
+{
+    double maxError = 0;
+    for (double p = -rangeDegrees; p <= rangeDegrees; p += stepDegrees) {
+        for (double r = -rangeDegrees; r <= rangeDegrees; r += stepDegrees) {
+            float x = -magnitude * sin(r / k_degrees);
+            float y = magnitude * cos(r / k_degrees) * sin(p / k_degrees);
+            float z = magnitude * cos(r / k_degrees) * cos(p / k_degrees);
+
+            double pitch = atan((double)y / z);
+            double roll =
+                atan(-(double)x / sqrt((double)y * y + (double)z * z));
+            float fastPitch, fastRoll;
+            FastMath::tiltFromGravity(x, y, z, fastPitch, fastRoll);
+
+            maxError = fmax(maxError, fabs(fastPitch - pitch) * k_degrees);
+            maxError = fmax(maxError, fabs(fastRoll - roll) * k_degrees);
+        }
+    }
+    return maxError;
+}
+
+double sweepAtan2()
+{
+    double maxError = 0;
+    for (int i = 0; i < 3600000; i++) {
+        double angle = -PI + i * (2 * PI / 3600000);
+        float y = sin(angle);
+        float x = cos(angle);
+        maxError =
+            fmax(maxError, fabs(FastMath::atan2(y, x) - atan2((double)y, x)));
+    }
+    return maxError;
+}
+
+double sweepInvSqrt()
+{
+    double maxError = 0;
+    for (double v = 1e-6; v < 1e6; v *= 1.0001) {
+        double exact = 1.0 / sqrt((double)(float)v);
+        maxError =
+            fmax(maxError, fabs(FastMath::invSqrt((float)v) - exact) / exact);
+    }
+    return maxError;
+}
+
+/**
+ * @brief Times tilt calculations over a set of inputs, in ns per call
+ */
+template <typename F> double timeTilt(F tilt)
+{
+    constexpr int k_inputs = 1024;
+    constexpr int k_rounds = 2000;
+    float x[k_inputs], y[k_inputs], z[k_inputs];
+    for (int i = 0; i < k_inputs; i++) {
+        double p = (i % 61 - 30) / k_degrees;
+        double r = (i % 59 - 29) / k_degrees;
+        x[i] = -16 * sin(r);
+        y[i] = 16 * cos(r) * sin(p);
+        z[i] = 16 * cos(r) * cos(p);
+    }
+    double start = wallNanos();
+    for (int round = 0; round < k_rounds; round++) {
+        for (int i = 0; i < k_inputs; i++) {
+            float pitch, roll;
+            tilt(x[i], y[i], z[i], pitch, roll);
+            sink = pitch + roll;
+        }
+    }
+    return (wallNanos() - start) / ((double)k_inputs * k_rounds);
+}
+
+void libmTilt(float x, float y, float z, float &pitch, float &roll)
+{
+    // What ADXL355Inclinometer::getData() did before
+    float scale = sqrt(pow(x / 16.0, 2) + pow(y / 16.0, 2) + pow(z / 16.0, 2));
+    float nx = x / scale, ny = y / scale, nz = z / scale;
+    pitch = atan(ny / nz);
+    roll = atan(-nx / sqrt(pow(ny, 2) + pow(nz, 2)));
+}
+} // namespace
+
+int main()
+{
+    double tiltError = 0;
+    // Around 1 g in the ADXL355Inclinometer's units, and the plausibility
+    // band's limits
+    const double magnitudes[] = {16.0, 12.0, 20.0, 1.0};
+    for (double magnitude : magnitudes) {
+        tiltError = fmax(tiltError, sweepTilt(30.0, 0.02, magnitude));
+    }
+    double atanError = sweepAtan2();
+    double invSqrtError = sweepInvSqrt();
+
+    printf("tiltFromGravity: max error %.6f deg over +-30 deg (limit %.3f)\n",
+           tiltError, k_allowedErrorDegrees);
+    printf("atan2:           max error %.3g rad (documented %.3g)\n",
+           atanError, (double)FastMath::k_atan2MaxError);
+    printf("invSqrt:         max relative error %.3g (documented %.3g)\n",
+           invSqrtError, (double)FastMath::k_invSqrtMaxRelativeError);
+
+    double fast = timeTilt(FastMath::tiltFromGravity);
+    double libm = timeTilt(libmTilt);
+    printf("Host time per tilt: %.1f ns fast, %.1f ns libm (%.1fx). AVR "
+           "soft-float\nratios differ, time it there with micros() over a "
+           "batch.\n",
+           fast, libm, libm / fast);
+
+    bool ok = tiltError < k_allowedErrorDegrees &&
+              atanError <= FastMath::k_atan2MaxError &&
+              invSqrtError <= FastMath::k_invSqrtMaxRelativeError;
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,458 @@
+/**
+ * @file modelbench.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Checks Inclinometer::Model's exact and small angle paths against
+ * the full Eigen rotation product it used to compute, checks Rotation.h
+ * against Eigen, checks the TiltEstimator on a ramp, and times them
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "../../InclinometerModel.h"
+#include "../../InclinometerModule.h"
+#include "../../TiltEstimator.h"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <chrono>
+#include <random>
+
+using namespace Eigen;
+
+typedef Inclinometer::Model<> Model;
+using Inclinometer::ModelZeropoint;
+using Rotation::Quat;
+using Rotation::Rot3;
+using Rotation::Vec2;
+using Rotation::Vec3;
+
+namespace {
+
+constexpr double k_degrees = 180.0 / PI;
+
+//! Largest error the exact path may have, which is only rounding
+constexpr double k_allowedExactError = 1e-12;
+
+//! Largest difference allowed between Rotation.h and Eigen, also rounding
+constexpr double k_allowedRotationError = 1e-12;
+
+//! The estimator's settings and the ACEINNA's noise in the sketch (see
+//! Constants::Algorithm)
+constexpr double k_angleNoiseDegrees = 0.01;
+constexpr double k_rateNoiseDegreesPerSecond = 0.05;
+constexpr double k_accelerationNoise = 0.1;
+
+//! Largest mean error the estimator may have on a 0.2 deg/s ramp, a
+//! quarter of the 0.5 EWMA's lag
+constexpr double k_allowedRampErrorDegrees = 0.005;
+
+//! Most noise the estimator may leave on a still angle, less than on the
+//! samples
+constexpr double k_allowedStillNoiseDegrees = 0.008;
+
+volatile double sink;
+
+double wallNanos()
+{
+    return std::chrono::duration<double, std::nano>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Matrix3d frame(double x, double y, double z)
+{
+    Matrix3d m;
+    m = AngleAxisd(x, Vector3d::UnitX()) * AngleAxisd(y, Vector3d::UnitY()) *
+        AngleAxisd(z, Vector3d::UnitZ());
+    return m;
+}
+
+Vec2 toVec2(const Vector2d &v) { return Vec2(v[0], v[1]); }
+
+Vector2d fromVec2(const Vec2 &v) { return Vector2d(v[0], v[1]); }
+
+Vector3d fromVec3(const Vec3 &v) { return Vector3d(v[0], v[1], v[2]); }
+
+Matrix3d fromRot3(const Rot3 &r)
+{
+    Matrix3d m;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            m(i, j) = r(i, j);
+        }
+    }
+    return m;
+}
+
+double difference(const Rot3 &r, const Matrix3d &m)
+{
+    return (fromRot3(r) - m).cwiseAbs().maxCoeff();
+}
+
+/**
+ * @brief Compares every Rotation.h operation the sketch uses with Eigen,
+ * over roll and yaw all the way around and pitch to +-80 degrees
+ *
+ * @return double the largest difference of any element
+ */
+double checkRotations()
+{
+    double worst = 0;
+    Vector3d v(0.3, -0.5, 0.8);
+    Vec3 vec(v[0], v[1], v[2]);
+    Matrix3d other = frame(0.2, -0.4, 1.1);
+    Rot3 otherRot = Rot3::fromRPY(0.2, -0.4, 1.1);
+    for (double r = -170; r <= 180; r += 10) {
+        for (double p = -80; p <= 80; p += 10) {
+            for (double y = -170; y <= 180; y += 10) {
+                Matrix3d m = frame(r / k_degrees, p / k_degrees,
+                                   y / k_degrees);
+                Rot3 rot =
+                    Rot3::fromRPY(r / k_degrees, p / k_degrees, y / k_degrees);
+                worst = fmax(worst, difference(rot, m));
+                worst = fmax(worst, difference(rot.transpose(), m.transpose()));
+                worst = fmax(worst, difference(rot * otherRot, m * other));
+                worst = fmax(worst, difference(rot.multiplyTranspose(otherRot),
+                                               m * other.transpose()));
+                worst = fmax(worst, (fromVec3(rot * vec) - m * v)
+                                        .cwiseAbs()
+                                        .maxCoeff());
+                worst = fmax(worst, (fromVec3(rot.transposeMultiply(vec)) -
+                                     m.transpose() * v)
+                                        .cwiseAbs()
+                                        .maxCoeff());
+
+                // Euler angles aren't unique, so they are compared through
+                // the rotation they make
+                Vec3 rpy = rot.toRPY();
+                worst = fmax(worst, difference(Rot3::fromRPY(rpy), m));
+                Vector3d eigenRpy = m.eulerAngles(0, 1, 2);
+                worst = fmax(worst, difference(Rot3::fromRPY(rpy),
+                                               frame(eigenRpy[0], eigenRpy[1],
+                                                     eigenRpy[2])));
+
+                Quat q = Quat::fromRotation(rot);
+                Quaterniond eq(m);
+                worst = fmax(worst, difference(q.toRotation(),
+                                               eq.toRotationMatrix()));
+                worst = fmax(worst,
+                             difference(q.conjugate().toRotation(),
+                                        eq.conjugate().toRotationMatrix()));
+                Quat xy = Quat::aboutX(r / k_degrees) *
+                          Quat::aboutY(p / k_degrees);
+                Quaterniond exy = AngleAxisd(r / k_degrees, Vector3d::UnitX()) *
+                                  AngleAxisd(p / k_degrees, Vector3d::UnitY());
+                worst = fmax(worst, difference(xy.toRotation(),
+                                               exy.toRotationMatrix()));
+            }
+        }
+    }
+    return worst;
+}
+
+/**
+ * @brief What Model::calculate() did before, with the full products and
+ * eulerAngles()
+ */
+Vector2d fullProduct(const Matrix3d &base, const Matrix3d &zero,
+                     const Vector2d &measured)
+{
+    Matrix3d measuredFrame = frame(measured[0], measured[1], 0);
+    Vector3d angles =
+        (base * zero.transpose() * measuredFrame).eulerAngles(0, 1, 2);
+    return Vector2d(angles[1], angles[0]);
+}
+
+/**
+ * @brief The direction the output angles tilt the Z axis to. Newer Eigen
+ * versions return a different (equivalent) set of euler angles than the
+ * Eigen 3.0 the sketch uses, so angles are compared through this.
+ */
+Vector3d up(const Vector2d &output)
+{
+    return frame(output[1], output[0], 0).col(2);
+}
+
+typedef struct {
+    double exactError;
+    double smallAngleError;
+    unsigned long samples;
+    unsigned long fallbacks;
+} SweepResult;
+
+/**
+ * @brief Sweeps the measured angles over +-range, for several zero poses
+ * and yaws
+ */
+SweepResult sweep(double rangeDegrees, double stepDegrees)
+{
+    SweepResult result = {0, 0, 0, 0};
+    const double yaws[] = {0, 30, 90, 180};
+    const double zeros[][2] = {{0, 0}, {3, -2}, {-1.5, 2.5}};
+    for (double yaw : yaws) {
+        for (const double *zero : zeros) {
+            Model exact, small;
+            Vec3 base(0, 0, yaw / k_degrees);
+            exact.setBaseFrameAnglesRadians(base);
+            small.setBaseFrameAnglesRadians(base);
+            Vec2 zeroAngles(zero[0] / k_degrees, zero[1] / k_degrees);
+            ModelZeropoint stored = exact.setMeasurementAsZero(zeroAngles);
+            small.importZero(stored);
+            small.setSmallAngle(true);
+
+            // The stored pose is rounded to floats, compare against the
+            // same pose
+            Matrix3d baseFrame = frame(0, 0, base[2]);
+            Matrix3d zeroFrame = fromRot3(Inclinometer::zeroToFrame(stored));
+            for (double a = -rangeDegrees; a <= rangeDegrees;
+                 a += stepDegrees) {
+                for (double b = -rangeDegrees; b <= rangeDegrees;
+                     b += stepDegrees) {
+                    Vector2d measured(a / k_degrees, b / k_degrees);
+                    Vector2d reference =
+                        fullProduct(baseFrame, zeroFrame, measured);
+                    Vector2d fast =
+                        fromVec2(exact.calculate(toVec2(measured)));
+                    Vector2d approximate =
+                        fromVec2(small.calculate(toVec2(measured)));
+
+                    result.exactError =
+                        fmax(result.exactError,
+                             (up(fast) - up(reference)).cwiseAbs().maxCoeff());
+                    result.smallAngleError =
+                        fmax(result.smallAngleError,
+                             (approximate - fast).cwiseAbs().maxCoeff());
+                    result.samples++;
+                    if (fabs(a / k_degrees) > Model::k_smallAngleLimit ||
+                        fabs(b / k_degrees) > Model::k_smallAngleLimit ||
+                        fabs(fast[0]) > Model::k_smallAngleLimit ||
+                        fabs(fast[1]) > Model::k_smallAngleLimit) {
+                        result.fallbacks++;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+typedef struct {
+    double meanError;
+    double rmsError;
+} TrackingResult;
+
+/**
+ * @brief Feeds a filter 60 s of a steady tilt, sampled at 10 Hz with the
+ * ACEINNA's noise, and measures its error once it has settled
+ *
+ * @param filter called with each sample (radians) and its micros(),
+ * returns the filtered angle
+ * @param degreesPerSecond rate of tilt, 0 to stay still
+ */
+template <typename F> TrackingResult track(F filter, double degreesPerSecond)
+{
+    std::mt19937 generator(4);
+    std::normal_distribution<double> normal;
+    TrackingResult result = {0, 0};
+    int counted = 0;
+    for (int n = 0; n < 600; n++) {
+        double truth = (0.5 + degreesPerSecond * n * 0.1) / k_degrees;
+        double angle = filter(
+            truth + k_angleNoiseDegrees / k_degrees * normal(generator),
+            n * 100000UL);
+        // The first 10 s are for settling
+        if (n >= 100) {
+            double error = (angle - truth) * k_degrees;
+            result.meanError += error;
+            result.rmsError += error * error;
+            counted++;
+        }
+    }
+    result.meanError /= counted;
+    result.rmsError = sqrt(result.rmsError / counted);
+    return result;
+}
+
+/**
+ * @brief Compares the TiltEstimator with the 0.5 EWMA it replaces, on a
+ * 0.2 deg/s ramp and a still angle
+ *
+ * @return true if the estimator follows the ramp without the EWMA's lag,
+ * within k_allowedRampErrorDegrees, and leaves no more than
+ * k_allowedStillNoiseDegrees on the still angle
+ */
+bool checkEstimator()
+{
+    Inclinometer::TiltEstimator prototype(
+        k_angleNoiseDegrees / k_degrees,
+        k_rateNoiseDegreesPerSecond / k_degrees,
+        k_accelerationNoise / k_degrees);
+    auto estimator = [prototype](double angle,
+                                 unsigned long timestamp) mutable -> double {
+        prototype.addAngles(Vec2(angle, angle), timestamp);
+        Inclinometer::TiltEstimate estimate;
+        prototype.getEstimate(estimate);
+        return estimate.angles[0];
+    };
+    Filter::Ewma<double> average(0.5);
+    auto ewma = [average](double angle, unsigned long) mutable -> double {
+        return average.add(angle);
+    };
+
+    TrackingResult estimatorRamp = track(estimator, 0.2);
+    TrackingResult estimatorStill = track(estimator, 0);
+    TrackingResult ewmaRamp = track(ewma, 0.2);
+    TrackingResult ewmaStill = track(ewma, 0);
+
+    printf("TiltEstimator:     %+.4f deg mean error on 0.2 deg/s (EWMA "
+           "%+.4f, limit %.3f),\n                   %.4f deg RMS still "
+           "(EWMA %.4f, limit %.3f)\n",
+           estimatorRamp.meanError, ewmaRamp.meanError,
+           k_allowedRampErrorDegrees, estimatorStill.rmsError,
+           ewmaStill.rmsError, k_allowedStillNoiseDegrees);
+    return fabs(estimatorRamp.meanError) <= k_allowedRampErrorDegrees &&
+           fabs(estimatorRamp.meanError) < fabs(ewmaRamp.meanError) &&
+           estimatorStill.rmsError <= k_allowedStillNoiseDegrees;
+}
+
+/**
+ * @brief Times a calculation over a set of inputs, in ns per call
+ */
+template <typename F> double timeModel(F calculate)
+{
+    constexpr int k_inputs = 1024;
+    constexpr int k_rounds = 500;
+    Vector2d inputs[k_inputs];
+    for (int i = 0; i < k_inputs; i++) {
+        inputs[i] =
+            Vector2d((i % 41 - 20) / 2.0 / k_degrees,
+                     (i % 37 - 18) / 2.0 / k_degrees);
+    }
+    double start = wallNanos();
+    for (int round = 0; round < k_rounds; round++) {
+        for (int i = 0; i < k_inputs; i++) {
+            Vector2d out = calculate(inputs[i]);
+            sink = out[0] + out[1];
+        }
+    }
+    return (wallNanos() - start) / ((double)k_inputs * k_rounds);
+}
+
+/**
+ * @brief A source that has a full batch of samples on every read
+ */
+class ReplaySource final : public Inclinometer::InclinometerDataSource {
+  public:
+    ReplaySource() : time(0){};
+
+    bool begin() override { return true; };
+    bool hasData() override { return true; };
+    Vec2 getData() override { return Vec2(0.01, -0.02); };
+    unsigned long getTimestamp() override { return time; };
+    unsigned long getSamplePeriod() override { return 10000; };
+    byte readAll(Inclinometer::Sample *samples, byte capacity) override
+    {
+        for (byte i = 0; i < capacity; i++) {
+            samples[i].angles = Vec2((i % 5) * 0.01, (i % 3) * -0.01);
+            samples[i].timestamp = time += 10000;
+            samples[i].quality.figureOfMerit = Inclinometer::MERIT_FULL;
+            samples[i].quality.compensation = Inclinometer::COMPENSATION_ON;
+            samples[i].quality.latency = 0;
+        }
+        return capacity;
+    };
+    bool getRates(Inclinometer::RateSample &) override { return false; };
+
+  private:
+    unsigned long time;
+};
+
+/**
+ * @brief Times update() on a module, in ns per sample
+ */
+template <typename M> double timeModule(M &module)
+{
+    constexpr int k_rounds = 100000;
+    double start = wallNanos();
+    unsigned long samples = 0;
+    for (int round = 0; round < k_rounds; round++) {
+        samples += module.update();
+        sink = module.getLatest()[0];
+    }
+    return (wallNanos() - start) / samples;
+}
+} // namespace
+
+int main()
+{
+    // The +-10 degree envelope and a margin for the sensor's mounting
+    SweepResult inside = sweep(14.0, 0.05);
+    // Past the limit, where the small angle mode has to fall back
+    SweepResult outside = sweep(30.0, 0.25);
+
+    printf("Exact path:        max error %.3g (limit %.3g) against the full "
+           "product\n",
+           fmax(inside.exactError, outside.exactError), k_allowedExactError);
+    printf("Small angle mode:  max error %.3g rad over +-14 deg (documented "
+           "%.3g),\n                   %.3g rad over +-30 deg with %lu of "
+           "%lu on the exact path\n",
+           inside.smallAngleError, Model::k_smallAngleMaxError,
+           outside.smallAngleError, outside.fallbacks, outside.samples);
+
+    double rotationError = checkRotations();
+    printf("Rotation.h:        max difference %.3g from Eigen (limit %.3g)\n",
+           rotationError, k_allowedRotationError);
+
+    bool estimatorOk = checkEstimator();
+
+    Matrix3d baseFrame = frame(0, 0, 30 / k_degrees);
+    Matrix3d zeroFrame = frame(3 / k_degrees, -2 / k_degrees, 0);
+    Model exact, small;
+    exact.setBaseFrameAnglesRadians(Vec3(0, 0, 30 / k_degrees));
+    small.setBaseFrameAnglesRadians(Vec3(0, 0, 30 / k_degrees));
+    exact.setMeasurementAsZero(Vec2(3 / k_degrees, -2 / k_degrees));
+    small.setMeasurementAsZero(Vec2(3 / k_degrees, -2 / k_degrees));
+    small.setSmallAngle(true);
+
+    double full = timeModel([&](const Vector2d &m) {
+        return fullProduct(baseFrame, zeroFrame, m);
+    });
+    double cached = timeModel([&](const Vector2d &m) {
+        return fromVec2(exact.calculate(toVec2(m)));
+    });
+    double series = timeModel([&](const Vector2d &m) {
+        return fromVec2(small.calculate(toVec2(m)));
+    });
+    printf("Host time per sample: %.1f ns full product, %.1f ns exact "
+           "(%.1fx),\n%.1f ns small angle (%.1fx). AVR soft-float ratios "
+           "differ, time it there\nwith micros() over a batch.\n",
+           full, cached, full / cached, series, full / series);
+
+    // The same module, called directly and through the interfaces the
+    // MotionController and FusedInclinometer use
+    ReplaySource replay;
+    Inclinometer::Module<ReplaySource> direct(&replay, 30 / k_degrees);
+    Inclinometer::Module<ReplaySource, float> directFloat(&replay,
+                                                          30 / k_degrees);
+    Inclinometer::Module<Inclinometer::InclinometerDataSource> erased(
+        &replay, 30 / k_degrees);
+    Inclinometer::ModuleBase *volatile base = &erased;
+    double staticTime = timeModule(direct);
+    double floatTime = timeModule(directFloat);
+    double erasedTime = timeModule(*base);
+    printf("Module update() per sample: %.1f ns Module<Source>, %.1f ns "
+           "with float,\n%.1f ns through ModuleBase and "
+           "InclinometerDataSource\n",
+           staticTime, floatTime, erasedTime);
+
+    bool ok = estimatorOk && rotationError <= k_allowedRotationError &&
+              inside.exactError <= k_allowedExactError &&
+              outside.exactError <= k_allowedExactError &&
+              inside.smallAngleError <= Model::k_smallAngleMaxError &&
+              outside.smallAngleError <= Model::k_smallAngleMaxError;
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+/**
+ * @file ringtest.cpp
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Pushes values through a SpscRing from one thread and pops them on
+ * another, the way the DRDY interrupt hands samples to loop()
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "../../SpscRing.h"
+
+#include <thread>
+
+namespace {
+
+constexpr unsigned long k_values = 200000;
+
+/**
+ * @brief Same size as the raw samples ADXL355Inclinometer queues, so a copy
+ * that gets overtaken by the other side shows up as fields that disagree
+ */
+typedef struct {
+    long raw[3];
+    unsigned long timestamp;
+} Value;
+
+SpscRing<Value, 16> ring;
+
+//! Times the producer found the ring full and had to try again
+unsigned long fullSpins = 0;
+
+void produce()
+{
+    for (unsigned long i = 0; i < k_values; i++) {
+        Value value = {{(long)i, (long)i, (long)i}, i};
+        while (!ring.push(value)) {
+            fullSpins++;
+            std::this_thread::yield();
+        }
+    }
+}
+} // namespace
+
+int main()
+{
+    std::thread producer(produce);
+
+    unsigned long received = 0;
+    unsigned long wrong = 0;
+    unsigned long emptySpins = 0;
+    while (received < k_values) {
+        Value value;
+        if (!ring.pop(value)) {
+            emptySpins++;
+            std::this_thread::yield();
+            continue;
+        }
+        if (value.timestamp != received || value.raw[0] != (long)received ||
+            value.raw[1] != (long)received || value.raw[2] != (long)received) {
+            wrong++;
+        }
+        received++;
+    }
+    producer.join();
+
+    bool ok = wrong == 0 && ring.empty();
+    printf("SpscRing: %lu values between two threads, %lu out of order or "
+           "torn,\n          producer found it full %lu times, consumer "
+           "found it empty %lu times\n",
+           received, wrong, fullSpins, emptySpins);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
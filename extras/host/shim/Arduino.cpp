@@ -0,0 +1,103 @@
+#include "Arduino.h"
+
+namespace {
+unsigned long long simulatedMicros = 0;
+uint8_t pinLevels[256];
+}
+
+unsigned long long hostMicros() { return simulatedMicros; }
+
+void hostAdvanceMicros(unsigned long long us) { simulatedMicros += us; }
+
+// Like on the target, both wrap around at 32 bits
+unsigned long millis() { return (unsigned long)(simulatedMicros / 1000); }
+
+unsigned long micros() { return (unsigned long)simulatedMicros; }
+
+void delay(unsigned long ms) { hostAdvanceMicros(ms * 1000ULL); }
+
+void delayMicroseconds(unsigned int us) { hostAdvanceMicros(us); }
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+// Reads back what was written, e.g. so the SPI shim can see chip selects
+void digitalWrite(uint8_t pin, uint8_t val) { pinLevels[pin] = val; }
+
+int digitalRead(uint8_t pin) { return pinLevels[pin]; }
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode)
+{
+    (void)interrupt;
+    (void)handler;
+    (void)mode;
+}
+
+void noInterrupts() {}
+
+void interrupts() {}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--) {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::print(const char *s) { return write(s); }
+
+size_t Print::print(char c) { return write((uint8_t)c); }
+
+size_t Print::print(unsigned char n, int base)
+{
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base) { return print((long)n, base); }
+
+size_t Print::print(unsigned int n, int base)
+{
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+    if (base == DEC) {
+        char text[24];
+        snprintf(text, sizeof(text), "%ld", n);
+        return print(text);
+    }
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    char text[24];
+    snprintf(text, sizeof(text), (base == HEX) ? "%lX" : "%lu", n);
+    return print(text);
+}
+
+size_t Print::print(double n, int digits)
+{
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", digits, n);
+    return print(text);
+}
+
+size_t Print::println() { return write("\r\n"); }
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    // The console drops the carriage returns of println()
+    if (c != '\r') {
+        putchar(c);
+    }
+    return 1;
+}
+
+HardwareSerial Serial;
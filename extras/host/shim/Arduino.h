@@ -0,0 +1,130 @@
+/**
+ * @file Arduino.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Minimal stand-in for the Arduino core, so the CAN stack can be built
+ * and run on a Linux host
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef HOST_ARDUINO_SHIM_H
+#define HOST_ARDUINO_SHIM_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PI 3.1415926535897932384626433832795
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define RISING 3
+#define DEC 10
+#define HEX 16
+
+/**
+ * @brief Time on the host runs on a simulated clock, which only moves when
+ * delay() is called or something blocks (e.g. a full UART). This makes runs
+ * repeatable and independent of how fast the host is.
+ */
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+//! Host only: the simulated time in microseconds, without wrapping
+unsigned long long hostMicros();
+
+//! Host only: moves the simulated clock forward
+void hostAdvanceMicros(unsigned long long us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+/**
+ * @brief Nothing raises interrupts on the host, so attaching one does
+ * nothing and there is nothing to hold off
+ */
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void noInterrupts();
+void interrupts();
+
+/**
+ * @brief Same interface as the Arduino core's Print class
+ */
+class Print {
+  public:
+    virtual ~Print(){};
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str)
+    {
+        return write((const uint8_t *)str, strlen(str));
+    };
+    virtual int availableForWrite() { return 0; };
+
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println();
+    template <typename T> size_t println(T value)
+    {
+        size_t n = print(value);
+        return n + println();
+    };
+    template <typename T> size_t println(T value, int format)
+    {
+        size_t n = print(value, format);
+        return n + println();
+    };
+};
+
+/**
+ * @brief Same interface as the Arduino core's Stream class
+ */
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+/**
+ * @brief Stand-in for the Arduino HardwareSerial. By itself it is a console
+ * that writes to stdout and never receives anything. Subclasses replace it
+ * with a device on the other end of the UART (see LonganEmulator).
+ */
+class HardwareSerial : public Stream {
+  public:
+    virtual void begin(unsigned long baud) { (void)baud; };
+    virtual void end(){};
+    int available() override { return 0; };
+    int peek() override { return -1; };
+    int read() override { return -1; };
+    int availableForWrite() override { return 64; };
+    virtual void flush() { fflush(stdout); };
+    size_t write(uint8_t c) override;
+    using Print::write;
+    operator bool() { return true; };
+};
+
+extern HardwareSerial Serial;
+
+#endif
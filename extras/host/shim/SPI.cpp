@@ -0,0 +1,56 @@
+#include "SPI.h"
+
+SPIClass SPI;
+
+void SPIClass::hostAttach(SPIDevice *device, uint8_t csPin)
+{
+    if (deviceCount < k_maxDevices) {
+        devices[deviceCount] = device;
+        pins[deviceCount] = csPin;
+        selected[deviceCount] = false;
+        deviceCount++;
+        digitalWrite(csPin, HIGH);
+    }
+}
+
+void SPIClass::hostDetach(SPIDevice *device)
+{
+    for (int i = 0; i < deviceCount; i++) {
+        if (devices[i] == device) {
+            deviceCount--;
+            devices[i] = devices[deviceCount];
+            pins[i] = pins[deviceCount];
+            selected[i] = selected[deviceCount];
+            return;
+        }
+    }
+}
+
+void SPIClass::endTransaction()
+{
+    // Every driver here releases its chip select before this
+    for (int i = 0; i < deviceCount; i++) {
+        selected[i] = false;
+    }
+}
+
+byte SPIClass::transfer(byte out)
+{
+    pendingNanos += 8000000000ULL / clock;
+    hostAdvanceMicros(pendingNanos / 1000);
+    pendingNanos %= 1000;
+
+    for (int i = 0; i < deviceCount; i++) {
+        if (digitalRead(pins[i]) != LOW) {
+            selected[i] = false;
+            continue;
+        }
+        if (!selected[i]) {
+            selected[i] = true;
+            devices[i]->select();
+        }
+        return devices[i]->transfer(out);
+    }
+    // Nothing drives MISO, the pull-up reads high
+    return 0xFF;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+/**
+ * @file SPI.h
+ * @author Ryan Johnson (ryan@johnsonweb.us)
+ * @brief Minimal stand-in for the Arduino SPI library, with emulated devices
+ * on the other end of the bus
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef HOST_SPI_SHIM_H
+#define HOST_SPI_SHIM_H
+
+#include <Arduino.h>
+
+#define MSBFIRST  1
+#define SPI_MODE0 0x00
+
+/**
+ * @brief Same interface as the Arduino SPISettings. Only the clock is kept,
+ * it sets how much simulated time a transfer takes.
+ */
+class SPISettings {
+  public:
+    SPISettings() : clock(4000000){};
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+        : clock(clock)
+    {
+        (void)bitOrder;
+        (void)dataMode;
+    };
+
+    uint32_t clock;
+};
+
+/**
+ * @brief A chip on the emulated SPI bus
+ */
+class SPIDevice {
+  public:
+    virtual ~SPIDevice(){};
+
+    /**
+     * @brief Called when the chip select goes low, before the first byte
+     */
+    virtual void select() = 0;
+
+    /**
+     * @brief Exchanges one byte while the chip is selected
+     *
+     * @param out the byte the host sends
+     * @return byte the byte the chip sends back
+     */
+    virtual byte transfer(byte out) = 0;
+};
+
+/**
+ * @brief Same interface as the Arduino SPIClass. A transfer goes to the
+ * device whose chip select pin was last written LOW, and moves the simulated
+ * clock by eight clock periods, so polling a device lets time pass.
+ */
+class SPIClass {
+  public:
+    SPIClass() : clock(4000000), deviceCount(0), pendingNanos(0){};
+
+    void begin(){};
+    void beginTransaction(SPISettings settings) { clock = settings.clock; };
+    void endTransaction();
+    byte transfer(byte out);
+    void usingInterrupt(int interrupt) { (void)interrupt; };
+
+    //! Host only: puts a device on the bus behind a chip select pin, which
+    //! idles high
+    void hostAttach(SPIDevice *device, uint8_t csPin);
+
+    //! Host only: takes a device off the bus again
+    void hostDetach(SPIDevice *device);
+
+  private:
+    static constexpr int k_maxDevices = 4;
+    uint32_t clock;
+    SPIDevice *devices[k_maxDevices];
+    uint8_t pins[k_maxDevices];
+    bool selected[k_maxDevices];
+    int deviceCount;
+    //! Transfer time not yet added to the clock, which counts whole us
+    unsigned long pendingNanos;
+};
+
+extern SPIClass SPI;
+
+#endif
\ No newline at end of file